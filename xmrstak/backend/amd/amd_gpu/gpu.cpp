@@ -15,11 +15,20 @@
 
 #include "xmrstak/backend/cryptonight.hpp"
 #include "xmrstak/jconf.hpp"
+#include "xmrstak/params.hpp"
+
+extern "C"
+{
+#include "xmrstak/backend/cpu/crypto/c_keccak.h"
+}
 
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <sys/stat.h>
 #include <iostream>
+#include <fstream>
+#include <iterator>
 #include <vector>
 #include <algorithm>
 #include <regex>
@@ -27,11 +36,17 @@
 
 #ifdef _WIN32
 #include <windows.h>
+#include <direct.h>
 
 static inline void port_sleep(size_t sec)
 {
 	Sleep(sec * 1000);
 }
+
+static inline int port_mkdir(const char* dir)
+{
+	return _mkdir(dir);
+}
 #else
 #include <unistd.h>
 
@@ -39,6 +54,11 @@ static inline void port_sleep(size_t sec)
 {
 	sleep(sec);
 }
+
+static inline int port_mkdir(const char* dir)
+{
+	return mkdir(dir, 0744);
+}
 #endif // _WIN32
 
 #if 0
@@ -215,6 +235,123 @@ char* LoadTextFile(const char* filename)
 	return out;
 }
 
+static std::string get_device_string(cl_device_id device, cl_device_info info)
+{
+	size_t len = 0;
+	if(clGetDeviceInfo(device, info, 0, NULL, &len) != CL_SUCCESS || len == 0)
+		return std::string();
+
+	std::vector<char> buf(len + 1, '\0');
+	if(clGetDeviceInfo(device, info, len, buf.data(), NULL) != CL_SUCCESS)
+		return std::string();
+	return std::string(buf.data());
+}
+
+/* Compiled kernels are kept in ~/.openclcache (%APPDATA%\.openclcache on Windows). The file name
+ * is a hash of everything that goes into the build, so a new driver, device, kernel source,
+ * option or currency gives a new name and the kernels are compiled again.
+ */
+static std::string get_cache_file(GpuContext* ctx, const char* source_code, const char* options)
+{
+#ifdef _WIN32
+	const char* home = getenv("APPDATA");
+#else
+	const char* home = getenv("HOME");
+#endif
+	std::string cache_dir(home != nullptr ? home : ".");
+	cache_dir += "/.openclcache";
+
+	struct stat st;
+	if(stat(cache_dir.c_str(), &st) != 0 && port_mkdir(cache_dir.c_str()) != 0)
+	{
+		printer::inst()->print_msg(L1,"WARNING: unable to create the kernel cache directory %s.", cache_dir.c_str());
+		return std::string();
+	}
+
+	std::string key(source_code);
+	key.append(1, '\n').append(options);
+	key.append(1, '\n').append(get_device_string(ctx->DeviceID, CL_DEVICE_NAME));
+	key.append(1, '\n').append(get_device_string(ctx->DeviceID, CL_DEVICE_VERSION));
+	key.append(1, '\n').append(get_device_string(ctx->DeviceID, CL_DRIVER_VERSION));
+	key.append(1, '\n').append(::jconf::inst()->IsCurrencyMonero() ? "monero" : "aeon");
+
+	uint8_t md[32];
+	keccak((const uint8_t*)key.data(), key.size(), md, sizeof(md));
+
+	char hex[sizeof(md) * 2 + 1];
+	for(size_t i = 0; i < sizeof(md); i++)
+		snprintf(hex + i * 2, 3, "%02x", md[i]);
+
+	return cache_dir + "/" + hex + ".openclbin";
+}
+
+static bool load_cached_program(cl_context opencl_ctx, GpuContext* ctx, const std::string& cache_file, const char* options)
+{
+	std::ifstream in(cache_file, std::ios::binary);
+	if(!in.is_open())
+		return false;
+
+	std::vector<unsigned char> bin((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	const unsigned char* data = bin.data();
+	size_t len = bin.size();
+	cl_int status, ret;
+
+	ctx->Program = clCreateProgramWithBinary(opencl_ctx, 1, &ctx->DeviceID, &len, &data, &status, &ret);
+	if(ret == CL_SUCCESS && status == CL_SUCCESS)
+		ret = clBuildProgram(ctx->Program, 1, &ctx->DeviceID, options, NULL, NULL);
+	else if(ret == CL_SUCCESS)
+		ret = status;
+
+	if(ret != CL_SUCCESS)
+	{
+		printer::inst()->print_msg(L1,"Device %lu: cached kernels rejected with %s, compiling them again.", ctx->deviceIdx, err_to_str(ret));
+		if(ctx->Program != NULL)
+			clReleaseProgram(ctx->Program);
+		ctx->Program = NULL;
+		return false;
+	}
+
+	printer::inst()->print_msg(L1,"Device %lu: kernels loaded from %s.", ctx->deviceIdx, cache_file.c_str());
+	return true;
+}
+
+static void store_cached_program(GpuContext* ctx, const std::string& cache_file)
+{
+	// The program belongs to every device of the context, only ours has a binary
+	cl_uint num_devices = 0;
+	if(clGetProgramInfo(ctx->Program, CL_PROGRAM_NUM_DEVICES, sizeof(cl_uint), &num_devices, NULL) != CL_SUCCESS || num_devices == 0)
+		return;
+
+	std::vector<cl_device_id> devices(num_devices);
+	std::vector<size_t> sizes(num_devices, 0);
+	if(clGetProgramInfo(ctx->Program, CL_PROGRAM_DEVICES, sizeof(cl_device_id) * num_devices, devices.data(), NULL) != CL_SUCCESS ||
+		clGetProgramInfo(ctx->Program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t) * num_devices, sizes.data(), NULL) != CL_SUCCESS)
+		return;
+
+	size_t idx = std::find(devices.begin(), devices.end(), ctx->DeviceID) - devices.begin();
+	if(idx == num_devices || sizes[idx] == 0)
+		return;
+
+	std::vector<unsigned char> bin(sizes[idx]);
+	std::vector<unsigned char*> binaries(num_devices, nullptr);
+	binaries[idx] = bin.data();
+	if(clGetProgramInfo(ctx->Program, CL_PROGRAM_BINARIES, sizeof(unsigned char*) * num_devices, binaries.data(), NULL) != CL_SUCCESS)
+		return;
+
+	// Written under a temporary name first, a second miner never reads half a file
+	std::string tmp_file = cache_file + ".tmp";
+	std::ofstream out(tmp_file, std::ios::binary | std::ios::trunc);
+	out.write((const char*)bin.data(), bin.size());
+	out.close();
+
+	std::remove(cache_file.c_str());
+	if(!out || std::rename(tmp_file.c_str(), cache_file.c_str()) != 0)
+	{
+		std::remove(tmp_file.c_str());
+		printer::inst()->print_msg(L1,"WARNING: unable to write the kernel cache file %s.", cache_file.c_str());
+	}
+}
+
 size_t InitOpenCLGpu(cl_context opencl_ctx, GpuContext* ctx, const char* source_code)
 {
 	size_t MaximumWorkSize;
@@ -323,18 +460,30 @@ size_t InitOpenCLGpu(cl_context opencl_ctx, GpuContext* ctx, const char* source_
 		return ERR_OCL_API;
 	}
 
-	ctx->Program = clCreateProgramWithSource(opencl_ctx, 1, (const char**)&source_code, NULL, &ret);
-	if(ret != CL_SUCCESS)
-	{
-		printer::inst()->print_msg(L1,"Error %s when calling clCreateProgramWithSource on the contents of cryptonight.cl", err_to_str(ret));
-		return ERR_OCL_API;
-	}
-
 	char options[256];
 	snprintf(options, sizeof(options), 
 		"-DITERATIONS=%d -DMASK=%d -DWORKSIZE=%llu -DSTRIDED_INDEX=%d", 
 		hasIterations, threadMemMask, int_port(ctx->workSize), ctx->stridedIndex ? 1 : 0);
-	ret = clBuildProgram(ctx->Program, 1, &ctx->DeviceID, options, NULL, NULL);
+
+	std::string cache_file;
+	if(xmrstak::params::inst().AMDCache)
+		cache_file = get_cache_file(ctx, source_code, options);
+
+	bool bCached = !cache_file.empty() && load_cached_program(opencl_ctx, ctx, cache_file, options);
+	if(!bCached)
+	{
+		ctx->Program = clCreateProgramWithSource(opencl_ctx, 1, (const char**)&source_code, NULL, &ret);
+		if(ret != CL_SUCCESS)
+		{
+			printer::inst()->print_msg(L1,"Error %s when calling clCreateProgramWithSource on the contents of cryptonight.cl", err_to_str(ret));
+			return ERR_OCL_API;
+		}
+
+		ret = clBuildProgram(ctx->Program, 1, &ctx->DeviceID, options, NULL, NULL);
+	}
+	else
+		ret = CL_SUCCESS;
+
 	if(ret != CL_SUCCESS)
 	{
 		size_t len;
@@ -371,10 +520,14 @@ size_t InitOpenCLGpu(cl_context opencl_ctx, GpuContext* ctx, const char* source_
 			printer::inst()->print_msg(L1,"Error %s when calling clGetProgramBuildInfo for status of build.", err_to_str(ret));
 			return ERR_OCL_API;
 		}
-		port_sleep(1);
+		if(status == CL_BUILD_IN_PROGRESS)
+			port_sleep(1);
 	}
 	while(status == CL_BUILD_IN_PROGRESS);
 
+	if(!bCached && !cache_file.empty())
+		store_cached_program(ctx, cache_file);
+
 	const char *KernelNames[] = { "cn0", "cn1", "cn2", "Blake", "Groestl", "JH", "Skein" };
 	for(int i = 0; i < 7; ++i)
 	{
@@ -387,6 +540,9 @@ size_t InitOpenCLGpu(cl_context opencl_ctx, GpuContext* ctx, const char* source_
 	}
 
 	ctx->Nonce = 0;
+	ctx->OutputEvent[0] = NULL;
+	ctx->OutputEvent[1] = NULL;
+	ctx->RoundCnt = 0;
 	return 0;
 }
 
@@ -717,6 +873,17 @@ size_t XMRSetJob(GpuContext* ctx, uint8_t* input, size_t input_len, uint64_t tar
 
 	size_t numThreads = ctx->rawIntensity;
 
+	// Results of a round nobody collected would be taken for results of the new job
+	for(int i = 0; i < 2; ++i)
+	{
+		if(ctx->OutputEvent[i] != NULL)
+		{
+			clWaitForEvents(1, &ctx->OutputEvent[i]);
+			clReleaseEvent(ctx->OutputEvent[i]);
+			ctx->OutputEvent[i] = NULL;
+		}
+	}
+
 	if((ret = clEnqueueWriteBuffer(ctx->CommandQueues, ctx->InputBuffer, CL_TRUE, 0, 88, input, 0, NULL, NULL)) != CL_SUCCESS)
 	{
 		printer::inst()->print_msg(L1,"Error %s when calling clEnqueueWriteBuffer to fill input buffer.", err_to_str(ret));
@@ -852,17 +1019,47 @@ size_t XMRSetJob(GpuContext* ctx, uint8_t* input, size_t input_len, uint64_t tar
 			printer::inst()->print_msg(L1,"Error %s when calling clSetKernelArg for kernel %d, argument %d.", err_to_str(ret), i + 3, 3);
 			return ERR_OCL_API;
 		}
+
+		// Index of the nonce counter in the branch buffer
+		if((ret = clSetKernelArg(ctx->Kernels[i + 3], 4, sizeof(cl_ulong), &numThreads)) != CL_SUCCESS)
+		{
+			printer::inst()->print_msg(L1,"Error %s when calling clSetKernelArg for kernel %d, argument %d.", err_to_str(ret), i + 3, 4);
+			return ERR_OCL_API;
+		}
 	}
 
 	return ERR_SUCCESS;
 }
 
+static size_t XMRReadResults(GpuContext* ctx, size_t slot, cl_uint* HashOutput)
+{
+	HashOutput[0xFF] = 0;
+	if(ctx->OutputEvent[slot] == NULL)
+		return ERR_SUCCESS;
+
+	cl_int ret = clWaitForEvents(1, &ctx->OutputEvent[slot]);
+	clReleaseEvent(ctx->OutputEvent[slot]);
+	ctx->OutputEvent[slot] = NULL;
+	if(ret != CL_SUCCESS)
+	{
+		printer::inst()->print_msg(L1,"Error %s when calling clWaitForEvents to fetch results.", err_to_str(ret));
+		return ERR_OCL_API;
+	}
+
+	memcpy(HashOutput, ctx->OutputHost[slot], sizeof(cl_uint) * 0x100);
+	auto & numHashValues = HashOutput[0xFF];
+	// avoid out of memory read, we have only storage for 0xFF results
+	if(numHashValues > 0xFF)
+		numHashValues = 0xFF;
+
+	return ERR_SUCCESS;
+}
+
 size_t XMRRunJob(GpuContext* ctx, cl_uint* HashOutput)
 {
 	cl_int ret;
-	cl_uint zero = 0;
-	size_t BranchNonces[4];
-	memset(BranchNonces,0,sizeof(size_t)*4);
+	// Read by the non blocking writes after we returned
+	static const cl_uint zero = 0;
 
 	size_t g_intensity = ctx->rawIntensity;
 	size_t w_size = ctx->workSize;
@@ -871,6 +1068,9 @@ size_t XMRRunJob(GpuContext* ctx, cl_uint* HashOutput)
 	// number of global threads must be a multiple of the work group size (w_size)
 	assert(g_thd%w_size == 0);
 
+	/* The queue is in order, so this round starts on the GPU as soon as the one before is done,
+	 * while we wait below for the results of that one. Nothing here waits for the GPU.
+	 */
 	for(int i = 2; i < 6; ++i)
 	{
 		if((ret = clEnqueueWriteBuffer(ctx->CommandQueues, ctx->ExtraBuffers[i], CL_FALSE, sizeof(cl_uint) * g_intensity, sizeof(cl_uint), &zero, 0, NULL, NULL)) != CL_SUCCESS)
@@ -886,8 +1086,6 @@ size_t XMRRunJob(GpuContext* ctx, cl_uint* HashOutput)
 		return ERR_OCL_API;
 	}
 
-	clFinish(ctx->CommandQueues);
-
 	size_t Nonce[2] = {ctx->Nonce, 1}, gthreads[2] = { g_thd, 8 }, lthreads[2] = { w_size, 8 };
 	if((ret = clEnqueueNDRangeKernel(ctx->CommandQueues, ctx->Kernels[0], 2, Nonce, gthreads, lthreads, 0, NULL, NULL)) != CL_SUCCESS)
 	{
@@ -895,15 +1093,6 @@ size_t XMRRunJob(GpuContext* ctx, cl_uint* HashOutput)
 		return ERR_OCL_API;
 	}
 
-	/*for(int i = 1; i < 3; ++i)
-	{
-		if((ret = clEnqueueNDRangeKernel(*ctx->CommandQueues, ctx->Kernels[i], 1, &ctx->Nonce, &g_thd, &w_size, 0, NULL, NULL)) != CL_SUCCESS)
-		{
-			Log(LOG_CRITICAL, "Error %s when calling clEnqueueNDRangeKernel for kernel %d.", err_to_str(ret), i);
-			return(ERR_OCL_API);
-		}
-	}*/
-
 	size_t tmpNonce = ctx->Nonce;
 	if((ret = clEnqueueNDRangeKernel(ctx->CommandQueues, ctx->Kernels[1], 1, &tmpNonce, &g_thd, &w_size, 0, NULL, NULL)) != CL_SUCCESS)
 	{
@@ -917,68 +1106,31 @@ size_t XMRRunJob(GpuContext* ctx, cl_uint* HashOutput)
 		return ERR_OCL_API;
 	}
 
-	if((ret = clEnqueueReadBuffer(ctx->CommandQueues, ctx->ExtraBuffers[2], CL_FALSE, sizeof(cl_uint) * g_intensity, sizeof(cl_uint), BranchNonces, 0, NULL, NULL)) != CL_SUCCESS)
-	{
-		printer::inst()->print_msg(L1,"Error %s when calling clEnqueueReadBuffer to fetch results.", err_to_str(ret));
-		return ERR_OCL_API;
-	}
-
-	if((ret = clEnqueueReadBuffer(ctx->CommandQueues, ctx->ExtraBuffers[3], CL_FALSE, sizeof(cl_uint) * g_intensity, sizeof(cl_uint), BranchNonces + 1, 0, NULL, NULL)) != CL_SUCCESS)
-	{
-		printer::inst()->print_msg(L1,"Error %s when calling clEnqueueReadBuffer to fetch results.", err_to_str(ret));
-		return ERR_OCL_API;
-	}
-
-	if((ret = clEnqueueReadBuffer(ctx->CommandQueues, ctx->ExtraBuffers[4], CL_FALSE, sizeof(cl_uint) * g_intensity, sizeof(cl_uint), BranchNonces + 2, 0, NULL, NULL)) != CL_SUCCESS)
-	{
-		printer::inst()->print_msg(L1,"Error %s when calling clEnqueueReadBuffer to fetch results.", err_to_str(ret));
-		return ERR_OCL_API;
-	}
-
-	if((ret = clEnqueueReadBuffer(ctx->CommandQueues, ctx->ExtraBuffers[5], CL_FALSE, sizeof(cl_uint) * g_intensity, sizeof(cl_uint), BranchNonces + 3, 0, NULL, NULL)) != CL_SUCCESS)
-	{
-		printer::inst()->print_msg(L1,"Error %s when calling clEnqueueReadBuffer to fetch results.", err_to_str(ret));
-		return ERR_OCL_API;
-	}
-
-	clFinish(ctx->CommandQueues);
-
+	// The branch sizes stay on the GPU, the hash kernels run on all threads and check the counter
 	for(int i = 0; i < 4; ++i)
 	{
-		if(BranchNonces[i])
+		if((ret = clEnqueueNDRangeKernel(ctx->CommandQueues, ctx->Kernels[i + 3], 1, &tmpNonce, &g_thd, &w_size, 0, NULL, NULL)) != CL_SUCCESS)
 		{
-			// Threads
-			if((clSetKernelArg(ctx->Kernels[i + 3], 4, sizeof(cl_ulong), BranchNonces + i)) != CL_SUCCESS)
-			{
-				printer::inst()->print_msg(L1,"Error %s when calling clSetKernelArg for kernel %d, argument %d.", err_to_str(ret), i + 3, 4);
-				return(ERR_OCL_API);
-			}
-
-			// round up to next multiple of w_size
-			BranchNonces[i] = ((BranchNonces[i] + w_size - 1u) / w_size) * w_size;
-			// number of global threads must be a multiple of the work group size (w_size)
-			assert(BranchNonces[i]%w_size == 0);
-			size_t tmpNonce = ctx->Nonce;
-			if((ret = clEnqueueNDRangeKernel(ctx->CommandQueues, ctx->Kernels[i + 3], 1, &tmpNonce, BranchNonces + i, &w_size, 0, NULL, NULL)) != CL_SUCCESS)
-			{
-				printer::inst()->print_msg(L1,"Error %s when calling clEnqueueNDRangeKernel for kernel %d.", err_to_str(ret), i + 3);
-				return ERR_OCL_API;
-			}
+			printer::inst()->print_msg(L1,"Error %s when calling clEnqueueNDRangeKernel for kernel %d.", err_to_str(ret), i + 3);
+			return ERR_OCL_API;
 		}
 	}
 
-	if((ret = clEnqueueReadBuffer(ctx->CommandQueues, ctx->OutputBuffer, CL_TRUE, 0, sizeof(cl_uint) * 0x100, HashOutput, 0, NULL, NULL)) != CL_SUCCESS)
+	size_t slot = ctx->RoundCnt & 1;
+	if((ret = clEnqueueReadBuffer(ctx->CommandQueues, ctx->OutputBuffer, CL_FALSE, 0, sizeof(cl_uint) * 0x100, ctx->OutputHost[slot], 0, NULL, &ctx->OutputEvent[slot])) != CL_SUCCESS)
 	{
 		printer::inst()->print_msg(L1,"Error %s when calling clEnqueueReadBuffer to fetch results.", err_to_str(ret));
 		return ERR_OCL_API;
 	}
 
-	clFinish(ctx->CommandQueues);
-	auto & numHashValues = HashOutput[0xFF];
-	// avoid out of memory read, we have only storage for 0xFF results
-	if(numHashValues > 0xFF)
-		numHashValues = 0xFF;
+	clFlush(ctx->CommandQueues);
+	ctx->RoundCnt++;
 	ctx->Nonce += g_intensity;
 
-	return ERR_SUCCESS;
+	return XMRReadResults(ctx, slot ^ 1, HashOutput);
+}
+
+size_t XMRFinishJob(GpuContext* ctx, cl_uint* HashOutput)
+{
+	return XMRReadResults(ctx, (ctx->RoundCnt - 1) & 1, HashOutput);
 }
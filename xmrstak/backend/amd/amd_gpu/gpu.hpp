@@ -40,6 +40,13 @@ struct GpuContext
 
 	uint32_t Nonce;
 
+	/* Two rounds are in flight, the results of one are read while the next one runs.
+	 * OutputEvent is NULL for a slot without a round.
+	 */
+	cl_event OutputEvent[2];
+	cl_uint OutputHost[2][0x100];
+	size_t RoundCnt;
+
 };
 
 uint32_t getNumPlatforms();
@@ -48,6 +55,9 @@ std::vector<GpuContext> getAMDDevices(int index);
 
 size_t InitOpenCL(GpuContext* ctx, size_t num_gpus, size_t platform_idx);
 size_t XMRSetJob(GpuContext* ctx, uint8_t* input, size_t input_len, uint64_t target);
+// Starts a round and returns the results of the round before, HashOutput[0xFF] is the count
 size_t XMRRunJob(GpuContext* ctx, cl_uint* HashOutput);
+// Returns the results of the last round, call it before the job changes
+size_t XMRFinishJob(GpuContext* ctx, cl_uint* HashOutput);
 
 
@@ -682,12 +682,15 @@ R"===(
 
 #define VSWAP4(x)	((((x) >> 24) & 0xFFU) | (((x) >> 8) & 0xFF00U) | (((x) << 8) & 0xFF0000U) | (((x) << 24) & 0xFF000000U))
 
+/* The hash kernels run on all threads of a round, the number of nonces in BranchBuf is only known on
+ * the device. Threads is the index of the counter cn2 keeps behind the nonces.
+ */
 __kernel void Skein(__global ulong *states, __global uint *BranchBuf, __global uint *output, ulong Target, ulong Threads)
 {
 	const ulong idx = get_global_id(0) - get_global_offset(0);
 	
 	// do not use early return here
-	if(idx < Threads)
+	if(idx < BranchBuf[Threads])
 	{
 		states += 25 * BranchBuf[idx];
 
@@ -749,7 +752,7 @@ __kernel void JH(__global ulong *states, __global uint *BranchBuf, __global uint
 	const uint idx = get_global_id(0) - get_global_offset(0);
 	
 	// do not use early return here
-	if(idx < Threads)
+	if(idx < BranchBuf[Threads])
 	{
 		states += 25 * BranchBuf[idx];
 
@@ -822,7 +825,7 @@ __kernel void Blake(__global ulong *states, __global uint *BranchBuf, __global u
 	const uint idx = get_global_id(0) - get_global_offset(0);
 	
 	// do not use early return here
-	if(idx < Threads)
+	if(idx < BranchBuf[Threads])
 	{
 		states += 25 * BranchBuf[idx];
 	
@@ -897,7 +900,7 @@ __kernel void Groestl(__global ulong *states, __global uint *BranchBuf, __global
 	const uint idx = get_global_id(0) - get_global_offset(0);
 	
 	// do not use early return here
-	if(idx < Threads)
+	if(idx < BranchBuf[Threads])
 	{
 		states += 25 * BranchBuf[idx];
 
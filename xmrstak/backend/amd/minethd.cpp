@@ -32,6 +32,7 @@
 #include "xmrstak/backend/cpu/minethd.hpp"
 #include "xmrstak/jconf.hpp"
 #include "xmrstak/misc/executor.hpp"
+#include "xmrstak/backend/result_verifier.hpp"
 #include "xmrstak/misc/environment.hpp"
 #include "xmrstak/params.hpp"
 #include "xmrstak/backend/cpu/hwlocMemory.hpp"
@@ -47,12 +48,13 @@ namespace xmrstak
 namespace amd
 {
 
-minethd::minethd(miner_work& pWork, size_t iNo, GpuContext* ctx, const jconf::thd_cfg cfg)
+minethd::minethd(miner_work& pWork, size_t iNo, GpuContext* ctx, const jconf::thd_cfg cfg, size_t iSlot)
 {
 	this->backendType = iBackend::AMD;
 	oWork = pWork;
 	bQuit = 0;
 	iThreadNo = (uint8_t)iNo;
+	iWorkSlot = iSlot;
 	iJobNo = 0;
 	iHashCount = 0;
 	iTimestamp = 0;
@@ -147,7 +149,8 @@ std::vector<iBackend*>* minethd::thread_starter(uint32_t threadOffset, miner_wor
 		else
 			printer::inst()->print_msg(L1, "Starting AMD GPU thread %d, no affinity.", i);
 
-		minethd* thd = new minethd(pWork, i + threadOffset, &vGpuData[i], cfg);
+		size_t slot = globalStates::inst().get_thread_slot(true, i, n);
+		minethd* thd = new minethd(pWork, i + threadOffset, &vGpuData[i], cfg, slot);
 		pvThreads->push_back(thd);
 	}
 
@@ -160,19 +163,20 @@ void minethd::switch_work(miner_work& pWork)
 	// faster than threads can consume them. This should never happen in real life.
 	// Pool cant physically send jobs faster than every 250ms or so due to net latency.
 
-	while (globalStates::inst().iConsumeCnt.load(std::memory_order_seq_cst) < globalStates::inst().iThreadCount)
+	work_slot& ws = globalStates::inst().get_slot(0);
+	while (ws.iConsumeCnt.load(std::memory_order_seq_cst) < ws.iThreadCount.load(std::memory_order_seq_cst))
 		std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
-	globalStates::inst().oGlobalWork = pWork;
-	globalStates::inst().iConsumeCnt.store(0, std::memory_order_seq_cst);
-	globalStates::inst().iGlobalJobNo++;
+	ws.oGlobalWork = pWork;
+	ws.iConsumeCnt.store(0, std::memory_order_seq_cst);
+	ws.iGlobalJobNo++;
 }
 
 void minethd::consume_work()
 {
-	memcpy(&oWork, &globalStates::inst().oGlobalWork, sizeof(miner_work));
+	memcpy(&oWork, &globalStates::inst().get_slot(iWorkSlot).oGlobalWork, sizeof(miner_work));
 	iJobNo++;
-	globalStates::inst().iConsumeCnt++;
+	globalStates::inst().count_consume(iWorkSlot, oWork, oJobLag);
 
 }
 
@@ -185,12 +189,10 @@ void minethd::work_main()
 	std::unique_lock<std::mutex> lck(thd_aff_set);
 	lck.release();
 	std::this_thread::yield();
+	tracer::set_thread_name("amd " + std::to_string(iThreadNo));
 
 	uint64_t iCount = 0;
-	cryptonight_ctx* cpu_ctx;
-	cpu_ctx = cpu::minethd::minethd_alloc_ctx();
-	cn_hash_fun hash_fun = cpu::minethd::func_selector(::jconf::inst()->HaveHardwareAes(), true /*bNoPrefetch*/, ::jconf::inst()->IsCurrencyMonero());
-	globalStates::inst().iConsumeCnt++;
+	globalStates::inst().get_slot(iWorkSlot).iConsumeCnt++;
 
 	while (bQuit == 0)
 	{
@@ -201,7 +203,7 @@ void minethd::work_main()
 			 * raison d'etre of this software it us sensible to just wait until we have something
 			 */
 
-			while (globalStates::inst().iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
+			while (globalStates::inst().get_slot(iWorkSlot).iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
 				std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
 			consume_work();
@@ -218,35 +220,23 @@ void minethd::work_main()
 		if(oWork.bNiceHash)
 			pGpuCtx->Nonce = *(uint32_t*)(oWork.bWorkBlob + 39);
 
-		while(globalStates::inst().iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
+		while(globalStates::inst().get_slot(iWorkSlot).iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
 		{
 			//Allocate a new nonce every 16 rounds
 			if((round_ctr++ & 0xF) == 0)
 			{
-				globalStates::inst().calc_start_nonce(pGpuCtx->Nonce, oWork.bNiceHash, h_per_round * 16);
+				globalStates::inst().calc_start_nonce(pGpuCtx->Nonce, oWork.bNiceHash, h_per_round * 16, iWorkSlot);
 			}
 
 			cl_uint results[0x100];
 			memset(results,0,sizeof(cl_uint)*(0x100));
 
+			// Gives the results of the round before, this one is already running
 			XMRRunJob(pGpuCtx, results);
 
+			// The CPU check runs in the verifier, the next kernel starts right away
 			for(size_t i = 0; i < results[0xFF]; i++)
-			{
-				uint8_t	bWorkBlob[112];
-				uint8_t	bResult[32];
-
-				memcpy(bWorkBlob, oWork.bWorkBlob, oWork.iWorkSize);
-				memset(bResult, 0, sizeof(job_result::bResult));
-
-				*(uint32_t*)(bWorkBlob + 39) = results[i];
-
-				hash_fun(bWorkBlob, oWork.iWorkSize, bResult, cpu_ctx);
-				if ( (*((uint64_t*)(bResult + 24))) < oWork.iTarget)
-					executor::inst()->push_event(ex_event(job_result(oWork.sJobID, results[i], bResult, iThreadNo), oWork.iPoolId));
-				else
-					executor::inst()->push_event(ex_event("AMD Invalid Result", oWork.iPoolId));
-			}
+				result_verifier::inst()->push_result(this, oWork, results[i]);
 
 			iCount += pGpuCtx->rawIntensity;
 			using namespace std::chrono;
@@ -256,6 +246,12 @@ void minethd::work_main()
 			std::this_thread::yield();
 		}
 
+		// The last round still belongs to the old job
+		cl_uint results[0x100];
+		XMRFinishJob(pGpuCtx, results);
+		for(size_t i = 0; i < results[0xFF]; i++)
+			result_verifier::inst()->push_result(this, oWork, results[i]);
+
 		consume_work();
 	}
 }
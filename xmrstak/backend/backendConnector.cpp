@@ -26,6 +26,7 @@
 #include "miner_work.hpp"
 #include "globalStates.hpp"
 #include "plugin.hpp"
+#include "result_verifier.hpp"
 #include "xmrstak/misc/environment.hpp"
 #include "xmrstak/misc/console.hpp"
 #include "xmrstak/params.hpp"
@@ -45,24 +46,37 @@
 #include <cstring>
 #include <thread>
 #include <bitset>
+#include <future>
 
 
 namespace xmrstak
 {
 
+static std::shared_future<bool> oSelfTest;
+
+void BackendConnector::start_self_test()
+{
+	oSelfTest = std::async(std::launch::async, cpu::minethd::self_test).share();
+}
+
 bool BackendConnector::self_test()
 {
-	return cpu::minethd::self_test();
+	if(!oSelfTest.valid())
+		start_self_test();
+	return oSelfTest.get();
 }
 
 std::vector<iBackend*>* BackendConnector::thread_starter(miner_work& pWork)
 {
-	globalStates::inst().iGlobalJobNo = 0;
-	globalStates::inst().iConsumeCnt = 0;
-
+	// It also sets up the large pages that the threads allocate their memory from
+	if(!self_test())
+		win_exit();
 
 	std::vector<iBackend*>* pvThreads = new std::vector<iBackend*>;
 
+	// Created before the GPU threads run, they all use the same instance
+	result_verifier::inst();
+
 #ifndef CONF_NO_CUDA
 	if(params::inst().useNVIDIA)
 	{
@@ -95,7 +109,6 @@ std::vector<iBackend*>* BackendConnector::thread_starter(miner_work& pWork)
 	}
 #endif
 
-	globalStates::inst().iThreadCount = pvThreads->size();
 	return pvThreads;
 }
 
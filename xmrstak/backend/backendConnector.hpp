@@ -14,7 +14,11 @@ namespace xmrstak
 
 	struct BackendConnector
 	{
+		// Waits for the self test and exits if it failed
 		static std::vector<iBackend*>* thread_starter(miner_work& pWork);
+		// Runs the self test on its own thread, the pools connect meanwhile
+		static void start_self_test();
+		// Result of the started self test, runs it if it wasn't started
 		static bool self_test();
 	};
 
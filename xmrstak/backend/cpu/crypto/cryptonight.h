@@ -9,11 +9,16 @@ extern "C" {
 #include <inttypes.h>
 #include "xmrstak/backend/cryptonight.hpp"
 
+// Parts of a hash the profiling kernels count cycles for
+enum cn_phase { CN_PHASE_KECCAK, CN_PHASE_EXPLODE, CN_PHASE_LOOP, CN_PHASE_IMPLODE, CN_PHASE_FINAL, CN_PHASE_COUNT };
 
 typedef struct {
 	uint8_t hash_state[224]; // Need only 200, explicit align
 	uint8_t* long_state;
 	uint8_t ctx_info[24]; //Use some of the extra memory for flags
+	// Only the profiling kernels write these, a multiway kernel counts all its hashes in the first ctx
+	uint64_t phase_cycles[CN_PHASE_COUNT];
+	uint64_t phase_hashes;
 } cryptonight_ctx;
 
 typedef struct {
@@ -287,13 +287,49 @@ void cn_implode_scratchpad(const __m128i* input, __m128i* output)
 	_mm_store_si128(output + 11, xout7);
 }
 
-template<size_t MASK, size_t ITERATIONS, size_t MEM, bool SOFT_AES, bool PREFETCH>
+// Cycle accounting for the profiling kernels, with PROFILE false it compiles to nothing.
+// rdtscp waits for the older instructions to finish, so a phase doesn't bleed into the next one.
+template<bool PROFILE>
+struct cn_phase_clock
+{
+	uint64_t iLast;
+
+	inline cn_phase_clock() : iLast(PROFILE ? read() : 0) {}
+
+	inline void mark(cryptonight_ctx* ctx, cn_phase phase)
+	{
+		if(PROFILE)
+		{
+			uint64_t iNow = read();
+			ctx->phase_cycles[phase] += iNow - iLast;
+			iLast = iNow;
+		}
+	}
+
+	inline void count(cryptonight_ctx* ctx, size_t iHashes)
+	{
+		if(PROFILE)
+			ctx->phase_hashes += iHashes;
+	}
+
+	static inline uint64_t read()
+	{
+		unsigned int aux;
+		return __rdtscp(&aux);
+	}
+};
+
+template<size_t MASK, size_t ITERATIONS, size_t MEM, bool SOFT_AES, bool PREFETCH, bool PROFILE = false>
 void cryptonight_hash(const void* input, size_t len, void* output, cryptonight_ctx* ctx0)
 {
+	cn_phase_clock<PROFILE> clock;
+
 	keccak((const uint8_t *)input, len, ctx0->hash_state, 200);
+	clock.mark(ctx0, CN_PHASE_KECCAK);
 
 	// Optim - 99% time boundary
 	cn_explode_scratchpad<MEM, SOFT_AES, PREFETCH>((__m128i*)ctx0->hash_state, (__m128i*)ctx0->long_state);
+	clock.mark(ctx0, CN_PHASE_EXPLODE);
 
 	uint8_t* l0 = ctx0->long_state;
 	uint64_t* h0 = (uint64_t*)ctx0->hash_state;
@@ -340,27 +376,36 @@ void cryptonight_hash(const void* input, size_t len, void* output, cryptonight_c
 			_mm_prefetch((const char*)&l0[idx0 & MASK], _MM_HINT_T0);
 	}
 
+	clock.mark(ctx0, CN_PHASE_LOOP);
+
 	// Optim - 90% time boundary
 	cn_implode_scratchpad<MEM, SOFT_AES, PREFETCH>((__m128i*)ctx0->long_state, (__m128i*)ctx0->hash_state);
+	clock.mark(ctx0, CN_PHASE_IMPLODE);
 
 	// Optim - 99% time boundary
 
 	keccakf((uint64_t*)ctx0->hash_state, 24);
 	extra_hashes[ctx0->hash_state[0] & 3](ctx0->hash_state, 200, (char*)output);
+	clock.mark(ctx0, CN_PHASE_FINAL);
+	clock.count(ctx0, 1);
 }
 
 // This lovely creation will do 2 cn hashes at a time. We have plenty of space on silicon
 // to fit temporary vars for two contexts. Function will read len*2 from input and write 64 bytes to output
 // We are still limited by L3 cache, so doubling will only work with CPUs where we have more than 2MB to core (Xeons)
-template<size_t MASK, size_t ITERATIONS, size_t MEM, bool SOFT_AES, bool PREFETCH>
+template<size_t MASK, size_t ITERATIONS, size_t MEM, bool SOFT_AES, bool PREFETCH, bool PROFILE = false>
 void cryptonight_double_hash(const void* input, size_t len, void* output, cryptonight_ctx** ctx)
 {
+	cn_phase_clock<PROFILE> clock;
+
 	keccak((const uint8_t *)input, len, ctx[0]->hash_state, 200);
 	keccak((const uint8_t *)input+len, len, ctx[1]->hash_state, 200);
+	clock.mark(ctx[0], CN_PHASE_KECCAK);
 
 	// Optim - 99% time boundary
 	cn_explode_scratchpad<MEM, SOFT_AES, PREFETCH>((__m128i*)ctx[0]->hash_state, (__m128i*)ctx[0]->long_state);
 	cn_explode_scratchpad<MEM, SOFT_AES, PREFETCH>((__m128i*)ctx[1]->hash_state, (__m128i*)ctx[1]->long_state);
+	clock.mark(ctx[0], CN_PHASE_EXPLODE);
 
 	uint8_t* l0 = ctx[0]->long_state;
 	uint64_t* h0 = (uint64_t*)ctx[0]->hash_state;
@@ -443,9 +488,12 @@ void cryptonight_double_hash(const void* input, size_t len, void* output, crypto
 			_mm_prefetch((const char*)&l1[idx1 & MASK], _MM_HINT_T0);
 	}
 
+	clock.mark(ctx[0], CN_PHASE_LOOP);
+
 	// Optim - 90% time boundary
 	cn_implode_scratchpad<MEM, SOFT_AES, PREFETCH>((__m128i*)ctx[0]->long_state, (__m128i*)ctx[0]->hash_state);
 	cn_implode_scratchpad<MEM, SOFT_AES, PREFETCH>((__m128i*)ctx[1]->long_state, (__m128i*)ctx[1]->hash_state);
+	clock.mark(ctx[0], CN_PHASE_IMPLODE);
 
 	// Optim - 99% time boundary
 
@@ -453,6 +501,8 @@ void cryptonight_double_hash(const void* input, size_t len, void* output, crypto
 	extra_hashes[ctx[0]->hash_state[0] & 3](ctx[0]->hash_state, 200, (char*)output);
 	keccakf((uint64_t*)ctx[1]->hash_state, 24);
 	extra_hashes[ctx[1]->hash_state[0] & 3](ctx[1]->hash_state, 200, (char*)output + 32);
+	clock.mark(ctx[0], CN_PHASE_FINAL);
+	clock.count(ctx[0], 2);
 }
 
 #define CN_STEP1(a, b, c, l, ptr, idx)				\
@@ -484,13 +534,17 @@ void cryptonight_double_hash(const void* input, size_t len, void* output, crypto
 	_mm_store_si128(ptr, a)
 
 // This lovelier creation will do 3 cn hashes at a time.
-template<size_t MASK, size_t ITERATIONS, size_t MEM, bool SOFT_AES, bool PREFETCH>
+template<size_t MASK, size_t ITERATIONS, size_t MEM, bool SOFT_AES, bool PREFETCH, bool PROFILE = false>
 void cryptonight_triple_hash(const void* input, size_t len, void* output, cryptonight_ctx** ctx)
 {
+	cn_phase_clock<PROFILE> clock;
+
 	for (size_t i = 0; i < 3; i++)
 	{
 		keccak((const uint8_t *)input + len * i, len, ctx[i]->hash_state, 200);
+		clock.mark(ctx[0], CN_PHASE_KECCAK);
 		cn_explode_scratchpad<MEM, SOFT_AES, PREFETCH>((__m128i*)ctx[i]->hash_state, (__m128i*)ctx[i]->long_state);
+		clock.mark(ctx[0], CN_PHASE_EXPLODE);
 	}
 
 	uint8_t* l0 = ctx[0]->long_state;
@@ -550,22 +604,31 @@ void cryptonight_triple_hash(const void* input, size_t len, void* output, crypto
 		CN_STEP4(ax2, cx2, bx2, l2, ptr2, idx2);
 	}
 
+	clock.mark(ctx[0], CN_PHASE_LOOP);
+
 	for (size_t i = 0; i < 3; i++)
 	{
 		cn_implode_scratchpad<MEM, SOFT_AES, PREFETCH>((__m128i*)ctx[i]->long_state, (__m128i*)ctx[i]->hash_state);
+		clock.mark(ctx[0], CN_PHASE_IMPLODE);
 		keccakf((uint64_t*)ctx[i]->hash_state, 24);
 		extra_hashes[ctx[i]->hash_state[0] & 3](ctx[i]->hash_state, 200, (char*)output + 32 * i);
+		clock.mark(ctx[0], CN_PHASE_FINAL);
 	}
+	clock.count(ctx[0], 3);
 }
 
 // This even lovelier creation will do 4 cn hashes at a time.
-template<size_t MASK, size_t ITERATIONS, size_t MEM, bool SOFT_AES, bool PREFETCH>
+template<size_t MASK, size_t ITERATIONS, size_t MEM, bool SOFT_AES, bool PREFETCH, bool PROFILE = false>
 void cryptonight_quad_hash(const void* input, size_t len, void* output, cryptonight_ctx** ctx)
 {
+	cn_phase_clock<PROFILE> clock;
+
 	for (size_t i = 0; i < 4; i++)
 	{
 		keccak((const uint8_t *)input + len * i, len, ctx[i]->hash_state, 200);
+		clock.mark(ctx[0], CN_PHASE_KECCAK);
 		cn_explode_scratchpad<MEM, SOFT_AES, PREFETCH>((__m128i*)ctx[i]->hash_state, (__m128i*)ctx[i]->long_state);
+		clock.mark(ctx[0], CN_PHASE_EXPLODE);
 	}
 
 	uint8_t* l0 = ctx[0]->long_state;
@@ -638,22 +701,31 @@ void cryptonight_quad_hash(const void* input, size_t len, void* output, cryptoni
 		CN_STEP4(ax3, cx3, bx3, l3, ptr3, idx3);
 	}
 
+	clock.mark(ctx[0], CN_PHASE_LOOP);
+
 	for (size_t i = 0; i < 4; i++)
 	{
 		cn_implode_scratchpad<MEM, SOFT_AES, PREFETCH>((__m128i*)ctx[i]->long_state, (__m128i*)ctx[i]->hash_state);
+		clock.mark(ctx[0], CN_PHASE_IMPLODE);
 		keccakf((uint64_t*)ctx[i]->hash_state, 24);
 		extra_hashes[ctx[i]->hash_state[0] & 3](ctx[i]->hash_state, 200, (char*)output + 32 * i);
+		clock.mark(ctx[0], CN_PHASE_FINAL);
 	}
+	clock.count(ctx[0], 4);
 }
 
 // This most lovely creation will do 5 cn hashes at a time.
-template<size_t MASK, size_t ITERATIONS, size_t MEM, bool SOFT_AES, bool PREFETCH>
+template<size_t MASK, size_t ITERATIONS, size_t MEM, bool SOFT_AES, bool PREFETCH, bool PROFILE = false>
 void cryptonight_penta_hash(const void* input, size_t len, void* output, cryptonight_ctx** ctx)
 {
+	cn_phase_clock<PROFILE> clock;
+
 	for (size_t i = 0; i < 5; i++)
 	{
 		keccak((const uint8_t *)input + len * i, len, ctx[i]->hash_state, 200);
+		clock.mark(ctx[0], CN_PHASE_KECCAK);
 		cn_explode_scratchpad<MEM, SOFT_AES, PREFETCH>((__m128i*)ctx[i]->hash_state, (__m128i*)ctx[i]->long_state);
+		clock.mark(ctx[0], CN_PHASE_EXPLODE);
 	}
 
 	uint8_t* l0 = ctx[0]->long_state;
@@ -739,10 +811,15 @@ void cryptonight_penta_hash(const void* input, size_t len, void* output, crypton
 		CN_STEP4(ax4, cx4, bx4, l4, ptr4, idx4);
 	}
 
+	clock.mark(ctx[0], CN_PHASE_LOOP);
+
 	for (size_t i = 0; i < 5; i++)
 	{
 		cn_implode_scratchpad<MEM, SOFT_AES, PREFETCH>((__m128i*)ctx[i]->long_state, (__m128i*)ctx[i]->hash_state);
+		clock.mark(ctx[0], CN_PHASE_IMPLODE);
 		keccakf((uint64_t*)ctx[i]->hash_state, 24);
 		extra_hashes[ctx[i]->hash_state[0] & 3](ctx[i]->hash_state, 200, (char*)output + 32 * i);
+		clock.mark(ctx[0], CN_PHASE_FINAL);
 	}
+	clock.count(ctx[0], 5);
 }
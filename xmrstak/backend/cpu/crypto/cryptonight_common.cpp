@@ -206,6 +206,15 @@ cryptonight_ctx* cryptonight_alloc_ctx(size_t use_fast_mem, size_t use_mlock, al
 		hashMemSize = AEON_MEMORY;
 	}
 	cryptonight_ctx* ptr = (cryptonight_ctx*)_mm_malloc(sizeof(cryptonight_ctx), 4096);
+	if(ptr == NULL)
+	{
+		if(msg != NULL)
+			msg->warning = "_mm_malloc failed";
+		return NULL;
+	}
+
+	memset(ptr->phase_cycles, 0, sizeof(ptr->phase_cycles));
+	ptr->phase_hashes = 0;
 
 	if(use_fast_mem == 0)
 	{
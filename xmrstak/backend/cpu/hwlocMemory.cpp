@@ -5,6 +5,19 @@
 #include "xmrstak/misc/console.hpp"
 
 #include <hwloc.h>
+#include <mutex>
+
+// Loading the topology takes a while on big hosts, the threads share one and only read it
+static hwloc_topology_t get_topology()
+{
+	static hwloc_topology_t topology;
+	static std::once_flag once;
+	std::call_once(once, [] {
+		hwloc_topology_init(&topology);
+		hwloc_topology_load(topology);
+	});
+	return topology;
+}
 
 /** pin memory to NUMA node
  *
@@ -16,15 +29,11 @@
 void bindMemoryToNUMANode( size_t puId )
 {
 	int depth;
-	hwloc_topology_t topology;
-
-	hwloc_topology_init(&topology);
-	hwloc_topology_load(topology);
+	hwloc_topology_t topology = get_topology();
 
 	if(!hwloc_topology_get_support(topology)->membind->set_thisthread_membind)
 	{
 		printer::inst()->print_msg(L0, "hwloc: set_thisthread_membind not supported");
-		hwloc_topology_destroy(topology);
 		return;
 	}
 
@@ -52,8 +61,6 @@ void bindMemoryToNUMANode( size_t puId )
 			}
 		}
 	}
-
-	hwloc_topology_destroy(topology);
 }
 #else
 
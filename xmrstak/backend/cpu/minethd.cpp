@@ -36,6 +36,8 @@
 
 #include "hwlocMemory.hpp"
 #include "xmrstak/backend/miner_work.hpp"
+#include "xmrstak/backend/perf_events.hpp"
+#include "xmrstak/misc/energy_meter.hpp"
 
 #ifndef CONF_NO_HWLOC
 #   include "autoAdjustHwloc.hpp"
@@ -92,18 +94,24 @@ bool minethd::thd_setaffinity(std::thread::native_handle_type h, uint64_t cpu_id
 #endif
 }
 
-minethd::minethd(miner_work& pWork, size_t iNo, int iMultiway, bool no_prefetch, int64_t affinity)
+minethd::minethd(miner_work& pWork, size_t iNo, int iMultiway, bool no_prefetch, int64_t affinity, size_t iSlot)
 {
 	this->backendType = iBackend::CPU;
 	oWork = pWork;
 	bQuit = 0;
 	iThreadNo = (uint8_t)iNo;
+	iWorkSlot = iSlot;
 	iJobNo = 0;
 	bNoPrefetch = no_prefetch;
+	bProfile = params::inst().profileCPU;
 	this->affinity = affinity;
+	iAffinity = affinity;
+	iPackage = energy_meter::get_cpu_package(affinity);
 
-	std::unique_lock<std::mutex> lck(thd_aff_set);
-	std::future<void> order_guard = order_fix.get_future();
+	// The thread waits on it until finish_start() has set the affinity, so that its memory
+	// is allocated on the right NUMA node
+	thd_aff_set.lock();
+	order_guard = order_fix.get_future();
 
 	switch (iMultiway)
 	{
@@ -495,12 +503,17 @@ minethd::minethd(miner_work& pWork, size_t iNo, int iMultiway, bool no_prefetch,
 			oWorkThd = std::thread(&minethd::work_main, this);
 			break;
 	}
+}
 
+void minethd::finish_start()
+{
 	order_guard.wait();
 
 	if(affinity >= 0) //-1 means no affinity
 		if(!thd_setaffinity(oWorkThd.native_handle(), affinity))
 			printer::inst()->print_msg(L1, "WARNING setting affinity failed.");
+
+	thd_aff_set.unlock();
 }
 
 cryptonight_ctx* minethd::minethd_alloc_ctx()
@@ -578,12 +591,16 @@ bool minethd::self_test()
 	if(res == 0 && fatal)
 		return false;
 
-	cryptonight_ctx *ctx[MAX_N] = {0};
-	for (int i = 0; i < MAX_N; i++)
+	bool mineMonero = ::jconf::inst()->IsCurrencyMonero();
+
+	// The hashes below go up to 5 ways, Aeon only tests the allocation
+	const size_t iTestN = mineMonero ? 5 : 1;
+	cryptonight_ctx *ctx[5] = {0};
+	for (size_t i = 0; i < iTestN; i++)
 	{
 		if ((ctx[i] = minethd_alloc_ctx()) == nullptr)
 		{
-			for (int j = 0; j < i; j++)
+			for (size_t j = 0; j < i; j++)
 				cryptonight_free_ctx(ctx[j]);
 			return false;
 		}
@@ -591,10 +608,9 @@ bool minethd::self_test()
 
 	bool bResult = true;
 
-	bool mineMonero = ::jconf::inst()->IsCurrencyMonero();
 	if(mineMonero)
 	{
-		unsigned char out[32 * MAX_N];
+		unsigned char out[32 * 5];
 		cn_hash_fun hashf;
 		cn_hash_fun_multi hashf_multi;
 
@@ -638,7 +654,7 @@ bool minethd::self_test()
 				"\xa0\x84\xf0\x1d\x14\x37\xa0\x9c\x69\x85\x40\x1b\x60\xd4\x35\x54\xae\x10\x58\x02\xc5\xf5\xd8\xa9\xb3\x25\x36\x49\xc0\xbe\x66\x05", 160) == 0;
 	}
 
-	for (int i = 0; i < MAX_N; i++)
+	for (size_t i = 0; i < iTestN; i++)
 		cryptonight_free_ctx(ctx[i]);
 
 	if(!bResult)
@@ -670,6 +686,10 @@ std::vector<iBackend*> minethd::thread_starter(uint32_t threadOffset, miner_work
 	size_t i, n = jconf::inst()->GetThreadCount();
 	pvThreads.reserve(n);
 
+	// All threads start at once and allocate their memory in parallel
+	std::vector<minethd*> vStarting;
+	vStarting.reserve(n);
+
 	jconf::thd_cfg cfg;
 	for (i = 0; i < n; i++)
 	{
@@ -686,49 +706,89 @@ std::vector<iBackend*> minethd::thread_starter(uint32_t threadOffset, miner_work
 		else
 			printer::inst()->print_msg(L1, "Starting %dx thread, no affinity.", cfg.iMultiway);
 		
-		minethd* thd = new minethd(pWork, i + threadOffset, cfg.iMultiway, cfg.bNoPrefetch, cfg.iCpuAff);
+		size_t slot = globalStates::inst().get_thread_slot(false, i, n);
+		minethd* thd = new minethd(pWork, i + threadOffset, cfg.iMultiway, cfg.bNoPrefetch, cfg.iCpuAff, slot);
 		pvThreads.push_back(thd);
+		vStarting.push_back(thd);
 	}
 
+	for(minethd* thd : vStarting)
+		thd->finish_start();
+
 	return pvThreads;
 }
 
 void minethd::consume_work()
 {
-	memcpy(&oWork, &globalStates::inst().inst().oGlobalWork, sizeof(miner_work));
+	memcpy(&oWork, &globalStates::inst().get_slot(iWorkSlot).oGlobalWork, sizeof(miner_work));
 	iJobNo++;
-	globalStates::inst().inst().iConsumeCnt++;
+	globalStates::inst().count_consume(iWorkSlot, oWork, oJobLag);
 }
 
-minethd::cn_hash_fun minethd::func_selector(bool bHaveAes, bool bNoPrefetch, bool mineMonero)
+void minethd::open_perf_events()
 {
-	// We have two independent flag bits in the functions
-	// therefore we will build a binary digit and select the
-	// function as a two digit binary
-	// Digit order SOFT_AES, NO_PREFETCH, MINER_ALGO
+	if(!params::inst().perfEvents)
+		return;
+
+	std::string err;
+	perf_events* perf = new perf_events;
+	if(perf->open(err))
+	{
+		pPerfEvents.store(perf);
+		return;
+	}
+	delete perf;
+
+	// Every thread fails for the same reason, one message is enough
+	static std::atomic_flag bWarned = ATOMIC_FLAG_INIT;
+	if(!bWarned.test_and_set())
+		printer::inst()->print_msg(L1, "PERF: No hardware counters, %s.", err.c_str());
+}
 
-	static const cn_hash_fun func_table[] = {
+static_assert(CN_PHASE_COUNT == iBackend::iPhaseCount, "iBackend needs a counter per kernel phase");
+
+void minethd::publish_phase_stats(cryptonight_ctx* ctx)
+{
+	for(size_t i = 0; i < CN_PHASE_COUNT; i++)
+		iPhaseCycles[i].store(ctx->phase_cycles[i], std::memory_order_relaxed);
+	iPhaseHashes.store(ctx->phase_hashes, std::memory_order_relaxed);
+}
+
+template<bool PROFILE>
+static minethd::cn_hash_fun func_table_entry(size_t idx)
+{
+	static const minethd::cn_hash_fun func_table[] = {
 		/* there will be 8 function entries if `CONF_NO_MONERO` and `CONF_NO_AEON`
 		 * is not defined. If one is defined there will be 4 entries.
 		 */
 #ifndef CONF_NO_MONERO
-		cryptonight_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, false>,
-		cryptonight_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, true>,
-		cryptonight_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, false>,
-		cryptonight_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, true>
+		cryptonight_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, false, PROFILE>,
+		cryptonight_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, true, PROFILE>,
+		cryptonight_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, false, PROFILE>,
+		cryptonight_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, true, PROFILE>
 #endif
 #if (!defined(CONF_NO_AEON)) && (!defined(CONF_NO_MONERO))
 		// comma will be added only if Monero and Aeon is build
 		,
 #endif
 #ifndef CONF_NO_AEON
-		cryptonight_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, false>,
-		cryptonight_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, true>,
-		cryptonight_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, false>,
-		cryptonight_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, true>
+		cryptonight_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, false, PROFILE>,
+		cryptonight_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, true, PROFILE>,
+		cryptonight_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, false, PROFILE>,
+		cryptonight_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, true, PROFILE>
 #endif
 	};
 
+	return func_table[idx];
+}
+
+minethd::cn_hash_fun minethd::func_selector(bool bHaveAes, bool bNoPrefetch, bool mineMonero, bool bProfile)
+{
+	// We have two independent flag bits in the functions
+	// therefore we will build a binary digit and select the
+	// function as a two digit binary
+	// Digit order SOFT_AES, NO_PREFETCH, MINER_ALGO
+
 	std::bitset<3> digit;
 	digit.set(0, !bNoPrefetch);
 	digit.set(1, !bHaveAes);
@@ -741,7 +801,9 @@ minethd::cn_hash_fun minethd::func_selector(bool bHaveAes, bool bNoPrefetch, boo
 	digit.set(2, !mineMonero);
 #endif
 
-	return func_table[digit.to_ulong()];
+	if(bProfile)
+		return func_table_entry<true>(digit.to_ulong());
+	return func_table_entry<false>(digit.to_ulong());
 }
 
 void minethd::work_main()
@@ -753,6 +815,8 @@ void minethd::work_main()
 	std::unique_lock<std::mutex> lck(thd_aff_set);
 	lck.release();
 	std::this_thread::yield();
+	open_perf_events();
+	tracer::set_thread_name("cpu " + std::to_string(iThreadNo));
 
 	cn_hash_fun hash_fun;
 	cryptonight_ctx* ctx;
@@ -761,12 +825,12 @@ void minethd::work_main()
 	uint32_t* piNonce;
 	job_result result;
 
-	hash_fun = func_selector(::jconf::inst()->HaveHardwareAes(), bNoPrefetch, ::jconf::inst()->IsCurrencyMonero());
+	hash_fun = func_selector(::jconf::inst()->HaveHardwareAes(), bNoPrefetch, ::jconf::inst()->IsCurrencyMonero(), bProfile);
 	ctx = minethd_alloc_ctx();
 
 	piHashVal = (uint64_t*)(result.bResult + 24);
 	piNonce = (uint32_t*)(oWork.bWorkBlob + 39);
-	globalStates::inst().inst().iConsumeCnt++;
+	globalStates::inst().get_slot(iWorkSlot).iConsumeCnt++;
 	result.iThreadId = iThreadNo;
 
 	while (bQuit == 0)
@@ -778,7 +842,7 @@ void minethd::work_main()
 			 * raison d'etre of this software it us sensible to just wait until we have something
 			 */
 
-			while (globalStates::inst().iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
+			while (globalStates::inst().get_slot(iWorkSlot).iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
 				std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
 			consume_work();
@@ -794,7 +858,7 @@ void minethd::work_main()
 		if(oWork.bNiceHash)
 			result.iNonce = *piNonce;
 
-		while(globalStates::inst().iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
+		while(globalStates::inst().get_slot(iWorkSlot).iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
 		{
 			if ((iCount++ & 0xF) == 0) //Store stats every 16 hashes
 			{
@@ -802,11 +866,13 @@ void minethd::work_main()
 				uint64_t iStamp = time_point_cast<milliseconds>(high_resolution_clock::now()).time_since_epoch().count();
 				iHashCount.store(iCount, std::memory_order_relaxed);
 				iTimestamp.store(iStamp, std::memory_order_relaxed);
+				if(bProfile)
+					publish_phase_stats(ctx);
 			}
 
 			if((nonce_ctr++ & (nonce_chunk-1)) == 0)
 			{
-				globalStates::inst().calc_start_nonce(result.iNonce, oWork.bNiceHash, nonce_chunk);
+				globalStates::inst().calc_start_nonce(result.iNonce, oWork.bNiceHash, nonce_chunk, iWorkSlot);
 			}
 
 			*piNonce = ++result.iNonce;
@@ -814,7 +880,11 @@ void minethd::work_main()
 			hash_fun(oWork.bWorkBlob, oWork.iWorkSize, result.bResult, ctx);
 
 			if (*piHashVal < oWork.iTarget)
+			{
+				result.iFoundStamp = get_timestamp_us();
+				trace_instant("share_found", "share", result.iNonce);
 				executor::inst()->push_event(ex_event(result, oWork.iPoolId));
+			}
 
 			std::this_thread::yield();
 		}
@@ -825,59 +895,65 @@ void minethd::work_main()
 	cryptonight_free_ctx(ctx);
 }
 
-minethd::cn_hash_fun_multi minethd::func_multi_selector(size_t N, bool bHaveAes, bool bNoPrefetch, bool mineMonero)
+template<bool PROFILE>
+static minethd::cn_hash_fun_multi func_multi_table_entry(size_t idx)
 {
-	// We have two independent flag bits in the functions
-	// therefore we will build a binary digit and select the
-	// function as a two digit binary
-	// Digit order SOFT_AES, NO_PREFETCH
-
-	static const cn_hash_fun_multi func_table[] = {
+	static const minethd::cn_hash_fun_multi func_table[] = {
 		/* there will be 8*(MAX_N-1) function entries if `CONF_NO_MONERO` and `CONF_NO_AEON`
 		 * is not defined. If one is defined there will be 4*(MAX_N-1) entries.
 		 */
 #ifndef CONF_NO_MONERO
-		cryptonight_double_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, false>,
-		cryptonight_double_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, true>,
-		cryptonight_double_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, false>,
-		cryptonight_double_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, true>,
-		cryptonight_triple_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, false>,
-		cryptonight_triple_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, true>,
-		cryptonight_triple_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, false>,
-		cryptonight_triple_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, true>,
-		cryptonight_quad_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, false>,
-		cryptonight_quad_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, true>,
-		cryptonight_quad_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, false>,
-		cryptonight_quad_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, true>,
-		cryptonight_penta_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, false>,
-		cryptonight_penta_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, true>,
-		cryptonight_penta_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, false>,
-		cryptonight_penta_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, true>
+		cryptonight_double_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, false, PROFILE>,
+		cryptonight_double_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, true, PROFILE>,
+		cryptonight_double_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, false, PROFILE>,
+		cryptonight_double_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, true, PROFILE>,
+		cryptonight_triple_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, false, PROFILE>,
+		cryptonight_triple_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, true, PROFILE>,
+		cryptonight_triple_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, false, PROFILE>,
+		cryptonight_triple_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, true, PROFILE>,
+		cryptonight_quad_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, false, PROFILE>,
+		cryptonight_quad_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, true, PROFILE>,
+		cryptonight_quad_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, false, PROFILE>,
+		cryptonight_quad_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, true, PROFILE>,
+		cryptonight_penta_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, false, PROFILE>,
+		cryptonight_penta_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, false, true, PROFILE>,
+		cryptonight_penta_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, false, PROFILE>,
+		cryptonight_penta_hash<MONERO_MASK, MONERO_ITER, MONERO_MEMORY, true, true, PROFILE>
 #endif
 #if (!defined(CONF_NO_AEON)) && (!defined(CONF_NO_MONERO))
 		// comma will be added only if Monero and Aeon is build
 		,
 #endif
 #ifndef CONF_NO_AEON
-		cryptonight_double_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, false>,
-		cryptonight_double_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, true>,
-		cryptonight_double_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, false>,
-		cryptonight_double_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, true>,
-		cryptonight_triple_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, false>,
-		cryptonight_triple_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, true>,
-		cryptonight_triple_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, false>,
-		cryptonight_triple_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, true>,
-		cryptonight_quad_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, false>,
-		cryptonight_quad_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, true>,
-		cryptonight_quad_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, false>,
-		cryptonight_quad_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, true>,
-		cryptonight_penta_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, false>,
-		cryptonight_penta_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, true>,
-		cryptonight_penta_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, false>,
-		cryptonight_penta_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, true>
+		cryptonight_double_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, false, PROFILE>,
+		cryptonight_double_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, true, PROFILE>,
+		cryptonight_double_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, false, PROFILE>,
+		cryptonight_double_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, true, PROFILE>,
+		cryptonight_triple_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, false, PROFILE>,
+		cryptonight_triple_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, true, PROFILE>,
+		cryptonight_triple_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, false, PROFILE>,
+		cryptonight_triple_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, true, PROFILE>,
+		cryptonight_quad_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, false, PROFILE>,
+		cryptonight_quad_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, true, PROFILE>,
+		cryptonight_quad_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, false, PROFILE>,
+		cryptonight_quad_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, true, PROFILE>,
+		cryptonight_penta_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, false, PROFILE>,
+		cryptonight_penta_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, false, true, PROFILE>,
+		cryptonight_penta_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, false, PROFILE>,
+		cryptonight_penta_hash<AEON_MASK, AEON_ITER, AEON_MEMORY, true, true, PROFILE>
 #endif
 	};
 
+	return func_table[idx];
+}
+
+minethd::cn_hash_fun_multi minethd::func_multi_selector(size_t N, bool bHaveAes, bool bNoPrefetch, bool mineMonero, bool bProfile)
+{
+	// We have two independent flag bits in the functions
+	// therefore we will build a binary digit and select the
+	// function as a two digit binary
+	// Digit order SOFT_AES, NO_PREFETCH
+
 	std::bitset<2> digit;
 	digit.set(0, !bNoPrefetch);
 	digit.set(1, !bHaveAes);
@@ -891,7 +967,10 @@ minethd::cn_hash_fun_multi minethd::func_multi_selector(size_t N, bool bHaveAes,
 #endif
 
 	N = (N<2) ? 2 : (N>MAX_N) ? MAX_N : N;
-	return func_table[miner_algo_base + 4*(N-2) + digit.to_ulong()];
+	size_t idx = miner_algo_base + 4*(N-2) + digit.to_ulong();
+	if(bProfile)
+		return func_multi_table_entry<true>(idx);
+	return func_multi_table_entry<false>(idx);
 }
 
 void minethd::double_work_main()
@@ -1447,6 +1526,8 @@ void minethd::multiway_work_main(cn_hash_fun_multi hash_fun_multi)
 	std::unique_lock<std::mutex> lck(thd_aff_set);
 	lck.release();
 	std::this_thread::yield();
+	open_perf_events();
+	tracer::set_thread_name("cpu " + std::to_string(iThreadNo));
 
 	cryptonight_ctx *ctx[MAX_N];
 	uint64_t iCount = 0;
@@ -1457,6 +1538,10 @@ void minethd::multiway_work_main(cn_hash_fun_multi hash_fun_multi)
 	uint32_t iNonce;
 	job_result res;
 
+	// The x*_work_main entry points pick the plain kernels
+	if(bProfile)
+		hash_fun_multi = func_multi_selector(N, ::jconf::inst()->HaveHardwareAes(), bNoPrefetch, ::jconf::inst()->IsCurrencyMonero(), true);
+
 	for (size_t i = 0; i < N; i++)
 	{
 		ctx[i] = minethd_alloc_ctx();
@@ -1467,7 +1552,7 @@ void minethd::multiway_work_main(cn_hash_fun_multi hash_fun_multi)
 	if(!oWork.bStall)
 		prep_multiway_work<N>(bWorkBlob, piNonce);
 
-	globalStates::inst().iConsumeCnt++;
+	globalStates::inst().get_slot(iWorkSlot).iConsumeCnt++;
 
 	while (bQuit == 0)
 	{
@@ -1477,7 +1562,7 @@ void minethd::multiway_work_main(cn_hash_fun_multi hash_fun_multi)
 			either because of network latency, or a socket problem. Since we are
 			raison d'etre of this software it us sensible to just wait until we have something*/
 
-			while (globalStates::inst().iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
+			while (globalStates::inst().get_slot(iWorkSlot).iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
 				std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
 			consume_work();
@@ -1493,7 +1578,7 @@ void minethd::multiway_work_main(cn_hash_fun_multi hash_fun_multi)
 		if(oWork.bNiceHash)
 			iNonce = *piNonce[0];
 
-		while (globalStates::inst().iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
+		while (globalStates::inst().get_slot(iWorkSlot).iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
 		{
 			if ((iCount++ & 0x7) == 0)  //Store stats every 8*N hashes
 			{
@@ -1501,12 +1586,14 @@ void minethd::multiway_work_main(cn_hash_fun_multi hash_fun_multi)
 				uint64_t iStamp = time_point_cast<milliseconds>(high_resolution_clock::now()).time_since_epoch().count();
 				iHashCount.store(iCount * N, std::memory_order_relaxed);
 				iTimestamp.store(iStamp, std::memory_order_relaxed);
+				if(bProfile)
+					publish_phase_stats(ctx[0]);
 			}
 
 			nonce_ctr -= N;
 			if(nonce_ctr <= 0)
 			{
-				globalStates::inst().calc_start_nonce(iNonce, oWork.bNiceHash, nonce_chunk);
+				globalStates::inst().calc_start_nonce(iNonce, oWork.bNiceHash, nonce_chunk, iWorkSlot);
 				nonce_ctr = nonce_chunk;
 			}
 
@@ -1519,7 +1606,10 @@ void minethd::multiway_work_main(cn_hash_fun_multi hash_fun_multi)
 			{
 				if (*piHashVal[i] < oWork.iTarget)
 				{
-					executor::inst()->push_event(ex_event(job_result(oWork.sJobID, iNonce - N + 1 + i, bHashOut + 32 * i, iThreadNo), oWork.iPoolId));
+					job_result res(oWork.sJobID, iNonce - N + 1 + i, bHashOut + 32 * i, iThreadNo);
+					res.iFoundStamp = get_timestamp_us();
+					trace_instant("share_found", "share", res.iNonce);
+					executor::inst()->push_event(ex_event(res, oWork.iPoolId));
 				}
 			}
 
@@ -23,16 +23,20 @@ public:
 
 	typedef void (*cn_hash_fun)(const void*, size_t, void*, cryptonight_ctx*);
 
-	static cn_hash_fun func_selector(bool bHaveAes, bool bNoPrefetch, bool mineMonero);
+	// bProfile picks the kernels that count cycles per phase in the ctx, see cn_phase_clock
+	static cn_hash_fun func_selector(bool bHaveAes, bool bNoPrefetch, bool mineMonero, bool bProfile = false);
+
+	// N blobs of the same length back to back in the input, N hashes out, N is 2 to 5
+	typedef void (*cn_hash_fun_multi)(const void*, size_t, void*, cryptonight_ctx**);
+	static cn_hash_fun_multi func_multi_selector(size_t N, bool bHaveAes, bool bNoPrefetch, bool mineMonero, bool bProfile = false);
 	static bool thd_setaffinity(std::thread::native_handle_type h, uint64_t cpu_id);
 
 	static cryptonight_ctx* minethd_alloc_ctx();
 
 private:
-	typedef void (*cn_hash_fun_multi)(const void*, size_t, void*, cryptonight_ctx**);
-	static cn_hash_fun_multi func_multi_selector(size_t N, bool bHaveAes, bool bNoPrefetch, bool mineMonero);
-
-	minethd(miner_work& pWork, size_t iNo, int iMultiway, bool no_prefetch, int64_t affinity);
+	minethd(miner_work& pWork, size_t iNo, int iMultiway, bool no_prefetch, int64_t affinity, size_t iSlot);
+	// Waits until the thread runs and pins it, the constructor returns right away
+	void finish_start();
 
 	template<size_t N>
 	void multiway_work_main(cn_hash_fun_multi hash_fun_multi);
@@ -176,6 +180,9 @@ private:
 	void x128_work_main();
 
 	void consume_work();
+	void publish_phase_stats(cryptonight_ctx* ctx);
+	// Called by the mining thread, the counters count the calling thread
+	void open_perf_events();
 
 	uint64_t iJobNo;
 
@@ -183,6 +190,7 @@ private:
 	miner_work oWork;
 
 	std::promise<void> order_fix;
+	std::future<void> order_guard;
 	std::mutex thd_aff_set;
 
 	std::thread oWorkThd;
@@ -190,6 +198,7 @@ private:
 
 	bool bQuit;
 	bool bNoPrefetch;
+	bool bProfile;
 };
 
 } // namespace cpu
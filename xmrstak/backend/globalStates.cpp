@@ -28,29 +28,69 @@
 #include <cmath>
 #include <chrono>
 #include <cstring>
+#include <thread>
 
 
 namespace xmrstak
 {
 
 
-void globalStates::switch_work(miner_work& pWork, pool_data& dat)
+void globalStates::switch_work(miner_work& pWork, pool_data& dat, size_t slot)
 {
+	work_slot& ws = oSlots[slot];
+	trace_scope oTrace("switch_work", "job", slot);
+
 	// iConsumeCnt is a basic lock-like polling mechanism just in case we happen to push work
 	// faster than threads can consume them. This should never happen in real life.
 	// Pool cant physically send jobs faster than every 250ms or so due to net latency.
 
-	while (iConsumeCnt.load(std::memory_order_seq_cst) < iThreadCount)
+	while (ws.iConsumeCnt.load(std::memory_order_seq_cst) < ws.iThreadCount.load(std::memory_order_seq_cst))
 		std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
 	size_t xid = dat.pool_id;
-	dat.pool_id = pool_id;
-	pool_id = xid;
+	dat.pool_id = ws.pool_id;
+	ws.pool_id = xid;
+
+	dat.iSavedNonce = ws.iGlobalNonce.exchange(dat.iSavedNonce, std::memory_order_seq_cst);
+	ws.oGlobalWork = pWork;
+	ws.iConsumeCnt.store(0, std::memory_order_seq_cst);
+	ws.iGlobalJobNo++;
+}
+
+void globalStates::set_split_shares(size_t slot, uint32_t cpu_share, uint32_t gpu_share)
+{
+	assert(slot < iMaxSlots);
+	iCpuShare[slot] = cpu_share;
+	iGpuShare[slot] = gpu_share;
+	if(slot >= iSlotCount)
+		iSlotCount = slot + 1;
+}
+
+size_t globalStates::get_thread_slot(bool is_gpu, size_t idx, size_t count)
+{
+	const uint32_t* share = is_gpu ? iGpuShare : iCpuShare;
+
+	uint64_t total = 0;
+	for(size_t i = 0; i < iSlotCount; i++)
+		total += share[i];
+
+	// Threads are placed at the middle of their 1/count wide interval of the total share,
+	// so 70/30 over 10 threads gives 7 and 3
+	size_t slot = 0;
+	if(total != 0 && count != 0)
+	{
+		uint64_t pos = ((2 * idx + 1) * total) / (2 * count);
+		uint64_t sum = 0;
+		for(slot = 0; slot < iSlotCount; slot++)
+		{
+			sum += share[slot];
+			if(pos < sum)
+				break;
+		}
+	}
 
-	dat.iSavedNonce = iGlobalNonce.exchange(dat.iSavedNonce, std::memory_order_seq_cst);
-	oGlobalWork = pWork;
-	iConsumeCnt.store(0, std::memory_order_seq_cst);
-	iGlobalJobNo++;
+	oSlots[slot].iThreadCount++;
+	return slot;
 }
 
 } // namepsace xmrstak
@@ -3,6 +3,8 @@
 #include "miner_work.hpp"
 #include "xmrstak/misc/environment.hpp"
 #include "xmrstak/misc/console.hpp"
+#include "xmrstak/misc/latency_hist.hpp"
+#include "xmrstak/misc/tracer.hpp"
 
 #include <atomic>
 
@@ -21,6 +23,23 @@ struct pool_data
 	}
 };
 
+/* One job stream, with the threads that mine it. Without split mining
+ * every thread is in slot 0.
+ */
+struct work_slot
+{
+	miner_work oGlobalWork;
+	std::atomic<uint64_t> iGlobalJobNo;
+	std::atomic<uint64_t> iConsumeCnt;
+	std::atomic<uint32_t> iGlobalNonce;
+	std::atomic<uint64_t> iThreadCount;
+	size_t pool_id = invalid_pool_id;
+
+	work_slot() : iGlobalJobNo(0), iConsumeCnt(0), iGlobalNonce(0), iThreadCount(0)
+	{
+	}
+};
+
 struct globalStates
 {
 	static inline globalStates& inst()
@@ -31,28 +50,64 @@ struct globalStates
 		return *env.pglobalStates;
 	}
 
+	constexpr static size_t iMaxSlots = 4;
+
 	//pool_data is in-out winapi style
-	void switch_work(miner_work& pWork, pool_data& dat);
+	void switch_work(miner_work& pWork, pool_data& dat, size_t slot = 0);
 
-	inline void calc_start_nonce(uint32_t& nonce, bool use_nicehash, uint32_t reserve_count)
+	inline void calc_start_nonce(uint32_t& nonce, bool use_nicehash, uint32_t reserve_count, size_t slot = 0)
 	{
 		if(use_nicehash)
-			nonce = (nonce & 0xFF000000) | iGlobalNonce.fetch_add(reserve_count);
+			nonce = (nonce & 0xFF000000) | oSlots[slot].iGlobalNonce.fetch_add(reserve_count);
 		else
-			nonce = iGlobalNonce.fetch_add(reserve_count);
+			nonce = oSlots[slot].iGlobalNonce.fetch_add(reserve_count);
 	}
 
-	miner_work oGlobalWork;
-	std::atomic<uint64_t> iGlobalJobNo;
-	std::atomic<uint64_t> iConsumeCnt;
-	std::atomic<uint32_t> iGlobalNonce;
-	uint64_t iThreadCount;
-	size_t pool_id = invalid_pool_id;
+	// Called by the threads instead of iConsumeCnt++ once they copied a new job. Records the lag
+	// of the thread and, from the last thread of the slot, the lag until all of them hash the job.
+	inline void count_consume(size_t slot, const miner_work& oWork, latency_hist& oThreadLag)
+	{
+		uint64_t iStamp = oWork.iRecvStamp != 0 ? get_timestamp_us() : 0;
+		work_slot& ws = oSlots[slot];
+		uint64_t iConsumed = ws.iConsumeCnt.fetch_add(1, std::memory_order_seq_cst) + 1;
+		trace_instant("consume_work", "job", slot);
+
+		if(iStamp == 0)
+			return;
+
+		uint64_t iLag = iStamp > oWork.iRecvStamp ? iStamp - oWork.iRecvStamp : 0;
+		oThreadLag.add(iLag);
+		if(iConsumed == ws.iThreadCount.load(std::memory_order_relaxed))
+			oJobStartLag.add(iLag);
+	}
+
+	// From the arrival of a job until the last thread of its slot started hashing it
+	latency_hist oJobStartLag;
+
+	inline work_slot& get_slot(size_t slot) { return oSlots[slot]; }
+	inline size_t get_slot_count() { return iSlotCount; }
+
+	// Split mining - share of the cpu and gpu threads for each slot, has to be set before the backends start
+	void set_split_shares(size_t slot, uint32_t cpu_share, uint32_t gpu_share);
+
+	// Called once per thread by the backends, cpu and gpu threads are divided separately
+	size_t get_thread_slot(bool is_gpu, size_t idx, size_t count);
+
+	// Slots other than 0 start at a different nonce, so that they can mine the same job as slot 0
+	inline uint32_t get_slot_start_nonce(size_t slot, bool use_nicehash)
+	{
+		return use_nicehash ? uint32_t(slot) << 22 : uint32_t(slot) << 30;
+	}
 
 private:
-	globalStates() : iThreadCount(0)
+	globalStates()
 	{
 	}
+
+	work_slot oSlots[iMaxSlots];
+	uint32_t iCpuShare[iMaxSlots] = { 0 };
+	uint32_t iGpuShare[iMaxSlots] = { 0 };
+	size_t iSlotCount = 1;
 };
 
 } // namepsace xmrstak
@@ -16,6 +16,8 @@ constexpr std::size_t countof(T const (&)[N]) noexcept
 
 namespace xmrstak
 {
+	class perf_events;
+
 	struct iBackend
 	{
 
@@ -39,11 +41,28 @@ namespace xmrstak
 
 		std::atomic<uint64_t> iHashCount;
 		std::atomic<uint64_t> iTimestamp;
+		// Results the CPU check rejected, GPU backends only
+		std::atomic<uint64_t> iInvalidCount;
+		// Cycles per hash kernel phase (keccak, explode, loop, implode, final) and the hashes
+		// they add up over, CPU backend with --profile-cpu only
+		static constexpr size_t iPhaseCount = 5;
+		std::atomic<uint64_t> iPhaseCycles[iPhaseCount];
+		std::atomic<uint64_t> iPhaseHashes;
+		// Hardware counters of the thread with --perf-events, set once by the thread and never freed
+		std::atomic<perf_events*> pPerfEvents;
+		// From the arrival of a job until this thread hashes it, see globalStates::count_consume
+		latency_hist oJobLag;
 		uint32_t iThreadNo;
+		// Logical cpu and physical CPU package the thread is pinned to, -1 if it isn't or we don't know
+		int64_t iAffinity = -1;
+		int32_t iPackage = -1;
+		size_t iWorkSlot = 0;
 		BackendType backendType = UNKNOWN;
 
-		iBackend() : iHashCount(0), iTimestamp(0)
+		iBackend() : iHashCount(0), iTimestamp(0), iInvalidCount(0), iPhaseHashes(0), pPerfEvents(nullptr)
 		{
+			for(std::atomic<uint64_t>& c : iPhaseCycles)
+				c.store(0, std::memory_order_relaxed);
 		}
 	};
 
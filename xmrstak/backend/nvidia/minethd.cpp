@@ -29,6 +29,7 @@
 #include "xmrstak/backend/cpu/minethd.hpp"
 #include "xmrstak/params.hpp"
 #include "xmrstak/misc/executor.hpp"
+#include "xmrstak/backend/result_verifier.hpp"
 #include "xmrstak/jconf.hpp"
 #include "xmrstak/misc/environment.hpp"
 #include "xmrstak/backend/cpu/hwlocMemory.hpp"
@@ -64,12 +65,13 @@ namespace nvidia
 	void *lib_handle;
 #endif
 
-minethd::minethd(miner_work& pWork, size_t iNo, const jconf::thd_cfg& cfg)
+minethd::minethd(miner_work& pWork, size_t iNo, const jconf::thd_cfg& cfg, size_t iSlot)
 {
 	this->backendType = iBackend::NVIDIA;
 	oWork = pWork;
 	bQuit = 0;
 	iThreadNo = (uint8_t)iNo;
+	iWorkSlot = iSlot;
 	iJobNo = 0;
 
 	ctx.device_id = (int)cfg.id;
@@ -174,7 +176,8 @@ std::vector<iBackend*>* minethd::thread_starter(uint32_t threadOffset, miner_wor
 		else
 			printer::inst()->print_msg(L1, "Starting NVIDIA GPU thread %d, no affinity.", i);
 		
-		minethd* thd = new minethd(pWork, i + threadOffset, cfg);
+		size_t slot = globalStates::inst().get_thread_slot(true, i, n);
+		minethd* thd = new minethd(pWork, i + threadOffset, cfg, slot);
 		pvThreads->push_back(thd);
 
 	}
@@ -188,19 +191,20 @@ void minethd::switch_work(miner_work& pWork)
 	// faster than threads can consume them. This should never happen in real life.
 	// Pool cant physically send jobs faster than every 250ms or so due to net latency.
 
-	while (globalStates::inst().iConsumeCnt.load(std::memory_order_seq_cst) < globalStates::inst().iThreadCount)
+	work_slot& ws = globalStates::inst().get_slot(0);
+	while (ws.iConsumeCnt.load(std::memory_order_seq_cst) < ws.iThreadCount.load(std::memory_order_seq_cst))
 		std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
-	globalStates::inst().oGlobalWork = pWork;
-	globalStates::inst().iConsumeCnt.store(0, std::memory_order_seq_cst);
-	globalStates::inst().iGlobalJobNo++;
+	ws.oGlobalWork = pWork;
+	ws.iConsumeCnt.store(0, std::memory_order_seq_cst);
+	ws.iGlobalJobNo++;
 }
 
 void minethd::consume_work()
 {
-	memcpy(&oWork, &globalStates::inst().oGlobalWork, sizeof(miner_work));
+	memcpy(&oWork, &globalStates::inst().get_slot(iWorkSlot).oGlobalWork, sizeof(miner_work));
 	iJobNo++;
-	globalStates::inst().iConsumeCnt++;
+	globalStates::inst().count_consume(iWorkSlot, oWork, oJobLag);
 }
 
 void minethd::work_main()
@@ -212,14 +216,12 @@ void minethd::work_main()
 	std::unique_lock<std::mutex> lck(thd_aff_set);
 	lck.release();
 	std::this_thread::yield();
+	tracer::set_thread_name("nvidia " + std::to_string(iThreadNo));
 
 	uint64_t iCount = 0;
-	cryptonight_ctx* cpu_ctx;
-	cpu_ctx = cpu::minethd::minethd_alloc_ctx();
-	cn_hash_fun hash_fun = cpu::minethd::func_selector(::jconf::inst()->HaveHardwareAes(), true /*bNoPrefetch*/, ::jconf::inst()->IsCurrencyMonero());
 	uint32_t iNonce;
 
-	globalStates::inst().iConsumeCnt++;
+	globalStates::inst().get_slot(iWorkSlot).iConsumeCnt++;
 
 	if(cuda_get_deviceinfo(&ctx) != 0 || cryptonight_extra_cpu_init(&ctx) != 1)
 	{
@@ -238,7 +240,7 @@ void minethd::work_main()
 			 * raison d'etre of this software it us sensible to just wait until we have something
 			 */
 
-			while (globalStates::inst().iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
+			while (globalStates::inst().get_slot(iWorkSlot).iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
 				std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
 			consume_work();
@@ -255,12 +257,12 @@ void minethd::work_main()
 		if(oWork.bNiceHash)
 			iNonce = *(uint32_t*)(oWork.bWorkBlob + 39);
 
-		while(globalStates::inst().iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
+		while(globalStates::inst().get_slot(iWorkSlot).iGlobalJobNo.load(std::memory_order_relaxed) == iJobNo)
 		{
 			//Allocate a new nonce every 16 rounds
 			if((round_ctr++ & 0xF) == 0)
 			{
-				globalStates::inst().calc_start_nonce(iNonce, oWork.bNiceHash, h_per_round * 16);
+				globalStates::inst().calc_start_nonce(iNonce, oWork.bNiceHash, h_per_round * 16, iWorkSlot);
 			}
 			
 			uint32_t foundNonce[10];
@@ -272,23 +274,9 @@ void minethd::work_main()
 
 			cryptonight_extra_cpu_final(&ctx, iNonce, oWork.iTarget, &foundCount, foundNonce);
 
+			// The CPU check runs in the verifier, the next kernel starts right away
 			for(size_t i = 0; i < foundCount; i++)
-			{
-
-				uint8_t	bWorkBlob[112];
-				uint8_t	bResult[32];
-
-				memcpy(bWorkBlob, oWork.bWorkBlob, oWork.iWorkSize);
-				memset(bResult, 0, sizeof(job_result::bResult));
-
-				*(uint32_t*)(bWorkBlob + 39) = foundNonce[i];
-
-				hash_fun(bWorkBlob, oWork.iWorkSize, bResult, cpu_ctx);
-				if ( (*((uint64_t*)(bResult + 24))) < oWork.iTarget)
-					executor::inst()->push_event(ex_event(job_result(oWork.sJobID, foundNonce[i], bResult, iThreadNo), oWork.iPoolId));
-				else
-					executor::inst()->push_event(ex_event("NVIDIA Invalid Result", oWork.iPoolId));
-			}
+				result_verifier::inst()->push_result(this, oWork, foundNonce[i]);
 
 			iCount += h_per_round;
 			iNonce += h_per_round;
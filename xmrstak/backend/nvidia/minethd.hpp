@@ -29,9 +29,7 @@ public:
 	static bool self_test();
 
 private:
-	typedef void (*cn_hash_fun)(const void*, size_t, void*, cryptonight_ctx*);
-
-	minethd(miner_work& pWork, size_t iNo, const jconf::thd_cfg& cfg);
+	minethd(miner_work& pWork, size_t iNo, const jconf::thd_cfg& cfg, size_t iSlot);
 
 	void work_main();
 	void consume_work();
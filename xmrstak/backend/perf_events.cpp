@@ -0,0 +1,197 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "perf_events.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <chrono>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+namespace xmrstak
+{
+
+const char* perf_events::get_name(size_t c)
+{
+	static const char* names[COUNTER_COUNT] = {
+		"cycles",
+		"instructions",
+		"llc_misses",
+		"dtlb_misses",
+		"stalled_cycles"
+	};
+
+	return c < COUNTER_COUNT ? names[c] : "unknown";
+}
+
+perf_events::perf_events()
+{
+	for(int& fd : iFds)
+		fd = -1;
+	pSamples = new sample_set[iBucketSize];
+	memset(pSamples, 0, sizeof(sample_set) * iBucketSize);
+}
+
+perf_events::~perf_events()
+{
+#if defined(__linux__)
+	for(int fd : iFds)
+	{
+		if(fd >= 0)
+			close(fd);
+	}
+#endif
+	delete[] pSamples;
+}
+
+#if defined(__linux__)
+static int open_counter(uint32_t type, uint64_t config)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	// User space only, that is all the hashing and it works with perf_event_paranoid 2
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	// pid 0 and cpu -1 count the calling thread on every cpu
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+static constexpr uint64_t cache_miss(uint64_t cache)
+{
+	return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+#endif
+
+bool perf_events::open(std::string& err)
+{
+#if defined(__linux__)
+	iFds[CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	int iErrno = errno;
+	iFds[INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	iFds[LLC_MISSES] = open_counter(PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL));
+	iFds[DTLB_MISSES] = open_counter(PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_DTLB));
+	iFds[STALLED_CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND);
+
+	for(int fd : iFds)
+	{
+		if(fd >= 0)
+			return true;
+	}
+
+	if(iErrno == EACCES || iErrno == EPERM)
+		err = "no permission, lower /proc/sys/kernel/perf_event_paranoid to 2";
+	else if(iErrno == ENOENT || iErrno == EOPNOTSUPP)
+		err = "the CPU or the virtual machine has no hardware counters";
+	else
+		err = strerror(iErrno);
+	return false;
+#else
+	err = "only supported on Linux";
+	return false;
+#endif
+}
+
+void perf_events::sample(uint64_t iHashCount)
+{
+	using namespace std::chrono;
+	sample_set& s = pSamples[iBucketTop];
+
+	s.iTimestamp = time_point_cast<milliseconds>(steady_clock::now()).time_since_epoch().count();
+	s.iHashCount = iHashCount;
+	s.iCyclesRaw = 0;
+	s.iCyclesNs = 0;
+
+	for(size_t i = 0; i < COUNTER_COUNT; i++)
+	{
+		s.iValues[i] = 0;
+#if defined(__linux__)
+		// value, time enabled, time running
+		uint64_t buf[3];
+		if(iFds[i] < 0 || read(iFds[i], buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0)
+			continue;
+
+		s.iValues[i] = buf[2] < buf[1] ? uint64_t(double(buf[0]) * buf[1] / buf[2]) : buf[0];
+		if(i == CYCLES)
+		{
+			s.iCyclesRaw = buf[0];
+			s.iCyclesNs = buf[2];
+		}
+#endif
+	}
+
+	iBucketTop = (iBucketTop + 1) & iBucketMask;
+}
+
+void perf_events::calc_per_hash(size_t iLastMilisec, double (&fPerHash)[COUNTER_COUNT], double& fGhz)
+{
+	for(double& f : fPerHash)
+		f = nan("");
+	fGhz = nan("");
+
+	//Start at 1, buckettop points to next empty
+	const sample_set* pLatest = nullptr;
+	const sample_set* pEarliest = nullptr;
+	bool bHaveFullSet = false;
+	for (size_t i = 1; i < iBucketSize; i++)
+	{
+		const sample_set& s = pSamples[(iBucketTop - i) & iBucketMask];
+		if(s.iTimestamp == 0)
+			break; //That means we don't have the data yet
+
+		if(pLatest == nullptr)
+			pLatest = &s;
+
+		if(pLatest->iTimestamp - s.iTimestamp > iLastMilisec)
+		{
+			bHaveFullSet = true;
+			break; //We are out of the requested time period
+		}
+		pEarliest = &s;
+	}
+
+	if(!bHaveFullSet || pEarliest == nullptr || pLatest->iHashCount <= pEarliest->iHashCount)
+		return;
+
+	double fHashes = double(pLatest->iHashCount - pEarliest->iHashCount);
+	for(size_t i = 0; i < COUNTER_COUNT; i++)
+	{
+		if(iFds[i] >= 0)
+			fPerHash[i] = double(pLatest->iValues[i] - pEarliest->iValues[i]) / fHashes;
+	}
+
+	if(iFds[CYCLES] >= 0 && pLatest->iCyclesNs > pEarliest->iCyclesNs)
+		fGhz = double(pLatest->iCyclesRaw - pEarliest->iCyclesRaw) / double(pLatest->iCyclesNs - pEarliest->iCyclesNs);
+}
+
+} // namepsace xmrstak
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+namespace xmrstak
+{
+
+/* Hardware performance counters of one mining thread (Linux perf_event_open).
+ *
+ * The thread opens the counters for itself, after that only the executor thread touches
+ * the object: it samples on every EV_PERF_TICK and turns the samples into counts per hash.
+ * Counters the kernel or the CPU doesn't have stay closed and read as NaN, e.g. stalled
+ * cycles are missing on most Intel CPUs and everything is missing in most containers.
+ */
+class perf_events
+{
+public:
+	enum counter { CYCLES, INSTRUCTIONS, LLC_MISSES, DTLB_MISSES, STALLED_CYCLES, COUNTER_COUNT };
+
+	static const char* get_name(size_t c);
+
+	perf_events();
+	~perf_events();
+
+	// Calling thread only, false (and the reason in err) if not a single counter could be opened
+	bool open(std::string& err);
+
+	// Executor thread, iHashCount is the hash count of the thread at the time of the call
+	void sample(uint64_t iHashCount);
+
+	// Counter increase per hash and the average clock while the thread ran in GHz,
+	// over the last iLastMilisec. NaN for closed counters or if we don't have the data yet
+	void calc_per_hash(size_t iLastMilisec, double (&fPerHash)[COUNTER_COUNT], double& fGhz);
+
+private:
+	constexpr static size_t iBucketSize = 2 << 8; //Power of 2 to simplify calculations
+	constexpr static size_t iBucketMask = iBucketSize - 1;
+
+	struct sample_set
+	{
+		uint64_t iTimestamp;
+		uint64_t iHashCount;
+		// Scaled up if the kernel had to multiplex the counters
+		uint64_t iValues[COUNTER_COUNT];
+		// Unscaled cycles and the time the cycle counter ran, for the clock
+		uint64_t iCyclesRaw;
+		uint64_t iCyclesNs;
+	};
+
+	int iFds[COUNTER_COUNT];
+	sample_set* pSamples;
+	size_t iBucketTop = 0;
+};
+
+} // namepsace xmrstak
@@ -0,0 +1,126 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "result_verifier.hpp"
+#include "cpu/minethd.hpp"
+#include "xmrstak/jconf.hpp"
+#include "xmrstak/misc/console.hpp"
+#include "xmrstak/misc/executor.hpp"
+
+#include <string.h>
+#include <thread>
+
+namespace xmrstak
+{
+
+static const char* invalid_result_msg(iBackend::BackendType type)
+{
+	switch(type)
+	{
+	case iBackend::AMD:
+		return "AMD Invalid Result";
+	case iBackend::NVIDIA:
+		return "NVIDIA Invalid Result";
+	default:
+		return "GPU Invalid Result";
+	}
+}
+
+void result_verifier::push_result(iBackend* backend, const miner_work& oWork, uint32_t iNonce)
+{
+	std::unique_lock<std::mutex> lck(mtx);
+
+	// The contexts are only allocated once a GPU finds something
+	if(!bStarted)
+	{
+		bStarted = true;
+		for(size_t i = 0; i < iWorkerCount; i++)
+			std::thread(&result_verifier::worker_main, this).detach();
+	}
+
+	if(dQueue.size() >= iQueueMax)
+	{
+		lck.unlock();
+		backend->iInvalidCount.fetch_add(1, std::memory_order_relaxed);
+		executor::inst()->push_event(ex_event("GPU result queue full", oWork.iPoolId));
+		return;
+	}
+
+	dQueue.emplace_back();
+	gpu_result& res = dQueue.back();
+	res.backend = backend;
+	memcpy(res.sJobID, oWork.sJobID, sizeof(gpu_result::sJobID));
+	memcpy(res.bWorkBlob, oWork.bWorkBlob, oWork.iWorkSize);
+	res.iWorkSize = oWork.iWorkSize;
+	res.iTarget = oWork.iTarget;
+	res.iPoolId = oWork.iPoolId;
+	res.iNonce = iNonce;
+	res.iFoundStamp = get_timestamp_us();
+	trace_instant("gpu_result", "share", iNonce);
+	lck.unlock();
+
+	cond.notify_one();
+}
+
+void result_verifier::worker_main()
+{
+	cryptonight_ctx* cpu_ctx = cpu::minethd::minethd_alloc_ctx();
+	if(cpu_ctx == nullptr)
+	{
+		printer::inst()->print_msg(L0, "ERROR: GPU result verification has no memory, results are lost.");
+		return;
+	}
+
+	cpu::minethd::cn_hash_fun hash_fun = cpu::minethd::func_selector(::jconf::inst()->HaveHardwareAes(),
+		true /*bNoPrefetch*/, ::jconf::inst()->IsCurrencyMonero());
+
+	while(true)
+	{
+		gpu_result res;
+		{
+			std::unique_lock<std::mutex> lck(mtx);
+			cond.wait(lck, [this]{ return !dQueue.empty(); });
+			res = dQueue.front();
+			dQueue.pop_front();
+		}
+
+		uint8_t bResult[32];
+		*(uint32_t*)(res.bWorkBlob + 39) = res.iNonce;
+		hash_fun(res.bWorkBlob, res.iWorkSize, bResult, cpu_ctx);
+
+		if(*((uint64_t*)(bResult + 24)) < res.iTarget)
+		{
+			// The share lag starts when the GPU found it, the CPU check is part of it
+			job_result oResult(res.sJobID, res.iNonce, bResult, res.backend->iThreadNo);
+			oResult.iFoundStamp = res.iFoundStamp;
+			executor::inst()->push_event(ex_event(oResult, res.iPoolId));
+		}
+		else
+		{
+			res.backend->iInvalidCount.fetch_add(1, std::memory_order_relaxed);
+			executor::inst()->push_event(ex_event(invalid_result_msg(res.backend->backendType), res.iPoolId));
+		}
+	}
+}
+
+} // namepsace xmrstak
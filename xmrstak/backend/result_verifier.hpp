@@ -0,0 +1,62 @@
+#pragma once
+
+#include "iBackend.hpp"
+#include "miner_work.hpp"
+#include "xmrstak/misc/environment.hpp"
+
+#include <stdint.h>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace xmrstak
+{
+
+/* Checks the nonces a GPU found with a CPU hash before they go to the executor.
+ *
+ * A CPU hash takes a good part of a millisecond and needs a 2 MiB scratchpad, doing it in the
+ * GPU host thread keeps the GPU idle until the next kernel is started. The GPU threads only
+ * queue their results here, a few workers with their own contexts do the hashing, send the good
+ * results on and count the bad ones per GPU thread. The instance is shared with the backend
+ * plugins through the environment.
+ */
+class result_verifier
+{
+public:
+	static inline result_verifier* inst()
+	{
+		auto& env = environment::inst();
+		if(env.pResultVerifier == nullptr)
+			env.pResultVerifier = new result_verifier;
+		return env.pResultVerifier;
+	}
+
+	// GPU host threads, returns without hashing
+	void push_result(iBackend* backend, const miner_work& oWork, uint32_t iNonce);
+
+private:
+	// GPUs find a few results per second, two workers keep up with bursts from a bad kernel too
+	static constexpr size_t iWorkerCount = 2;
+	static constexpr size_t iQueueMax = 1024;
+
+	struct gpu_result
+	{
+		iBackend* backend;
+		char sJobID[64];
+		uint8_t bWorkBlob[112];
+		uint32_t iWorkSize;
+		uint64_t iTarget;
+		size_t iPoolId;
+		uint32_t iNonce;
+		uint64_t iFoundStamp;
+	};
+
+	void worker_main();
+
+	std::mutex mtx;
+	std::condition_variable cond;
+	std::deque<gpu_result> dQueue;
+	bool bStarted = false;
+};
+
+} // namepsace xmrstak
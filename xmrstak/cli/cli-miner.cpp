@@ -32,6 +32,9 @@
 #include "xmrstak/misc/configEditor.hpp"
 #include "xmrstak/version.hpp"
 #include "xmrstak/misc/utility.hpp"
+#include "xmrstak/misc/energy_meter.hpp"
+#include "xmrstak/misc/tracer.hpp"
+#include "xmrstak/hash/hash_file.hpp"
 
 #ifndef CONF_NO_HTTPD
 #	include "xmrstak/http/httpd.hpp"
@@ -66,6 +69,7 @@ void help()
 	cout<<"  -v, --version         show version number"<<endl;
 	cout<<"  -V, --version-long    show long version number"<<endl;
 	cout<<"  -c, --config FILE     common miner configuration file"<<endl;
+	cout<<"  --trace FILE          record a timeline of the miner, key 't' writes it to FILE"<<endl;
 #ifdef _WIN32
 	cout<<"  --noUAC               disable the UAC dialog"<<endl;
 #endif
@@ -75,10 +79,14 @@ void help()
 #ifndef CONF_NO_CPU
 	cout<<"  --noCPU               disable the CPU miner backend"<<endl;
 	cout<<"  --cpu FILE            CPU backend miner config file"<<endl;
+	cout<<"  --profile-cpu         count the CPU cycles per hash phase, shown in the reports"<<endl;
+	cout<<"  --perf-events         read the hardware counters of the CPU threads (Linux only)"<<endl;
+	cout<<"  --benchmark           hash for 60 seconds without a pool, print the hashrate and power"<<endl;
 #endif
 #ifndef CONF_NO_OPENCL
 	cout<<"  --noAMD               disable the AMD miner backend"<<endl;
 	cout<<"  --amd FILE            AMD backend miner config file"<<endl;
+	cout<<"  --noAMDCache          compile the AMD kernels without the binary cache"<<endl;
 #endif
 #ifndef CONF_NO_CUDA
 	cout<<"  --noNVIDIA            disable the NVIDIA miner backend"<<endl;
@@ -92,6 +100,12 @@ void help()
 	cout<<"  -u, --user USERNAME   pool user name or wallet address"<<endl;
 	cout<<"  -p, --pass PASSWD     pool password, in the most cases x or empty \"\""<<endl;
 	cout<<"  --use-nicehash        the pool should run in nicehash mode"<<endl;
+	cout<<" "<<endl;
+	cout<<"The following options hash blobs offline, without config files and pools:"<<endl;
+	cout<<"  --hash-file FILE      hash the lines '<blob hex> [<nonce hex>]' of FILE, - is stdin"<<endl;
+	cout<<"                        and write one hash per line to stdout"<<endl;
+	cout<<"  --hash-threads N      number of hash threads, default all hardware threads"<<endl;
+	cout<<"  --hash-multiway N     blobs per hash call from 1 to 5, default 1"<<endl;
 	cout<<" \n"<<endl;
 #ifdef _WIN32
 	cout<<"Environment variables:\n"<<endl;
@@ -345,6 +359,11 @@ void UACDialog(const std::string& binaryName, std::string& args)
 
 int main(int argc, char *argv[])
 {
+	{
+		using namespace std::chrono;
+		xmrstak::params::inst().iStartTime = time_point_cast<milliseconds>(high_resolution_clock::now()).time_since_epoch().count();
+	}
+
 #ifndef CONF_NO_TLS
 	SSL_library_init();
 	SSL_load_error_strings();
@@ -409,10 +428,26 @@ int main(int argc, char *argv[])
 		{
 			params::inst().useCPU = false;
 		}
+		else if(opName.compare("--profile-cpu") == 0)
+		{
+			params::inst().profileCPU = true;
+		}
+		else if(opName.compare("--benchmark") == 0)
+		{
+			params::inst().benchmark = true;
+		}
+		else if(opName.compare("--perf-events") == 0)
+		{
+			params::inst().perfEvents = true;
+		}
 		else if(opName.compare("--noAMD") == 0)
 		{
 			params::inst().useAMD = false;
 		}
+		else if(opName.compare("--noAMDCache") == 0)
+		{
+			params::inst().AMDCache = false;
+		}
 		else if(opName.compare("--noNVIDIA") == 0)
 		{
 			params::inst().useNVIDIA = false;
@@ -541,6 +576,44 @@ int main(int argc, char *argv[])
 		{
 			uacDialog = false;
 		}
+		else if(opName.compare("--trace") == 0)
+		{
+			++i;
+			if( i >=argc )
+			{
+				printer::inst()->print_msg(L0, "No argument for parameter '--trace' given");
+				win_exit();
+				return 1;
+			}
+			params::inst().traceFile = argv[i];
+		}
+		else if(opName.compare("--hash-file") == 0)
+		{
+			++i;
+			if( i >=argc )
+			{
+				printer::inst()->print_msg(L0, "No argument for parameter '--hash-file' given");
+				win_exit();
+				return 1;
+			}
+			params::inst().hashFile = argv[i];
+		}
+		else if(opName.compare("--hash-threads") == 0 || opName.compare("--hash-multiway") == 0)
+		{
+			++i;
+			char* end = nullptr;
+			size_t value = i < argc ? strtoul(argv[i], &end, 10) : 0;
+			if( i >=argc || *end != '\0' )
+			{
+				printer::inst()->print_msg(L0, "No number for parameter '%s' given", opName.c_str());
+				win_exit();
+				return 1;
+			}
+			if(opName.compare("--hash-threads") == 0)
+				params::inst().hashThreads = value;
+			else
+				params::inst().hashMultiway = value;
+		}
 		else
 		{
 			printer::inst()->print_msg(L0, "Parameter unknown '%s'",argv[i]);
@@ -549,6 +622,23 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if(!params::inst().traceFile.empty())
+		xmrstak::tracer::start();
+
+	if(!params::inst().hashFile.empty())
+	{
+		// No config is read, the currency sets the kernels and the scratchpad size
+		if(params::inst().currency.empty())
+		{
+#ifndef CONF_NO_MONERO
+			params::inst().currency = "monero";
+#else
+			params::inst().currency = "aeon";
+#endif
+		}
+		return xmrstak::cpu::hash_file(params::inst().hashFile.c_str(), params::inst().hashThreads, params::inst().hashMultiway);
+	}
+
 #ifdef _WIN32
 	if(uacDialog)
 	{
@@ -573,10 +663,13 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	if (!BackendConnector::self_test())
+	BackendConnector::start_self_test();
+
+	if(params::inst().benchmark)
 	{
+		do_benchmark();
 		win_exit();
-		return 1;
+		return 0;
 	}
 
 #ifndef CONF_NO_HTTPD
@@ -608,6 +701,8 @@ int main(int argc, char *argv[])
 	printer::inst()->print_str("'h' - hashrate\n");
 	printer::inst()->print_str("'r' - results\n");
 	printer::inst()->print_str("'c' - connection\n");
+	if(xmrstak::tracer::inst() != nullptr)
+		printer::inst()->print_str("'t' - write the trace\n");
 	printer::inst()->print_str("-------------------------------------------------------------------\n");
 	if(::jconf::inst()->IsCurrencyMonero())
 		printer::inst()->print_msg(L0,"Start mining: MONERO");
@@ -615,7 +710,10 @@ int main(int argc, char *argv[])
 		printer::inst()->print_msg(L0,"Start mining: AEON");
 
 	if(strlen(jconf::inst()->GetOutputFile()) != 0)
-		printer::inst()->open_logfile(jconf::inst()->GetOutputFile());
+		printer::inst()->open_logfile(jconf::inst()->GetOutputFile(), jconf::inst()->GetOutputFileMaxSize() * 1024 * 1024);
+
+	// From here on the mining threads print, they shouldn't wait on the console
+	printer::inst()->start_async();
 
 	executor::inst()->ex_start(jconf::inst()->DaemonMode());
 
@@ -638,6 +736,14 @@ int main(int argc, char *argv[])
 		case 'c':
 			executor::inst()->push_event(ex_event(EV_USR_CONNSTAT));
 			break;
+		case 't':
+			if(xmrstak::tracer::inst() == nullptr)
+				break;
+			if(xmrstak::tracer::inst()->dump_file(params::inst().traceFile.c_str()))
+				printer::inst()->print_msg(L0, "Trace written to %s.", params::inst().traceFile.c_str());
+			else
+				printer::inst()->print_msg(L0, "ERROR: Can't write the trace to %s.", params::inst().traceFile.c_str());
+			break;
 		default:
 			break;
 		}
@@ -666,8 +772,14 @@ void do_benchmark()
 
 	uint64_t iStartStamp = time_point_cast<milliseconds>(high_resolution_clock::now()).time_since_epoch().count();
 
+	// Sampled at the start and the end only, the counters wrap after several minutes at full load
+	xmrstak::energy_meter energy;
+	energy.sample();
+
 	std::this_thread::sleep_for(std::chrono::seconds(60));
 
+	energy.sample();
+
 	oWork = xmrstak::miner_work();
 	xmrstak::pool_data dat;
 	xmrstak::globalStates::inst().switch_work(oWork, dat);
@@ -683,4 +795,27 @@ void do_benchmark()
 	}
 
 	printer::inst()->print_msg(L0, "Total: %.1f H/S", fTotalHps);
+
+	if(energy.get_package_count() == 0)
+	{
+		if(energy.get_unreadable_count() != 0)
+			printer::inst()->print_msg(L0, "The RAPL counters need root to read, no power figures.");
+		return;
+	}
+
+	// The efficiency to compare configs by when power is what you pay for
+	double fJoules = 0.0;
+	for(size_t i = 0; i < energy.get_package_count(); i++)
+	{
+		printer::inst()->print_msg(L0, "Package %d: %.1f W", energy.get_package_id(i), energy.get_joules(i) / 60.0);
+		fJoules += energy.get_joules(i);
+	}
+
+	double fCpuHps = 0.0;
+	for (uint32_t i = 0; i < pvThreads->size(); i++)
+	{
+		if(pvThreads->at(i)->backendType == xmrstak::iBackend::CPU)
+			fCpuHps += pvThreads->at(i)->iHashCount / ((pvThreads->at(i)->iTimestamp - iStartStamp) / 1000.0);
+	}
+	printer::inst()->print_msg(L0, "CPU: %.1f W, %.2f H/J", fJoules / 60.0, fCpuHps * 60.0 / fJoules);
 }
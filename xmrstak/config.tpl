@@ -39,6 +39,47 @@ POOLCONF],
 "retry_time" : 30,
 "giveup_limit" : 0,
 
+/*
+ * pool_hot_standby - Keep the next best pool from pool_list logged in while mining. Its jobs are kept up to date, so if
+ *                    the main pool drops we switch to it right away instead of waiting for a new connection.
+ *                    This costs one extra connection to the pool.
+ */
+"pool_hot_standby" : false,
+
+/*
+ * pool_scoring - Instead of only using pool_weight, rate the pools by what they actually give us: accepted shares,
+ *                submit round trip time, job arrival regularity and recent disconnects. The pool_weight values are used
+ *                as a starting point until enough shares are in. We only switch to a pool that scores at least 5% better,
+ *                and not more often than every 5 minutes.
+ */
+"pool_scoring" : false,
+
+/*
+ * split_mining - Mine on several pools at once. Each group gets a share of the CPU threads and a share of the GPU
+ *                threads, and mines its own pool - the first group mines the best pool, the second group the next
+ *                best one and so on. A group that has no pool of its own mines with the first group.
+ *                Up to 4 groups, an empty list means all threads mine one pool.
+ *
+ * Example - 70% of all threads on the best pool and 30% on the second best:
+ *    "split_mining" : [ { "cpu_share" : 70, "gpu_share" : 70 }, { "cpu_share" : 30, "gpu_share" : 30 } ],
+ * Example - CPU threads on the best pool, GPU threads on the second best:
+ *    "split_mining" : [ { "cpu_share" : 100, "gpu_share" : 0 }, { "cpu_share" : 0, "gpu_share" : 100 } ],
+ */
+"split_mining" : [ ],
+
+/*
+ * Solo mining
+ *
+ * Mine blocks for yourself, straight from a monero daemon. The miner asks the daemon's RPC port for a block template
+ * every second and sends back any block it finds. The pools in pool_list are only used while the daemon can't be
+ * reached. A solo miner only gets paid when it finds a whole block, so this only makes sense for a large hashrate.
+ *
+ * daemon_address - RPC address of your daemon, for example "127.0.0.1:18081". Empty string switches solo mining off.
+ * daemon_wallet  - Wallet address the block reward is paid to.
+ */
+"daemon_address" : "",
+"daemon_wallet" : "",
+
 /*
  * Output control.
  * Since most people are used to miners printing all the time, that's what we do by default too. This is suboptimal
@@ -147,9 +188,24 @@ POOLCONF],
  * Output file
  *
  * output_file  - This option will log all output to a file.
+ * output_file_max_size - Size in MiB at which the log file is renamed to <output_file>.1 and a new one is
+ *                        started, the previous .1 file is deleted. 0 means the file is never rotated.
  *
  */
 "output_file" : "",
+"output_file_max_size" : 0,
+
+/*
+ * Journal
+ *
+ * journal_file - Binary file that keeps the shares, jobs, pool switches and the hashrate of every thread
+ *                (once a minute) across crashes and restarts. Convert it to CSV with the xmr-stak-journal tool.
+ *                An existing file that is not a journal is never overwritten. Empty to disable.
+ * journal_size - Size of the file in MiB, once it is full the oldest records are overwritten. A record takes
+ *                64 bytes.
+ */
+"journal_file" : "",
+"journal_size" : 16,
 
 /*
  * Built-in web server
@@ -173,12 +229,39 @@ POOLCONF],
  */ 
 "http_login" : "",
 "http_pass" : "",
- 
+
+/*
+ * Stratum proxy
+ *
+ * Other rigs can log in to this miner as if it was a pool. Their shares are submitted through our
+ * own pool connection, so a site with many rigs only needs one upstream connection and login.
+ * Each rig gets its own value of the top nonce byte, so set "use_nicehash" : true in the pool
+ * entry that points to the proxy. Up to 255 rigs can connect. A NiceHash upstream pool already
+ * uses the top nonce byte and can't be used in this mode.
+ *
+ * Anyone who can reach the port mines for your wallet and can make the pool reject shares, so the
+ * proxy only listens on the loopback interface by default. Set proxy_bind to the address of the
+ * network card the rigs are on (or 0.0.0.0 for all of them) and set a password for a shared network.
+ *
+ * proxy_port - Port we should listen on for the rigs. Default, 0, will switch off the proxy.
+ * proxy_bind - IPv4 or IPv6 address to listen on.
+ * proxy_pass - Password the rigs have to send as their pool password. Empty means no check.
+ */
+"proxy_port" : 0,
+"proxy_bind" : "127.0.0.1",
+"proxy_pass" : "",
+
 /*
  * prefer_ipv4 - IPv6 preference. If the host is available on both IPv4 and IPv6 net, which one should be choose?
  *               This setting will only be needed in 2020's. No need to worry about it now.
  */
 "prefer_ipv4" : true,
 
+/*
+ * dns_cache_time - Pool host names are looked up in the background and the result is kept for this many seconds.
+ *                  A stale address is still used while the refresh is running.
+ */
+"dns_cache_time" : 300,
+
 )==="
 		
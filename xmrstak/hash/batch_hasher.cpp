@@ -0,0 +1,195 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "batch_hasher.hpp"
+#include "xmrstak/jconf.hpp"
+
+#include <string.h>
+
+namespace xmrstak
+{
+namespace cpu
+{
+
+batch_hasher::batch_hasher(size_t iThreads, size_t iMultiway, bool bNoPrefetch) : iNextItem(0)
+{
+	constexpr int AESNI_BIT = 1 << 25;
+	int32_t cpu_info[4];
+	::jconf::cpuid(1, 0, cpu_info);
+	bool bHaveAes = (cpu_info[2] & AESNI_BIT) != 0;
+	bool bMonero = ::jconf::inst()->IsCurrencyMonero();
+
+	if(iMultiway < 1)
+		iMultiway = 1;
+	if(iMultiway > iMaxMultiway)
+		iMultiway = iMaxMultiway;
+	this->iMultiway = iMultiway;
+
+	if(iThreads == 0)
+		iThreads = std::thread::hardware_concurrency();
+	if(iThreads == 0)
+		iThreads = 1;
+
+	hash_fun = minethd::func_selector(bHaveAes, bNoPrefetch, bMonero);
+	for(size_t n = 2; n <= iMultiway; n++)
+		hash_fun_multi[n] = minethd::func_multi_selector(n, bHaveAes, bNoPrefetch, bMonero);
+
+	vWorkers.resize(iThreads);
+	for(worker*& w : vWorkers)
+	{
+		w = new worker;
+		memset(w->ctx, 0, sizeof(w->ctx));
+		for(size_t n = 0; n < iMultiway; n++)
+		{
+			w->ctx[n] = alloc_ctx();
+			if(w->ctx[n] == nullptr)
+				bReady = false;
+		}
+	}
+
+	// Without all contexts the workers are never started and hash() is a no-op
+	if(!bReady)
+		return;
+
+	for(worker* w : vWorkers)
+		w->oThd = std::thread(&batch_hasher::worker_main, this, w);
+}
+
+batch_hasher::~batch_hasher()
+{
+	{
+		std::unique_lock<std::mutex> lck(work_mutex);
+		bQuit = true;
+	}
+	work_cond.notify_all();
+
+	for(worker* w : vWorkers)
+	{
+		if(w->oThd.joinable())
+			w->oThd.join();
+
+		for(size_t n = 0; n < iMultiway; n++)
+		{
+			if(w->ctx[n] != nullptr)
+				cryptonight_free_ctx(w->ctx[n]);
+		}
+		delete w;
+	}
+}
+
+cryptonight_ctx* batch_hasher::alloc_ctx()
+{
+	alloc_msg msg = { 0 };
+	cryptonight_ctx* ctx = cryptonight_alloc_ctx(1, 0, &msg);
+	if(ctx != nullptr)
+		return ctx;
+
+	iSlowCtx++;
+	return cryptonight_alloc_ctx(0, 0, NULL);
+}
+
+void batch_hasher::hash(const hash_item* pItems, size_t iCount, uint8_t* pOut)
+{
+	if(!bReady || iCount == 0)
+		return;
+
+	std::unique_lock<std::mutex> call_lck(call_mutex);
+	std::unique_lock<std::mutex> lck(work_mutex);
+
+	this->pItems = pItems;
+	this->iCount = iCount;
+	this->pOut = pOut;
+	iNextItem = 0;
+	iBusy = vWorkers.size();
+	iBatch++;
+	work_cond.notify_all();
+
+	done_cond.wait(lck, [this]{ return iBusy == 0; });
+}
+
+void batch_hasher::worker_main(worker* w)
+{
+	uint64_t iSeenBatch = 0;
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lck(work_mutex);
+			work_cond.wait(lck, [&]{ return bQuit || iBatch != iSeenBatch; });
+			if(bQuit)
+				return;
+			iSeenBatch = iBatch;
+		}
+
+		hash_items(w);
+
+		std::unique_lock<std::mutex> lck(work_mutex);
+		if(--iBusy == 0)
+			done_cond.notify_one();
+	}
+}
+
+void batch_hasher::hash_items(worker* w)
+{
+	constexpr size_t iBlobMax = sizeof(hash_item::bWorkBlob);
+
+	while(true)
+	{
+		// Workers take iMultiway neighbouring items at a time, shares from one job sit together
+		size_t iFirst = iNextItem.fetch_add(iMultiway);
+		if(iFirst >= iCount)
+			return;
+
+		size_t iRun = iCount - iFirst < iMultiway ? iCount - iFirst : iMultiway;
+		const hash_item* items = pItems + iFirst;
+		uint8_t* out = pOut + iFirst * 32;
+
+		uint32_t iLen = items[0].iWorkSize > iBlobMax ? iBlobMax : items[0].iWorkSize;
+		bool bSameLen = true;
+		for(size_t n = 1; n < iRun; n++)
+			bSameLen &= items[n].iWorkSize == items[0].iWorkSize;
+
+		for(size_t n = 0; n < iRun; n++)
+		{
+			uint8_t* blob = w->bInput + (bSameLen ? n * iLen : n * iBlobMax);
+			uint32_t iItemLen = items[n].iWorkSize > iBlobMax ? iBlobMax : items[n].iWorkSize;
+			memcpy(blob, items[n].bWorkBlob, iItemLen);
+			if(iItemLen >= iNonceOffset + sizeof(uint32_t))
+				memcpy(blob + iNonceOffset, &items[n].iNonce, sizeof(uint32_t));
+		}
+
+		if(iRun > 1 && bSameLen)
+		{
+			hash_fun_multi[iRun](w->bInput, iLen, out, w->ctx);
+			continue;
+		}
+
+		for(size_t n = 0; n < iRun; n++)
+		{
+			uint32_t iItemLen = items[n].iWorkSize > iBlobMax ? iBlobMax : items[n].iWorkSize;
+			hash_fun(w->bInput + (bSameLen ? n * iLen : n * iBlobMax), iItemLen, out + n * 32, w->ctx[0]);
+		}
+	}
+}
+
+} // namespace cpu
+} // namepsace xmrstak
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "xmrstak/backend/cpu/minethd.hpp"
+
+#include <stdint.h>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+namespace xmrstak
+{
+namespace cpu
+{
+
+/* Hashes many blobs on a pool of worker threads, without pools, configs or miner threads.
+ *
+ * Every worker owns iMultiway contexts (hugepages if we can get them) and hands runs of
+ * equal length blobs to the multiway kernels, so a batch of shares from one job goes through
+ * at the same speed as mining. The currency, and with it the scratchpad size, is the one
+ * jconf reports - set params::inst().currency if no config was parsed.
+ */
+class batch_hasher
+{
+public:
+	struct hash_item
+	{
+		uint8_t bWorkBlob[112];
+		uint32_t iWorkSize;
+		// Written at the nonce offset of the blob, if it is long enough to have one
+		uint32_t iNonce;
+	};
+
+	static constexpr size_t iNonceOffset = 39;
+	// The multiway kernels exist from 2 to 5 hashes
+	static constexpr size_t iMaxMultiway = 5;
+
+	// iThreads 0 uses every hardware thread, iMultiway is clamped to 1 - iMaxMultiway
+	batch_hasher(size_t iThreads, size_t iMultiway, bool bNoPrefetch);
+	~batch_hasher();
+
+	// Blocks until the batch is done, pOut gets 32 bytes per item in item order. One caller at a time.
+	void hash(const hash_item* pItems, size_t iCount, uint8_t* pOut);
+
+	inline bool is_ready() { return bReady; }
+	inline size_t get_threads() { return vWorkers.size(); }
+	inline size_t get_multiway() { return iMultiway; }
+	// Contexts that didn't get hugepages
+	inline size_t get_slow_ctx_count() { return iSlowCtx; }
+
+private:
+	struct worker
+	{
+		std::thread oThd;
+		cryptonight_ctx* ctx[iMaxMultiway];
+		uint8_t bInput[iMaxMultiway * sizeof(hash_item::bWorkBlob)];
+	};
+
+	void worker_main(worker* w);
+	void hash_items(worker* w);
+	cryptonight_ctx* alloc_ctx();
+
+	size_t iMultiway;
+	bool bReady = true;
+	size_t iSlowCtx = 0;
+
+	minethd::cn_hash_fun hash_fun;
+	// Indexed by the number of blobs, 2 to iMultiway
+	minethd::cn_hash_fun_multi hash_fun_multi[iMaxMultiway + 1] = { nullptr };
+
+	std::vector<worker*> vWorkers;
+
+	std::mutex call_mutex;
+	std::mutex work_mutex;
+	std::condition_variable work_cond;
+	std::condition_variable done_cond;
+	uint64_t iBatch = 0;
+	size_t iBusy = 0;
+	bool bQuit = false;
+
+	const hash_item* pItems = nullptr;
+	size_t iCount = 0;
+	uint8_t* pOut = nullptr;
+	std::atomic<size_t> iNextItem;
+};
+
+} // namespace cpu
+} // namepsace xmrstak
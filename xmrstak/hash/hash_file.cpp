@@ -0,0 +1,155 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "hash_file.hpp"
+#include "batch_hasher.hpp"
+#include "xmrstak/net/jpsock.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace xmrstak
+{
+namespace cpu
+{
+
+// Lines hashed per batch, enough to keep all workers busy between the reads
+constexpr size_t iBatchSize = 4096;
+
+static bool parse_line(const std::string& line, batch_hasher::hash_item& item)
+{
+	size_t iBlobEnd = line.find_first_of(" \t\r");
+	std::string sBlob = line.substr(0, iBlobEnd);
+
+	if(sBlob.length() % 2 != 0 || sBlob.length() > 2 * sizeof(item.bWorkBlob))
+		return false;
+
+	item.iWorkSize = sBlob.length() / 2;
+	if(!jpsock::hex2bin(sBlob.c_str(), sBlob.length(), item.bWorkBlob))
+		return false;
+
+	// Without an explicit nonce the blob is hashed as it is
+	item.iNonce = 0;
+	if(item.iWorkSize >= batch_hasher::iNonceOffset + sizeof(uint32_t))
+		memcpy(&item.iNonce, item.bWorkBlob + batch_hasher::iNonceOffset, sizeof(uint32_t));
+
+	size_t iNonceStart = line.find_first_not_of(" \t\r", iBlobEnd == std::string::npos ? line.length() : iBlobEnd);
+	if(iNonceStart == std::string::npos)
+		return true;
+
+	std::string sNonce = line.substr(iNonceStart, line.find_first_of(" \t\r", iNonceStart) - iNonceStart);
+	if(sNonce.length() != 8 || item.iWorkSize < batch_hasher::iNonceOffset + sizeof(uint32_t))
+		return false;
+
+	return jpsock::hex2bin(sNonce.c_str(), 8, (unsigned char*)&item.iNonce);
+}
+
+int hash_file(const char* sFile, size_t iThreads, size_t iMultiway)
+{
+	std::ifstream oFile;
+	std::istream* in = &std::cin;
+	if(strcmp(sFile, "-") != 0)
+	{
+		oFile.open(sFile);
+		if(!oFile.is_open())
+		{
+			fprintf(stderr, "Unable to open '%s'.\n", sFile);
+			return 1;
+		}
+		in = &oFile;
+	}
+
+	batch_hasher oHasher(iThreads, iMultiway, false);
+	if(!oHasher.is_ready())
+	{
+		fprintf(stderr, "MEMORY ALLOC FAILED: unable to allocate the hash contexts.\n");
+		return 1;
+	}
+
+	if(oHasher.get_slow_ctx_count() != 0)
+		fprintf(stderr, "WARNING: %zu of %zu contexts are without hugepages, hashing will be slower.\n",
+			oHasher.get_slow_ctx_count(), oHasher.get_threads() * oHasher.get_multiway());
+
+	std::vector<batch_hasher::hash_item> vItems;
+	std::vector<uint8_t> vHashes(iBatchSize * 32);
+	std::string sOut;
+	std::string line;
+	size_t iLine = 0;
+	size_t iTotal = 0;
+	bool bError = false;
+
+	vItems.reserve(iBatchSize);
+	using namespace std::chrono;
+	auto tStart = steady_clock::now();
+
+	while(!bError)
+	{
+		vItems.clear();
+		while(vItems.size() < iBatchSize && std::getline(*in, line))
+		{
+			iLine++;
+			if(line.empty() || line[0] == '#' || line[0] == '\r')
+				continue;
+
+			vItems.emplace_back();
+			if(!parse_line(line, vItems.back()))
+			{
+				fprintf(stderr, "Invalid blob or nonce in line %zu.\n", iLine);
+				vItems.pop_back();
+				bError = true;
+				break;
+			}
+		}
+
+		if(vItems.empty())
+			break;
+
+		oHasher.hash(vItems.data(), vItems.size(), vHashes.data());
+		iTotal += vItems.size();
+
+		char sHash[65];
+		sHash[64] = '\n';
+		sOut.clear();
+		for(size_t i = 0; i < vItems.size(); i++)
+		{
+			jpsock::bin2hex(vHashes.data() + i * 32, 32, sHash);
+			sOut.append(sHash, 65);
+		}
+		fwrite(sOut.data(), 1, sOut.size(), stdout);
+	}
+	fflush(stdout);
+
+	double fSec = duration_cast<microseconds>(steady_clock::now() - tStart).count() / 1e6;
+	fprintf(stderr, "Hashed %zu blobs in %.2f s, %.1f H/s (%zu threads, multiway %zu).\n",
+		iTotal, fSec, fSec > 0.0 ? iTotal / fSec : 0.0, oHasher.get_threads(), oHasher.get_multiway());
+
+	return bError ? 1 : 0;
+}
+
+} // namespace cpu
+} // namepsace xmrstak
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace xmrstak
+{
+namespace cpu
+{
+
+/* Offline hashing of a share log or a benchmark set.
+ *
+ * Every line of sFile ("-" reads stdin) is "<blob hex> [<nonce hex>]", the nonce is written
+ * in stratum byte order like a share submit. Empty lines and lines starting with '#' are skipped.
+ * One hash per line goes to stdout in input order, the summary and errors go to stderr.
+ * Returns the exit code of the process.
+ */
+int hash_file(const char* sFile, size_t iThreads, size_t iMultiway);
+
+} // namespace cpu
+} // namepsace xmrstak
@@ -29,6 +29,7 @@
 #include "xmrstak/net/msgstruct.hpp"
 #include "xmrstak/misc/console.hpp"
 #include "xmrstak/misc/executor.hpp"
+#include "xmrstak/misc/tracer.hpp"
 #include "xmrstak/jconf.hpp"
 
 #include <stdlib.h>
@@ -113,6 +114,14 @@ int httpd::req_handler(void * cls,
 		rsp = MHD_create_response_from_buffer(str.size(), (void*)str.c_str(), MHD_RESPMEM_MUST_COPY);
 		MHD_add_response_header(rsp, "Content-Type", "application/json; charset=utf-8");
 	}
+	else if(strcasecmp(url, "/trace.json") == 0 && xmrstak::tracer::inst() != nullptr)
+	{
+		// The rings are read without the executor, a stalled executor is what the trace is for
+		xmrstak::tracer::inst()->dump(str);
+
+		rsp = MHD_create_response_from_buffer(str.size(), (void*)str.c_str(), MHD_RESPMEM_MUST_COPY);
+		MHD_add_response_header(rsp, "Content-Type", "application/json; charset=utf-8");
+	}
 	else if(strcasecmp(url, "/h") == 0 || strcasecmp(url, "/hashrate") == 0)
 	{
 		executor::inst()->get_http_report(EV_HTML_HASHRATE, str);
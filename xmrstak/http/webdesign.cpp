@@ -171,6 +171,7 @@ extern const char sHtmlConnectionBodyHigh [] =
 		"<tr><th>Pool address</th><td>%s</td></tr>"
 		"<tr><th>Connected since</th><td>%s</td></tr>"
 		"<tr><th>Pool ping time</th><td>%u ms</td></tr>"
+		"<tr><th>TLS handshakes</th><td>%s</td></tr>"
 	"</table>"
 	"<h4>Network error log</h4>"
 	"<table>"
@@ -212,6 +213,36 @@ extern const char sHtmlResultBodyLow[] =
 extern const char sJsonApiThdHashrate[] =
 	"[%s,%s,%s]";
 
+extern const char sJsonApiThdPhases[] =
+	"{\"thread\":%u,\"hashes\":%llu,\"cycles\":[%llu,%llu,%llu,%llu,%llu]}";
+
+extern const char sJsonApiThdPerf[] =
+	"{\"thread\":%u,\"per_hash\":[%s,%s,%s,%s,%s],\"ghz\":%s}";
+
+extern const char sJsonApiPackageEnergy[] =
+	"{\"package\":%d,\"watts\":%s,\"hpj\":%s}";
+
+// The series of numbers and "]}" are appended after these
+extern const char sJsonApiCpuClock[] =
+	"{\"cpu\":%lld,\"mhz\":[";
+
+extern const char sJsonApiThermalZone[] =
+	"{\"type\":\"%s\",\"celsius\":[";
+
+// A latency object is one of the two prefixes, sJsonApiLatency, the bucket counts and "]}"
+extern const char sJsonApiLatencyStage[] =
+	"{\"stage\":\"%s\",";
+
+extern const char sJsonApiLatencyThd[] =
+	"{\"thread\":%u,";
+
+extern const char sJsonApiLatency[] =
+	"\"count\":%llu,\"p50\":%.0f,\"p90\":%.0f,\"p99\":%.0f,\"max\":%llu,\"buckets\":[";
+
+// window is in seconds, 0 for the time since the start
+extern const char sJsonApiEffective[] =
+	"{\"window\":%llu,\"shares\":%llu,\"seconds\":%llu,\"hashrate\":%s,\"low\":%s,\"high\":%s,\"reported\":%s,\"luck\":%s,\"z\":%s}";
+
 extern const char sJsonApiResultError[] =
 	"{\"count\":%llu,\"last_seen\":%llu,\"text\":\"%s\"}";
 
@@ -228,6 +259,29 @@ extern const char sJsonApiFormat [] =
 		"\"highest\":%s"
 	"},"
 
+	"\"cpu_phases\":{"
+		"\"phases\":[\"keccak\",\"explode\",\"loop\",\"implode\",\"final\"],"
+		"\"threads\":[%s]"
+	"},"
+
+	"\"perf_events\":{"
+		"\"counters\":[\"cycles\",\"instructions\",\"llc_misses\",\"dtlb_misses\",\"stalled_cycles\"],"
+		"\"threads\":[%s]"
+	"},"
+
+	"\"energy\":{"
+		"\"watts\":%s,"
+		"\"hpj\":%s,"
+		"\"packages\":[%s]"
+	"},"
+
+	"\"thermal\":{"
+		"\"interval\":%llu,"
+		"\"throttled\":[%s],"
+		"\"cpus\":[%s],"
+		"\"zones\":[%s]"
+	"},"
+
 	"\"results\":{"
 		"\"diff_current\":%llu,"
 		"\"shares_good\":%llu,"
@@ -235,6 +289,7 @@ extern const char sJsonApiFormat [] =
 		"\"avg_time\":%.1f,"
 		"\"hashes_total\":%llu,"
 		"\"best\":[%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu],"
+		"\"effective\":[%s],"
 		"\"error_log\":[%s]"
 	"},"
 
@@ -242,7 +297,15 @@ extern const char sJsonApiFormat [] =
 		"\"pool\": \"%s\","
 		"\"uptime\":%llu,"
 		"\"ping\":%llu,"
+		"\"tls_full\":%llu,"
+		"\"tls_resumed\":%llu,"
 		"\"error_log\":[%s]"
+	"},"
+
+	"\"latency\":{"
+		"\"job\":[%s],"
+		"\"share\":[%s],"
+		"\"threads\":[%s]"
 	"}"
 "}";
 
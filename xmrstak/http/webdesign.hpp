@@ -29,6 +29,15 @@ extern const char sHtmlResultTableRow[];
 extern const char sHtmlResultBodyLow[];
 
 extern const char sJsonApiThdHashrate[];
+extern const char sJsonApiThdPhases[];
+extern const char sJsonApiThdPerf[];
+extern const char sJsonApiPackageEnergy[];
+extern const char sJsonApiCpuClock[];
+extern const char sJsonApiThermalZone[];
+extern const char sJsonApiLatencyStage[];
+extern const char sJsonApiLatencyThd[];
+extern const char sJsonApiLatency[];
+extern const char sJsonApiEffective[];
 extern const char sJsonApiResultError[];
 extern const char sJsonApiConnectionError[];
 extern const char sJsonApiFormat[];
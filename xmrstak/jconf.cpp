@@ -28,6 +28,7 @@
 #include "xmrstak/misc/jext.hpp"
 #include "xmrstak/misc/console.hpp"
 #include "xmrstak/misc/utility.hpp"
+#include "xmrstak/backend/globalStates.hpp"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -51,8 +52,8 @@ using namespace rapidjson;
  * This enum needs to match index in oConfigValues, otherwise we will get a runtime error
  */
 enum configEnum {
-	aPoolList, bTlsSecureAlgo, sCurrency, iCallTimeout, iNetRetry, iGiveUpLimit, iVerboseLevel, bPrintMotd, iAutohashTime, 
-	bFlushStdout, bDaemonMode, sOutputFile, iHttpdPort, sHttpLogin, sHttpPass, bPreferIpv4, bAesOverride, sUseSlowMem 
+	aPoolList, bTlsSecureAlgo, sCurrency, iCallTimeout, iNetRetry, iGiveUpLimit, bHotStandby, bPoolScoring, aSplitMining, sDaemonAddress, sDaemonWallet, iVerboseLevel, bPrintMotd, iAutohashTime, 
+	bFlushStdout, bDaemonMode, sOutputFile, iOutputFileMax, sJournalFile, iJournalSize, iHttpdPort, sHttpLogin, sHttpPass, iProxyPort, sProxyBind, sProxyPass, bPreferIpv4, iDnsCacheTime, bAesOverride, sUseSlowMem 
 };
 
 struct configVal {
@@ -70,16 +71,28 @@ configVal oConfigValues[] = {
 	{ iCallTimeout, "call_timeout", kNumberType },
 	{ iNetRetry, "retry_time", kNumberType },
 	{ iGiveUpLimit, "giveup_limit", kNumberType },
+	{ bHotStandby, "pool_hot_standby", kTrueType },
+	{ bPoolScoring, "pool_scoring", kTrueType },
+	{ aSplitMining, "split_mining", kArrayType },
+	{ sDaemonAddress, "daemon_address", kStringType },
+	{ sDaemonWallet, "daemon_wallet", kStringType },
 	{ iVerboseLevel, "verbose_level", kNumberType },
 	{ bPrintMotd, "print_motd", kTrueType },
 	{ iAutohashTime, "h_print_time", kNumberType },
 	{ bFlushStdout, "flush_stdout", kTrueType},
 	{ bDaemonMode, "daemon_mode", kTrueType },
 	{ sOutputFile, "output_file", kStringType },
+	{ iOutputFileMax, "output_file_max_size", kNumberType },
+	{ sJournalFile, "journal_file", kStringType },
+	{ iJournalSize, "journal_size", kNumberType },
 	{ iHttpdPort, "httpd_port", kNumberType },
 	{ sHttpLogin, "http_login", kStringType },
 	{ sHttpPass, "http_pass", kStringType },
+	{ iProxyPort, "proxy_port", kNumberType },
+	{ sProxyBind, "proxy_bind", kStringType },
+	{ sProxyPass, "proxy_pass", kStringType },
 	{ bPreferIpv4, "prefer_ipv4", kTrueType },
+	{ iDnsCacheTime, "dns_cache_time", kNumberType },
 	{ bAesOverride, "aes_override", kNullType },
 	{ sUseSlowMem, "use_slow_memory", kStringType }
 };
@@ -123,6 +136,23 @@ uint64_t jconf::GetPoolCount()
 		return 0;
 }
 
+size_t jconf::GetSplitCount()
+{
+	return prv->configValues[aSplitMining]->Size();
+}
+
+bool jconf::GetSplitConfig(size_t id, split_cfg& cfg)
+{
+	if(id >= GetSplitCount())
+		return false;
+
+	/* We already checked presence and types */
+	const Value& oSplitConf = prv->configValues[aSplitMining]->GetArray()[id];
+	cfg.cpu_share = GetObjectMember(oSplitConf, "cpu_share")->GetUint();
+	cfg.gpu_share = GetObjectMember(oSplitConf, "gpu_share")->GetUint();
+	return true;
+}
+
 bool jconf::GetPoolConfig(size_t id, pool_cfg& cfg)
 {
 	if(id >= GetPoolCount())
@@ -210,6 +240,11 @@ bool jconf::PreferIpv4()
 	return prv->configValues[bPreferIpv4]->GetBool();
 }
 
+uint64_t jconf::GetDnsCacheTime()
+{
+	return prv->configValues[iDnsCacheTime]->GetUint64();
+}
+
 uint64_t jconf::GetCallTimeout()
 {
 	return prv->configValues[iCallTimeout]->GetUint64();
@@ -225,6 +260,26 @@ uint64_t jconf::GetGiveUpLimit()
 	return prv->configValues[iGiveUpLimit]->GetUint64();
 }
 
+bool jconf::HotStandby()
+{
+	return prv->configValues[bHotStandby]->GetBool();
+}
+
+bool jconf::PoolScoring()
+{
+	return prv->configValues[bPoolScoring]->GetBool();
+}
+
+const char* jconf::GetDaemonAddress()
+{
+	return prv->configValues[sDaemonAddress]->GetString();
+}
+
+const char* jconf::GetDaemonWallet()
+{
+	return prv->configValues[sDaemonWallet]->GetString();
+}
+
 uint64_t jconf::GetVerboseLevel()
 {
 	return prv->configValues[iVerboseLevel]->GetUint64();
@@ -255,6 +310,21 @@ const char* jconf::GetHttpPassword()
 	return prv->configValues[sHttpPass]->GetString();
 }
 
+uint16_t jconf::GetProxyPort()
+{
+	return prv->configValues[iProxyPort]->GetUint();
+}
+
+const char* jconf::GetProxyBind()
+{
+	return prv->configValues[sProxyBind]->GetString();
+}
+
+const char* jconf::GetProxyPassword()
+{
+	return prv->configValues[sProxyPass]->GetString();
+}
+
 bool jconf::DaemonMode()
 {
 	return prv->configValues[bDaemonMode]->GetBool();
@@ -265,6 +335,21 @@ const char* jconf::GetOutputFile()
 	return prv->configValues[sOutputFile]->GetString();
 }
 
+uint64_t jconf::GetOutputFileMaxSize()
+{
+	return prv->configValues[iOutputFileMax]->GetUint64();
+}
+
+const char* jconf::GetJournalFile()
+{
+	return prv->configValues[sJournalFile]->GetString();
+}
+
+uint64_t jconf::GetJournalSize()
+{
+	return prv->configValues[iJournalSize]->GetUint64();
+}
+
 void jconf::cpuid(uint32_t eax, int32_t ecx, int32_t val[4])
 {
 	memset(val, 0, sizeof(int32_t)*4);
@@ -491,6 +576,69 @@ bool jconf::parse_config(const char* sFilename)
 		return false;
 	}
 
+	if(!prv->configValues[iProxyPort]->IsUint() || prv->configValues[iProxyPort]->GetUint() > 0xFFFF)
+	{
+		printer::inst()->print_msg(L0,
+			"Invalid config file. proxy_port has to be in the range 0 to 65535.");
+		return false;
+	}
+
+	size_t split_cnt = prv->configValues[aSplitMining]->Size();
+	if(split_cnt > xmrstak::globalStates::iMaxSlots)
+	{
+		printer::inst()->print_msg(L0, "Invalid config file. split_mining can have at most %u groups.", (unsigned)xmrstak::globalStates::iMaxSlots);
+		return false;
+	}
+
+	for(size_t i=0; i < split_cnt; i++)
+	{
+		const Value& oSplitConf = prv->configValues[aSplitMining]->GetArray()[i];
+		const Value *cpu, *gpu;
+		if(!oSplitConf.IsObject() || (cpu = GetObjectMember(oSplitConf, "cpu_share")) == nullptr ||
+			(gpu = GetObjectMember(oSplitConf, "gpu_share")) == nullptr || !cpu->IsUint() || !gpu->IsUint())
+		{
+			printer::inst()->print_msg(L0, "Invalid config file. split_mining group %u needs integer cpu_share and gpu_share values.", (unsigned)i);
+			return false;
+		}
+	}
+
+	if(prv->configValues[sDaemonAddress]->GetStringLength() > 0)
+	{
+		std::string sAddr = prv->configValues[sDaemonAddress]->GetString();
+		if(sAddr.find(':') == std::string::npos || sAddr.back() == ':')
+		{
+			printer::inst()->print_msg(L0, "Invalid config file. daemon_address needs to be in the form \"host:port\".");
+			return false;
+		}
+
+		if(prv->configValues[sDaemonWallet]->GetStringLength() == 0)
+		{
+			printer::inst()->print_msg(L0, "Invalid config file. Solo mining needs a daemon_wallet to pay the block reward to.");
+			return false;
+		}
+	}
+
+	if(!prv->configValues[iOutputFileMax]->IsUint64())
+	{
+		printer::inst()->print_msg(L0,
+			"Invalid config file. output_file_max_size needs to be a positive integer.");
+		return false;
+	}
+
+	if(!prv->configValues[iJournalSize]->IsUint64() || prv->configValues[iJournalSize]->GetUint64() == 0)
+	{
+		printer::inst()->print_msg(L0,
+			"Invalid config file. journal_size needs to be a positive integer.");
+		return false;
+	}
+
+	if(!prv->configValues[iDnsCacheTime]->IsUint64())
+	{
+		printer::inst()->print_msg(L0,
+			"Invalid config file. dns_cache_time needs to be a positive integer.");
+		return false;
+	}
+
 	if(prv->configValues[bAesOverride]->IsBool())
 		bHaveAes = prv->configValues[bAesOverride]->GetBool();
 
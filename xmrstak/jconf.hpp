@@ -37,6 +37,14 @@ public:
 	uint64_t GetPoolCount();
 	bool GetPoolConfig(size_t id, pool_cfg& cfg);
 
+	struct split_cfg {
+		uint32_t cpu_share;
+		uint32_t gpu_share;
+	};
+
+	size_t GetSplitCount();
+	bool GetSplitConfig(size_t id, split_cfg& cfg);
+
 	enum slow_mem_cfg {
 		always_use,
 		no_mlck,
@@ -55,18 +63,34 @@ public:
 	uint64_t GetAutohashTime();
 
 	const char* GetOutputFile();
+	// In MiB, 0 means the file is never rotated
+	uint64_t GetOutputFileMaxSize();
+
+	const char* GetJournalFile();
+	// In MiB
+	uint64_t GetJournalSize();
 
 	uint64_t GetCallTimeout();
 	uint64_t GetNetRetry();
 	uint64_t GetGiveUpLimit();
+	bool HotStandby();
+	bool PoolScoring();
+
+	const char* GetDaemonAddress();
+	const char* GetDaemonWallet();
 
 	uint16_t GetHttpdPort();
 	const char* GetHttpUsername();
 	const char* GetHttpPassword();
 
+	uint16_t GetProxyPort();
+	const char* GetProxyBind();
+	const char* GetProxyPassword();
+
 	bool DaemonMode();
 
 	bool PreferIpv4();
+	uint64_t GetDnsCacheTime();
 
 	inline bool HaveHardwareAes() { return bHaveAes; }
 
@@ -28,6 +28,9 @@
 #include <string.h>
 #include <stdarg.h>
 #include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -152,15 +155,18 @@ inline void comp_localtime(const time_t* ctime, tm* stime)
 #endif // __WIN32
 }
 
-printer::printer()
+printer::printer() : bAsync(false), iNextSeq(0), iDropped(0)
 {
 	verbose_level = LINF;
 	logfile = nullptr;
 	b_flush_stdout = false;
 }
 
-bool printer::open_logfile(const char* file)
+bool printer::open_logfile(const char* file, uint64_t iMaxSize)
 {
+	std::unique_lock<std::mutex> lck(print_mutex);
+	logfile_name = file;
+	logfile_max = iMaxSize;
 	logfile = fopen(file, "ab+");
 	return logfile != nullptr;
 }
@@ -191,8 +197,32 @@ void printer::print_msg(verbosity verbose, const char* fmt, ...)
 	buf[bpos] = '\n';
 	buf[bpos+1] = '\0';
 
+	if(bAsync.load(std::memory_order_relaxed))
+	{
+		push(buf, bpos + 1);
+		return;
+	}
+
+	std::unique_lock<std::mutex> lck(print_mutex);
+	write_out(buf, bpos + 1);
+}
+
+void printer::print_str(const char* str)
+{
+	if(bAsync.load(std::memory_order_relaxed))
+	{
+		push(str, strlen(str));
+		return;
+	}
+
 	std::unique_lock<std::mutex> lck(print_mutex);
-	fputs(buf, stdout);
+	write_out(str, strlen(str));
+}
+
+// Called with print_mutex held
+void printer::write_out(const char* str, size_t len)
+{
+	fwrite(str, 1, len, stdout);
 
 	if (b_flush_stdout)
 	{
@@ -201,20 +231,167 @@ void printer::print_msg(verbosity verbose, const char* fmt, ...)
 
 	if(logfile != nullptr)
 	{
-		fputs(buf, logfile);
+		fwrite(str, 1, len, logfile);
 		fflush(logfile);
+
+		if(logfile_max != 0 && uint64_t(ftell(logfile)) >= logfile_max)
+			rotate_logfile();
 	}
 }
 
-void printer::print_str(const char* str)
+void printer::rotate_logfile()
+{
+	fclose(logfile);
+
+	// rename doesn't replace an existing file on Windows
+	std::string old_name = logfile_name + ".1";
+	remove(old_name.c_str());
+	rename(logfile_name.c_str(), old_name.c_str());
+
+	logfile = fopen(logfile_name.c_str(), "ab+");
+}
+
+void printer::start_async()
+{
+	if(bAsync.exchange(true))
+		return;
+
+	std::thread(&printer::writer_main, this).detach();
+	// Error messages right before an exit would be lost otherwise
+	std::atexit([] { printer::inst()->flush(); });
+}
+
+printer::log_ring* printer::get_thread_ring()
+{
+	// The ring of a thread that ended is handed to the next new thread, with what it still holds
+	struct ring_owner
+	{
+		printer* prn = nullptr;
+		log_ring* pRing = nullptr;
+
+		~ring_owner()
+		{
+			if(pRing == nullptr)
+				return;
+			std::unique_lock<std::mutex> lck(prn->ring_mutex);
+			prn->vFreeRings.push_back(pRing);
+		}
+	};
+	static thread_local ring_owner owner;
+	if(owner.pRing != nullptr)
+		return owner.pRing;
+
+	std::unique_lock<std::mutex> lck(ring_mutex);
+	owner.prn = this;
+	if(!vFreeRings.empty())
+	{
+		owner.pRing = vFreeRings.back();
+		vFreeRings.pop_back();
+	}
+	else
+	{
+		owner.pRing = new log_ring;
+		vRings.push_back(owner.pRing);
+	}
+	return owner.pRing;
+}
+
+void printer::push(const char* str, size_t len)
+{
+	if(len == 0)
+		return;
+
+	log_ring* r = get_thread_ring();
+	size_t n = (len + iEntrySize - 1) / iEntrySize;
+	uint64_t iHead = r->iHead.load(std::memory_order_relaxed);
+	uint64_t iTail = r->iTail.load(std::memory_order_acquire);
+
+	if(iHead - iTail + n > iRingSize)
+	{
+		iDropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	// Long reports take several entries, their numbers follow each other
+	uint64_t iSeq = iNextSeq.fetch_add(n, std::memory_order_relaxed);
+	for(size_t k = 0; k < n; k++)
+	{
+		log_entry& e = r->oEntries[(iHead + k) & iRingMask];
+		size_t off = k * iEntrySize;
+		e.iSeq = iSeq + k;
+		e.iLen = len - off < iEntrySize ? len - off : iEntrySize;
+		memcpy(e.sText, str + off, e.iLen);
+	}
+
+	r->iHead.store(iHead + n, std::memory_order_release);
+
+	// The writer looks every 100 ms anyway, only a ring that fills up is worth a wake up
+	uint64_t iFill = iHead - iTail;
+	if(iFill < iWakeFill && iFill + n >= iWakeFill)
+		wake_cond.notify_one();
+}
+
+void printer::drain()
 {
 	std::unique_lock<std::mutex> lck(print_mutex);
-	fputs(str, stdout);
 
-	if(logfile != nullptr)
+	std::vector<log_ring*> rings;
 	{
-		fputs(str, logfile);
-		fflush(logfile);
+		std::unique_lock<std::mutex> rlck(ring_mutex);
+		rings = vRings;
+	}
+
+	struct pending
+	{
+		uint64_t iSeq;
+		log_entry* e;
+	};
+	std::vector<pending> vPending;
+	std::vector<uint64_t> vHeads(rings.size());
+	for(size_t i = 0; i < rings.size(); i++)
+	{
+		log_ring* r = rings[i];
+		vHeads[i] = r->iHead.load(std::memory_order_acquire);
+		for(uint64_t n = r->iTail.load(std::memory_order_relaxed); n < vHeads[i]; n++)
+		{
+			log_entry* e = &r->oEntries[n & iRingMask];
+			vPending.push_back({e->iSeq, e});
+		}
+	}
+
+	std::sort(vPending.begin(), vPending.end(), [](const pending& a, const pending& b) { return a.iSeq < b.iSeq; });
+	for(const pending& p : vPending)
+		write_out(p.e->sText, p.e->iLen);
+
+	for(size_t i = 0; i < rings.size(); i++)
+		rings[i]->iTail.store(vHeads[i], std::memory_order_release);
+
+	uint64_t iDrop = iDropped.load(std::memory_order_relaxed);
+	if(iDrop != iDroppedReported)
+	{
+		char buf[128];
+		snprintf(buf, sizeof(buf), "LOG: %llu messages dropped, the output can't keep up.\n", int_port(iDrop - iDroppedReported));
+		write_out(buf, strlen(buf));
+		iDroppedReported = iDrop;
+	}
+}
+
+void printer::flush()
+{
+	if(bAsync.load(std::memory_order_relaxed))
+		drain();
+}
+
+void printer::writer_main()
+{
+	while(true)
+	{
+		{
+			// A wake up that comes between drain() and the wait is caught by the timeout
+			std::unique_lock<std::mutex> lck(wake_mutex);
+			wake_cond.wait_for(lck, std::chrono::milliseconds(100));
+		}
+		drain();
 	}
 }
 
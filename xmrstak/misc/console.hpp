@@ -2,7 +2,13 @@
 
 #include "xmrstak/misc/environment.hpp"
 
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
+#include <string>
+#include <vector>
 
 
 enum out_colours { K_RED, K_GREEN, K_BLUE, K_YELLOW, K_CYAN, K_MAGENTA, K_WHITE, K_NONE };
@@ -23,6 +29,13 @@ inline long long unsigned int int_port(size_t i)
 
 enum verbosity : size_t { L0 = 0, L1 = 1, L2 = 2, L3 = 3, L4 = 4, LINF = 100};
 
+/* Console and log file output.
+ *
+ * Until start_async() the messages are written by the calling thread. After it every thread
+ * puts its messages, with the time of the call, into its own ring and a writer thread
+ * writes them out in call order, so a slow terminal or log file doesn't hold up the caller.
+ * A message that doesn't fit into the ring of its thread is dropped and counted.
+ */
 class printer
 {
 public:
@@ -38,15 +51,66 @@ public:
 	inline void set_flush_stdout(bool status) { b_flush_stdout = status; }
 	void print_msg(verbosity verbose, const char* fmt, ...);
 	void print_str(const char* str);
-	bool open_logfile(const char* file);
+	// iMaxSize in bytes, once the file is that big it is renamed to file.1, 0 means never
+	bool open_logfile(const char* file, uint64_t iMaxSize = 0);
+
+	void start_async();
+	// Writes out what the rings hold, also called at exit
+	void flush();
+	inline uint64_t get_dropped_count() { return iDropped.load(std::memory_order_relaxed); }
 
 private:
 	printer();
 
+	// A message takes one entry per started iEntrySize bytes
+	constexpr static size_t iEntrySize = 1024;
+	constexpr static size_t iRingSize = 2 << 5; //Power of 2 to simplify calculations
+	constexpr static size_t iRingMask = iRingSize - 1;
+	// Entries in a ring that wake the writer before its timeout
+	constexpr static size_t iWakeFill = iRingSize / 2;
+
+	struct log_entry
+	{
+		uint64_t iSeq;
+		size_t iLen;
+		char sText[iEntrySize];
+	};
+
+	// One writing thread and the writer thread
+	struct log_ring
+	{
+		std::atomic<uint64_t> iHead;
+		std::atomic<uint64_t> iTail;
+		log_entry oEntries[iRingSize];
+
+		log_ring() : iHead(0), iTail(0) {}
+	};
+
+	log_ring* get_thread_ring();
+	void push(const char* str, size_t len);
+	void drain();
+	void write_out(const char* str, size_t len);
+	void rotate_logfile();
+	void writer_main();
+
 	std::mutex print_mutex;
 	verbosity verbose_level;
 	bool b_flush_stdout;
 	FILE* logfile;
+	std::string logfile_name;
+	uint64_t logfile_max = 0;
+
+	std::atomic<bool> bAsync;
+	std::atomic<uint64_t> iNextSeq;
+	std::atomic<uint64_t> iDropped;
+	uint64_t iDroppedReported = 0;
+
+	std::mutex ring_mutex;
+	std::vector<log_ring*> vRings;
+	std::vector<log_ring*> vFreeRings;
+
+	std::mutex wake_mutex;
+	std::condition_variable wake_cond;
 };
 
 void win_exit(size_t code = 1);
@@ -0,0 +1,127 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "effective_hashrate.hpp"
+
+#include <math.h>
+
+namespace xmrstak
+{
+
+void effective_hashrate::add_share(uint64_t iTimeMs, uint64_t iDiff)
+{
+	dShares.push_back({iTimeMs, iDiff});
+	iTotalShares++;
+	fTotalDiff += double(iDiff);
+	fTotalDiffSq += double(iDiff) * double(iDiff);
+
+	while(dShares.front().iTime + iMaxWindowMs < iTimeMs)
+		dShares.pop_front();
+}
+
+void effective_hashrate::add_hashes(uint64_t iTimeMs, uint64_t iHashes, uint64_t iMiningMs)
+{
+	// The first interval started iMiningMs ago, its shares have to fall into every window too
+	if(dCheckpoints.empty())
+		dCheckpoints.push_back({iTimeMs > iMiningMs ? iTimeMs - iMiningMs : 0, 0, 0});
+
+	iTotalHashes += iHashes;
+	iTotalMiningMs += iMiningMs;
+
+	if(dCheckpoints.back().iTime + iCheckpointMs <= iTimeMs)
+		dCheckpoints.push_back({iTimeMs, iTotalHashes, iTotalMiningMs});
+
+	while(dCheckpoints.size() > 1 && dCheckpoints.front().iTime + iMaxWindowMs < iTimeMs)
+		dCheckpoints.pop_front();
+}
+
+void effective_hashrate::calc(uint64_t iNowMs, uint64_t iWindowMs, estimate& e)
+{
+	checkpoint oStart = {0, 0, 0};
+	uint64_t iShares = iTotalShares;
+	double fDiff = fTotalDiff;
+	double fDiffSq = fTotalDiffSq;
+
+	if(iWindowMs != 0)
+	{
+		// The first checkpoint in the window, the window is a bit shorter than asked
+		uint64_t iStart = iNowMs > iWindowMs ? iNowMs - iWindowMs : 0;
+		if(!dCheckpoints.empty())
+		{
+			oStart = dCheckpoints.back();
+			for(const checkpoint& cp : dCheckpoints)
+			{
+				if(cp.iTime >= iStart)
+				{
+					oStart = cp;
+					break;
+				}
+			}
+		}
+
+		iShares = 0;
+		fDiff = 0.0;
+		fDiffSq = 0.0;
+		for(auto it = dShares.rbegin(); it != dShares.rend() && it->iTime >= oStart.iTime; ++it)
+		{
+			iShares++;
+			fDiff += double(it->iDiff);
+			fDiffSq += double(it->iDiff) * double(it->iDiff);
+		}
+	}
+
+	double fHashes = double(iTotalHashes - oStart.iHashes);
+	e.iShares = iShares;
+	e.fSeconds = double(iTotalMiningMs - oStart.iMiningMs) / 1000.0;
+	e.fEffective = e.fLow = e.fHigh = e.fReported = e.fLuck = e.fZScore = nan("");
+
+	if(e.fSeconds <= 0.0)
+		return;
+
+	e.fEffective = fDiff / e.fSeconds;
+	e.fReported = fHashes / e.fSeconds;
+	if(fHashes > 0.0)
+		e.fLuck = fDiff / fHashes;
+
+	if(iShares == 0)
+	{
+		e.fLow = 0.0;
+		return;
+	}
+
+	// 95% interval of the share count, times the average difficulty
+	const double z = 1.96;
+	double n = double(iShares);
+	double fLowN = n * pow(1.0 - 1.0 / (9.0 * n) - z / (3.0 * sqrt(n)), 3.0);
+	double fHighN = (n + 1.0) * pow(1.0 - 1.0 / (9.0 * (n + 1.0)) + z / (3.0 * sqrt(n + 1.0)), 3.0);
+	double fAvgDiff = fDiff / n;
+	e.fLow = (fLowN > 0.0 ? fLowN : 0.0) * fAvgDiff / e.fSeconds;
+	e.fHigh = fHighN * fAvgDiff / e.fSeconds;
+
+	// If the reported hashes all made it, the accepted difficulty has that mean and a
+	// variance of the hashes times the difficulty weighted by itself
+	if(fHashes > 0.0)
+		e.fZScore = (fDiff - fHashes) / sqrt(fHashes * fDiffSq / fDiff);
+}
+
+} // namepsace xmrstak
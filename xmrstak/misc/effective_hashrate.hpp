@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+
+namespace xmrstak
+{
+
+/* Hashrate the pools actually credit, estimated from the difficulty of the accepted shares.
+ *
+ * A share of difficulty D takes D hashes on average, so the accepted difficulty per second
+ * estimates the hashrate. The share count is Poisson distributed, the confidence interval
+ * comes from the Wilson-Hilferty approximation of the Poisson one with the average share
+ * difficulty. The threads' own hash count over the same mining time is the reference: luck
+ * below 100% with a z score under -3 means hashes are lost to invalid results, stale jobs or
+ * the pool. Only the time mining for user pools counts, the dev pool shares aren't seen here.
+ * Windows up to iMaxWindowMs, one thread.
+ */
+class effective_hashrate
+{
+public:
+	constexpr static uint64_t iMaxWindowMs = 24 * 3600 * 1000;
+
+	struct estimate
+	{
+		uint64_t iShares;
+		// Mining time in the window
+		double fSeconds;
+		// Accepted difficulty per second and its 95% confidence interval
+		double fEffective;
+		double fLow;
+		double fHigh;
+		// Hashes the threads counted per second
+		double fReported;
+		// fEffective / fReported
+		double fLuck;
+		// Difference of the accepted difficulty and the reported hashes in standard deviations
+		double fZScore;
+	};
+
+	// iDiff is the difficulty the pool credits for the share
+	void add_share(uint64_t iTimeMs, uint64_t iDiff);
+	// Hashes of all threads while they mined for a user pool and the time that took
+	void add_hashes(uint64_t iTimeMs, uint64_t iHashes, uint64_t iMiningMs);
+
+	// Over the last iWindowMs, or since the start if iWindowMs is 0. NaN where there is no data
+	void calc(uint64_t iNowMs, uint64_t iWindowMs, estimate& e);
+
+private:
+	constexpr static uint64_t iCheckpointMs = 10000;
+
+	// Totals at a point in time, the windows start at one of them
+	struct checkpoint
+	{
+		uint64_t iTime;
+		uint64_t iHashes;
+		uint64_t iMiningMs;
+	};
+
+	struct share
+	{
+		uint64_t iTime;
+		uint64_t iDiff;
+	};
+
+	std::deque<checkpoint> dCheckpoints;
+	std::deque<share> dShares;
+
+	uint64_t iTotalHashes = 0;
+	uint64_t iTotalMiningMs = 0;
+	uint64_t iTotalShares = 0;
+	double fTotalDiff = 0.0;
+	double fTotalDiffSq = 0.0;
+};
+
+} // namepsace xmrstak
@@ -0,0 +1,181 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "energy_meter.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+namespace xmrstak
+{
+
+static bool read_file_u64(const std::string& sFile, uint64_t& iValue)
+{
+	FILE* f = fopen(sFile.c_str(), "r");
+	if(f == nullptr)
+		return false;
+
+	unsigned long long v;
+	bool bOk = fscanf(f, "%llu", &v) == 1;
+	fclose(f);
+	iValue = v;
+	return bOk;
+}
+
+energy_meter::energy_meter(const char* sPowercapDir) : vTimestamps(iBucketSize, 0)
+{
+#ifndef _WIN32
+	DIR* dir = opendir(sPowercapDir);
+	if(dir == nullptr)
+		return;
+
+	while(dirent* ent = readdir(dir))
+	{
+		if(ent->d_name[0] == '.')
+			continue;
+
+		std::string sZone = std::string(sPowercapDir) + "/" + ent->d_name + "/";
+		FILE* f = fopen((sZone + "name").c_str(), "r");
+		if(f == nullptr)
+			continue;
+
+		// Package zones are named package-N, the subzones core, uncore and dram are part of them
+		int id;
+		bool bPackage = fscanf(f, "package-%d", &id) == 1;
+		fclose(f);
+		if(!bPackage)
+			continue;
+
+		// intel-rapl and intel-rapl-mmio can both export the same package
+		bool bKnown = false;
+		for(const package& p : vPackages)
+			bKnown |= p.id == id;
+		if(bKnown)
+			continue;
+
+		package pkg;
+		pkg.id = id;
+		pkg.sEnergyFile = sZone + "energy_uj";
+		pkg.bHaveRaw = false;
+		pkg.iTotalUj = 0;
+		uint64_t iRaw;
+		if(!read_file_u64(sZone + "max_energy_range_uj", pkg.iMaxRange) || !read_raw(pkg, iRaw))
+		{
+			iUnreadable++;
+			continue;
+		}
+
+		pkg.vTotalUj.resize(iBucketSize, 0);
+		vPackages.push_back(pkg);
+	}
+	closedir(dir);
+#endif
+}
+
+bool energy_meter::read_raw(package& pkg, uint64_t& iRaw)
+{
+	return read_file_u64(pkg.sEnergyFile, iRaw);
+}
+
+void energy_meter::sample()
+{
+	if(vPackages.empty())
+		return;
+
+	using namespace std::chrono;
+	vTimestamps[iBucketTop] = time_point_cast<milliseconds>(steady_clock::now()).time_since_epoch().count();
+
+	for(package& pkg : vPackages)
+	{
+		uint64_t iRaw;
+		if(read_raw(pkg, iRaw))
+		{
+			if(pkg.bHaveRaw)
+				pkg.iTotalUj += iRaw >= pkg.iLastRaw ? iRaw - pkg.iLastRaw : pkg.iMaxRange - pkg.iLastRaw + iRaw;
+			pkg.iLastRaw = iRaw;
+			pkg.bHaveRaw = true;
+		}
+		pkg.vTotalUj[iBucketTop] = pkg.iTotalUj;
+	}
+
+	iBucketTop = (iBucketTop + 1) & iBucketMask;
+}
+
+double energy_meter::calc_watts(size_t iLastMilisec, size_t i)
+{
+	if(i >= vPackages.size())
+		return nan("");
+
+	//Start at 1, buckettop points to next empty
+	size_t iLatest = (iBucketTop - 1) & iBucketMask;
+	size_t iEarliest = iLatest;
+	bool bHaveFullSet = false;
+	for(size_t n = 1; n < iBucketSize; n++)
+	{
+		size_t idx = (iBucketTop - n) & iBucketMask;
+		if(vTimestamps[idx] == 0)
+			break; //That means we don't have the data yet
+
+		if(vTimestamps[iLatest] - vTimestamps[idx] > iLastMilisec)
+		{
+			bHaveFullSet = true;
+			break; //We are out of the requested time period
+		}
+		iEarliest = idx;
+	}
+
+	if(!bHaveFullSet || vTimestamps[iLatest] == vTimestamps[iEarliest])
+		return nan("");
+
+	const package& pkg = vPackages[i];
+	double fJoules = double(pkg.vTotalUj[iLatest] - pkg.vTotalUj[iEarliest]) / 1e6;
+	double fSec = double(vTimestamps[iLatest] - vTimestamps[iEarliest]) / 1000.0;
+	return fJoules / fSec;
+}
+
+double energy_meter::get_joules(size_t i)
+{
+	return i < vPackages.size() ? double(vPackages[i].iTotalUj) / 1e6 : nan("");
+}
+
+int energy_meter::get_cpu_package(int64_t iCpu)
+{
+	if(iCpu < 0)
+		return -1;
+
+	char sFile[128];
+	snprintf(sFile, sizeof(sFile), "/sys/devices/system/cpu/cpu%lld/topology/physical_package_id", (long long)iCpu);
+	uint64_t id;
+	if(!read_file_u64(sFile, id))
+		return -1;
+	return int(id);
+}
+
+} // namepsace xmrstak
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace xmrstak
+{
+
+/* Energy use of the CPU packages from the Linux powercap (RAPL) counters.
+ *
+ * Every package-N zone under the powercap directory is read on sample(), the counters
+ * wrap at max_energy_range_uj and are unwrapped here. Since kernel 5.10 energy_uj is
+ * readable by root only, without access (or on other systems) there are no packages
+ * and all the calc functions return NaN. Not thread safe, one sampling thread.
+ */
+class energy_meter
+{
+public:
+	energy_meter(const char* sPowercapDir = "/sys/class/powercap");
+
+	inline size_t get_package_count() { return vPackages.size(); }
+	// Physical package id of the i-th package we read
+	inline int get_package_id(size_t i) { return vPackages[i].id; }
+	// Zones we found but could not read
+	inline size_t get_unreadable_count() { return iUnreadable; }
+
+	void sample();
+
+	// Average power of the i-th package over the last iLastMilisec, NaN if we don't have the data
+	double calc_watts(size_t iLastMilisec, size_t i);
+	// Joules of the i-th package between the first and the last sample
+	double get_joules(size_t i);
+
+	// Physical package of a logical cpu, -1 if unknown
+	static int get_cpu_package(int64_t iCpu);
+
+private:
+	constexpr static size_t iBucketSize = 2 << 8; //Power of 2 to simplify calculations
+	constexpr static size_t iBucketMask = iBucketSize - 1;
+
+	struct package
+	{
+		int id;
+		std::string sEnergyFile;
+		uint64_t iMaxRange;
+		uint64_t iLastRaw;
+		bool bHaveRaw;
+		// Unwrapped micro joules since the first sample
+		uint64_t iTotalUj;
+		std::vector<uint64_t> vTotalUj;
+	};
+
+	bool read_raw(package& pkg, uint64_t& iRaw);
+
+	std::vector<package> vPackages;
+	std::vector<uint64_t> vTimestamps;
+	size_t iBucketTop = 0;
+	size_t iUnreadable = 0;
+};
+
+} // namepsace xmrstak
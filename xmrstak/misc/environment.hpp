@@ -8,6 +8,8 @@ namespace xmrstak
 {
 
 struct globalStates;
+class result_verifier;
+class tracer;
 struct params;
 
 struct environment
@@ -36,6 +38,8 @@ struct environment
 	jconf* pJconfConfig = nullptr;
 	executor* pExecutor = nullptr;
 	params* pParams = nullptr;
+	result_verifier* pResultVerifier = nullptr;
+	tracer* pTracer = nullptr;
 };
 
 } // namepsace xmrstak
@@ -24,12 +24,17 @@
 #include "xmrstak/jconf.hpp"
 #include "executor.hpp"
 #include "xmrstak/net/jpsock.hpp"
+#include "xmrstak/net/dns_cache.hpp"
+#include "xmrstak/net/stratum_proxy.hpp"
+#include "xmrstak/net/daemon_rpc.hpp"
 
 #include "telemetry.hpp"
+#include "tracer.hpp"
 #include "xmrstak/backend/miner_work.hpp"
 #include "xmrstak/backend/globalStates.hpp"
 #include "xmrstak/backend/backendConnector.hpp"
 #include "xmrstak/backend/iBackend.hpp"
+#include "xmrstak/backend/perf_events.hpp"
 
 #include "xmrstak/jconf.hpp"
 #include "xmrstak/misc/console.hpp"
@@ -52,6 +57,7 @@
 
 executor::executor()
 {
+	split_pool_id.fill(invalid_pool_id);
 }
 
 void executor::push_timed_event(ex_event&& ev, size_t sec)
@@ -91,6 +97,24 @@ void executor::ex_clock_thd()
 	}
 }
 
+/*
+ * Best pool first. A pool score changes while we look at it (a disconnect expires), so each
+ * pool is asked once - a comparator that changes its mind in the middle is undefined behaviour.
+ */
+inline void sort_by_weight(std::vector<jpsock*>& vPools, bool gross_weight)
+{
+	std::vector<std::pair<double, jpsock*>> vWeights;
+	vWeights.reserve(vPools.size());
+	for(jpsock* pool : vPools)
+		vWeights.emplace_back(pool->get_pool_weight(gross_weight), pool);
+
+	std::sort(vWeights.begin(), vWeights.end(),
+		[](const std::pair<double, jpsock*>& a, const std::pair<double, jpsock*>& b) { return b.first < a.first; });
+
+	for(size_t i=0; i < vPools.size(); i++)
+		vPools[i] = vWeights[i].second;
+}
+
 bool executor::get_live_pools(std::vector<jpsock*>& eval_pools, bool is_dev)
 {
 	size_t limit = jconf::inst()->GetGiveUpLimit();
@@ -122,12 +146,15 @@ bool executor::get_live_pools(std::vector<jpsock*>& eval_pools, bool is_dev)
 	{
 		if(!is_dev)
 		{
-			if(xmrstak::globalStates::inst().pool_id != invalid_pool_id)
+			if(xmrstak::globalStates::inst().get_slot(0).pool_id != invalid_pool_id)
 			{
 				printer::inst()->print_msg(L0, "All pools are dead. Idling...");
-				auto work = xmrstak::miner_work();
-				xmrstak::pool_data dat;
-				xmrstak::globalStates::inst().switch_work(work, dat);
+				for(size_t i=0; i < xmrstak::globalStates::inst().get_slot_count(); i++)
+				{
+					auto work = xmrstak::miner_work();
+					xmrstak::pool_data dat;
+					xmrstak::globalStates::inst().switch_work(work, dat, i);
+				}
 			}
 
 			if(over_limit == pool_count)
@@ -151,10 +178,16 @@ bool executor::get_live_pools(std::vector<jpsock*>& eval_pools, bool is_dev)
  */
 void executor::eval_pool_choice()
 {
+	bool dev_time = is_dev_time();
+	if(!dev_time && daemon != nullptr && daemon->is_ready())
+	{
+		eval_daemon_choice();
+		return;
+	}
+
 	std::vector<jpsock*> eval_pools;
 	eval_pools.reserve(pools.size());
 
-	bool dev_time = is_dev_time();
 	if(!get_live_pools(eval_pools, dev_time))
 		return;
 
@@ -186,10 +219,21 @@ void executor::eval_pool_choice()
 		return;
 	}
 
-	std::sort(eval_pools.begin(), eval_pools.end(), [](jpsock* a, jpsock* b) { return b->get_pool_weight(true) < a->get_pool_weight(true); });
+	sort_by_weight(eval_pools, true);
 	jpsock* goal = eval_pools[0];
 
-	if(goal->get_pool_id() != xmrstak::globalStates::inst().pool_id)
+	jpsock* cur = pick_pool_by_id(current_pool_id);
+	bool scoring = !dev_time && jconf::inst()->PoolScoring() && cur != nullptr && !cur->is_dev_pool() && cur->is_logged_in();
+	bool score_switch = false;
+	if(scoring && goal != cur)
+	{
+		if(score_beats(goal, cur))
+			score_switch = true;
+		else
+			goal = cur;
+	}
+
+	if(goal->get_pool_id() != xmrstak::globalStates::inst().get_slot(0).pool_id)
 	{
 		if(!goal->is_running() && goal->can_connect())
 		{
@@ -215,6 +259,8 @@ void executor::eval_pool_choice()
 
 			size_t prev_pool_id = current_pool_id;
 			current_pool_id = goal->get_pool_id();
+			if(score_switch)
+				score_switch_time = get_timestamp();
 			on_pool_have_job(current_pool_id, oPoolJob);
 
 			jpsock* prev_pool = pick_pool_by_id(prev_pool_id);
@@ -232,10 +278,10 @@ void executor::eval_pool_choice()
 	else
 	{
 		/* All is good - but check if we can do better */
-		std::sort(eval_pools.begin(), eval_pools.end(), [](jpsock* a, jpsock* b) { return b->get_pool_weight(false) < a->get_pool_weight(false); }); 
+		sort_by_weight(eval_pools, false);
 		jpsock* goal2 = eval_pools[0];
 
-		if(goal->get_pool_id() != goal2->get_pool_id())
+		if(goal->get_pool_id() != goal2->get_pool_id() && (!scoring || score_beats(goal2, goal)))
 		{
 			if(!goal2->is_running() && goal2->can_connect())
 			{
@@ -248,11 +294,35 @@ void executor::eval_pool_choice()
 		}
 	}
 
+	jpsock* standby = nullptr;
+	if(!dev_time && jconf::inst()->HotStandby())
+	{
+		// Next best user pool by its own weight, kept logged in so that we can fail over at once
+		for(jpsock* pool : eval_pools)
+		{
+			if(pool->is_dev_pool() || pool->get_pool_id() == goal->get_pool_id())
+				continue;
+			if(standby == nullptr || standby->get_pool_weight(false) < pool->get_pool_weight(false))
+				standby = pool;
+		}
+
+		if(standby != nullptr && !standby->is_running() && standby->can_connect())
+		{
+			printer::inst()->print_msg(L1, "Connecting to %s standby pool ...", standby->get_pool_addr());
+			std::string error;
+			if(!standby->connect(error))
+				log_socket_error(standby, std::move(error));
+		}
+	}
+
+	eval_split_pools(eval_pools, dev_time);
+
 	if(!dev_time)
 	{
 		for(jpsock& pool : pools)
 		{
-			if(goal->is_logged_in() && pool.is_logged_in() && pool.get_pool_id() != goal->get_pool_id())
+			if(goal->is_logged_in() && pool.is_logged_in() && pool.get_pool_id() != goal->get_pool_id() && &pool != standby &&
+				!is_split_pool(pool.get_pool_id()))
 				pool.disconnect(true);
 
 			if(pool.is_dev_pool() && pool.is_logged_in())
@@ -261,11 +331,129 @@ void executor::eval_pool_choice()
 	}
 }
 
+/*
+ * Solo mining - a working daemon beats any pool. All slots mine its template, the pools
+ * are only kept for the dev time and as a fallback when the daemon goes away.
+ */
+void executor::eval_daemon_choice()
+{
+	if(current_pool_id != daemon_pool_id)
+	{
+		pool_job oPoolJob;
+		if(!daemon->get_current_job(oPoolJob))
+			return;
+
+		current_pool_id = daemon_pool_id;
+		last_usr_pool_id = invalid_pool_id;
+		reset_stats();
+		on_pool_have_job(daemon_pool_id, oPoolJob);
+	}
+
+	for(jpsock& pool : pools)
+	{
+		if(pool.is_logged_in())
+			pool.disconnect(true);
+	}
+
+	split_pool_id.fill(invalid_pool_id);
+	refresh_split_slots();
+}
+
+/*
+ * Split mining - slot 0 mines the pool picked above, the extra slots mine the next best
+ * user pools that are logged in. Until then (and during dev time) they mine with slot 0.
+ */
+void executor::eval_split_pools(std::vector<jpsock*>& eval_pools, bool dev_time)
+{
+	size_t slots = xmrstak::globalStates::inst().get_slot_count();
+	if(slots <= 1)
+		return;
+
+	std::vector<jpsock*> split_pools;
+	if(!dev_time)
+	{
+		for(jpsock* pool : eval_pools)
+		{
+			if(!pool->is_dev_pool() && pool->get_pool_id() != current_pool_id)
+				split_pools.push_back(pool);
+		}
+		sort_by_weight(split_pools, false);
+	}
+
+	for(size_t i=1; i < slots; i++)
+	{
+		split_pool_id[i] = invalid_pool_id;
+		if(i - 1 >= split_pools.size())
+			continue;
+
+		jpsock* pool = split_pools[i - 1];
+		if(pool->is_logged_in())
+			split_pool_id[i] = pool->get_pool_id();
+		else if(!pool->is_running() && pool->can_connect())
+		{
+			printer::inst()->print_msg(L1, "Connecting to %s pool for split mining ...", pool->get_pool_addr());
+			std::string error;
+			if(!pool->connect(error))
+				log_socket_error(pool, std::move(error));
+		}
+	}
+
+	refresh_split_slots();
+}
+
+void executor::refresh_split_slots()
+{
+	for(size_t i=1; i < xmrstak::globalStates::inst().get_slot_count(); i++)
+	{
+		size_t target = get_slot_target(i);
+		if(target == xmrstak::globalStates::inst().get_slot(i).pool_id)
+			continue;
+
+		pool_job oPoolJob;
+		if(get_current_job(target, oPoolJob))
+			push_slot_job(i, target, oPoolJob);
+		else
+		{
+			auto work = xmrstak::miner_work();
+			xmrstak::pool_data dat;
+			xmrstak::globalStates::inst().switch_work(work, dat, i);
+		}
+	}
+}
+
+void executor::push_slot_job(size_t slot, size_t pool_id, pool_job& oPoolJob)
+{
+	jpsock* pool = pick_pool_by_id(pool_id);
+	bool nicehash = use_nicehash(pool, oPoolJob);
+
+	xmrstak::miner_work oWork(oPoolJob.sJobID, oPoolJob.bWorkBlob, oPoolJob.iWorkLen, oPoolJob.iTarget, nicehash, pool_id, oPoolJob.iRecvStamp);
+
+	// Nonce ranges of the slots don't overlap, so a slot can share a job with slot 0
+	xmrstak::pool_data dat;
+	dat.iSavedNonce = xmrstak::globalStates::inst().get_slot_start_nonce(slot, nicehash);
+	dat.pool_id = pool_id;
+
+	xmrstak::globalStates::inst().switch_work(oWork, dat, slot);
+	trace_lag(oJobSwitchLag, oPoolJob.iRecvStamp);
+}
+
+bool executor::score_beats(jpsock* cand, jpsock* cur)
+{
+	if(get_timestamp() - score_switch_time < iScoreDwellTime)
+		return false;
+	return cand->get_pool_weight(false) > cur->get_pool_weight(false) * (1.0 + fScoreMargin);
+}
+
 void executor::log_socket_error(jpsock* pool, std::string&& sError)
+{
+	log_socket_error(pool->get_pool_addr(), std::move(sError));
+}
+
+void executor::log_socket_error(const char* addr, std::string&& sError)
 {
 	std::string pool_name;
 	pool_name.reserve(128);
-	pool_name.append("[").append(pool->get_pool_addr()).append("] ");
+	pool_name.append("[").append(addr).append("] ");
 	sError.insert(0, pool_name);
 
 	vSocketLog.emplace_back(std::move(sError));
@@ -292,9 +480,10 @@ void executor::log_result_error(std::string&& sError)
 		sError.clear();
 }
 
-void executor::log_result_ok(uint64_t iActualDiff)
+void executor::log_result_ok(uint64_t iShareDiff, uint64_t iActualDiff)
 {
-	iPoolHashes += iPoolDiff;
+	// The difficulty of the pool the share went to, split pools have their own
+	iPoolHashes += iShareDiff;
 
 	size_t ln = iTopDiff.size() - 1;
 	if(iActualDiff > iTopDiff[ln])
@@ -318,12 +507,23 @@ jpsock* executor::pick_pool_by_id(size_t pool_id)
 	return nullptr;
 }
 
+bool executor::get_current_job(size_t pool_id, pool_job& oPoolJob)
+{
+	if(pool_id == daemon_pool_id)
+		return daemon != nullptr && daemon->get_current_job(oPoolJob);
+
+	jpsock* pool = pick_pool_by_id(pool_id);
+	return pool != nullptr && pool->get_current_job(oPoolJob);
+}
+
 void executor::on_sock_ready(size_t pool_id)
 {
 	jpsock* pool = pick_pool_by_id(pool_id);
 
 	if(pool->is_dev_pool())
 		printer::inst()->print_msg(L1, "Dev pool connected. Logging in...");
+	else if(pool->is_tls_resumed())
+		printer::inst()->print_msg(L1, "Pool %s connected, TLS session resumed. Logging in...", pool->get_pool_addr());
 	else
 		printer::inst()->print_msg(L1, "Pool %s connected. Logging in...", pool->get_pool_addr());
 
@@ -339,39 +539,110 @@ void executor::on_sock_ready(size_t pool_id)
 
 void executor::on_sock_error(size_t pool_id, std::string&& sError, bool silent)
 {
+	if(pool_id == daemon_pool_id)
+	{
+		if(current_pool_id == daemon_pool_id)
+		{
+			current_pool_id = invalid_pool_id;
+			oJournal.add_pool_switch(invalid_pool_id, daemon_pool_id);
+		}
+		refresh_split_slots();
+
+		// Queues a pool choice, the pools take over until the daemon is back
+		log_socket_error(daemon->get_daemon_addr(), std::move(sError));
+		return;
+	}
+
 	jpsock* pool = pick_pool_by_id(pool_id);
 
 	pool->disconnect();
 
-	if(pool_id == current_pool_id)
+	bool was_current = pool_id == current_pool_id;
+	if(was_current)
+	{
 		current_pool_id = invalid_pool_id;
+		oJournal.add_pool_switch(invalid_pool_id, pool_id);
+	}
 
-	if(silent)
-		return;
+	for(size_t& id : split_pool_id)
+	{
+		if(id == pool_id)
+			id = invalid_pool_id;
+	}
+	refresh_split_slots();
 
-	if(!pool->is_dev_pool())
-		log_socket_error(pool, std::move(sError));
-	else
-		printer::inst()->print_msg(L1, "Dev pool socket error - mining on user pool...");
+	if(!silent)
+	{
+		if(!pool->is_dev_pool())
+			log_socket_error(pool, std::move(sError));
+		else
+			printer::inst()->print_msg(L1, "Dev pool socket error - mining on user pool...");
+	}
+
+	// The standby pool is logged in and has a fresh job, don't let the miners idle until the next tick
+	if(was_current && jconf::inst()->HotStandby())
+		eval_pool_choice();
+}
+
+/*
+ * In proxy mode the clients mine with the top nonce byte values 1 - 255, so our own
+ * threads mine user pools in nicehash mode with zero in that byte.
+ */
+bool executor::use_nicehash(jpsock* pool, pool_job& oPoolJob)
+{
+	// Solo mining, the daemon's template has the whole nonce to itself
+	if(pool == nullptr)
+		return false;
+
+	if(jconf::inst()->GetProxyPort() == 0 || pool->is_dev_pool())
+		return pool->is_nicehash();
+
+	oPoolJob.bWorkBlob[42] = 0;
+	return true;
 }
 
 void executor::on_pool_have_job(size_t pool_id, pool_job& oPoolJob)
 {
-	if(pool_id != current_pool_id)
+	trace_lag(oJobQueueLag, oPoolJob.iRecvStamp);
+
+	if(pool_id == daemon_pool_id)
+	{
+		on_daemon_job(oPoolJob);
 		return;
+	}
 
 	jpsock* pool = pick_pool_by_id(pool_id);
 
-	xmrstak::miner_work oWork(oPoolJob.sJobID, oPoolJob.bWorkBlob, oPoolJob.iWorkLen, oPoolJob.iTarget, pool->is_nicehash(), pool_id);
+	if(!pool->is_dev_pool())
+		flush_share_outbox(pool, oPoolJob.sJobID);
+
+	// The proxy clients stay on the user pool while we mine for the dev pool
+	if(jconf::inst()->GetProxyPort() != 0 && !pool->is_dev_pool() && (pool_id == current_pool_id || pool_id == last_usr_pool_id))
+		stratum_proxy::inst()->push_job(pool_id, oPoolJob);
+
+	for(size_t i=1; i < xmrstak::globalStates::inst().get_slot_count(); i++)
+	{
+		if(get_slot_target(i) == pool_id)
+			push_slot_job(i, pool_id, oPoolJob);
+	}
+
+	if(pool_id != current_pool_id)
+		return;
+
+	xmrstak::miner_work oWork(oPoolJob.sJobID, oPoolJob.bWorkBlob, oPoolJob.iWorkLen, oPoolJob.iTarget, use_nicehash(pool, oPoolJob),
+		pool_id, oPoolJob.iRecvStamp);
 
 	xmrstak::pool_data dat;
 	dat.iSavedNonce = oPoolJob.iSavedNonce;
 	dat.pool_id = pool_id;
 
 	xmrstak::globalStates::inst().switch_work(oWork, dat);
+	trace_lag(oJobSwitchLag, oPoolJob.iRecvStamp);
 
 	if(dat.pool_id != pool_id)
 	{
+		oJournal.add_pool_switch(pool_id, dat.pool_id);
+
 		jpsock* prev_pool;
 		if((prev_pool = pick_pool_by_id(dat.pool_id)) != nullptr)
 			prev_pool->save_nonce(dat.iSavedNonce);
@@ -403,39 +674,177 @@ void executor::on_pool_have_job(size_t pool_id, pool_job& oPoolJob)
 		printer::inst()->print_msg(L3, "New block detected.");
 }
 
+void executor::on_daemon_job(pool_job& oPoolJob)
+{
+	for(size_t i=1; i < xmrstak::globalStates::inst().get_slot_count(); i++)
+	{
+		if(get_slot_target(i) == daemon_pool_id)
+			push_slot_job(i, daemon_pool_id, oPoolJob);
+	}
+
+	if(current_pool_id != daemon_pool_id)
+		return;
+
+	xmrstak::miner_work oWork(oPoolJob.sJobID, oPoolJob.bWorkBlob, oPoolJob.iWorkLen, oPoolJob.iTarget, false, daemon_pool_id, oPoolJob.iRecvStamp);
+
+	xmrstak::pool_data dat;
+	dat.iSavedNonce = oPoolJob.iSavedNonce;
+	dat.pool_id = daemon_pool_id;
+
+	xmrstak::globalStates::inst().switch_work(oWork, dat);
+	trace_lag(oJobSwitchLag, oPoolJob.iRecvStamp);
+
+	if(dat.pool_id != daemon_pool_id)
+		oJournal.add_pool_switch(daemon_pool_id, dat.pool_id);
+
+	jpsock* prev_pool;
+	if(dat.pool_id != daemon_pool_id && (prev_pool = pick_pool_by_id(dat.pool_id)) != nullptr)
+		prev_pool->save_nonce(dat.iSavedNonce);
+
+	if(iPoolDiff != daemon->get_current_diff())
+	{
+		iPoolDiff = daemon->get_current_diff();
+		printer::inst()->print_msg(L2, "Network difficulty changed. Now: %llu.", int_port(iPoolDiff));
+	}
+
+	if(dat.pool_id != daemon_pool_id)
+		printer::inst()->print_msg(L2, "Solo mining on daemon %s.", daemon->get_daemon_addr());
+	else
+		printer::inst()->print_msg(L3, "New block template, height %llu.", int_port(daemon->get_current_height()));
+}
+
+void executor::on_daemon_result(job_result& oResult)
+{
+	std::string error;
+	uint64_t height = 0;
+
+	using namespace std::chrono;
+	trace_lag(oShareSendLag, oResult.iFoundStamp);
+	xmrstak::trace_scope oTrace("submit_block", "share", oResult.iNonce);
+	uint64_t iSentStamp = xmrstak::get_timestamp_us();
+	size_t t_start = time_point_cast<milliseconds>(high_resolution_clock::now()).time_since_epoch().count();
+	bool bResult = daemon->submit_block(oResult, error, height);
+	size_t t_len = time_point_cast<milliseconds>(high_resolution_clock::now()).time_since_epoch().count() - t_start;
+
+	// Close to the network target, but the full 256 bit hash didn't make it
+	if(!bResult && error.empty())
+		return;
+
+	trace_lag(oShareReplyLag, iSentStamp);
+
+	if(t_len > 0xFFFF)
+		t_len = 0xFFFF;
+	iPoolCallTimes.push_back((uint16_t)t_len);
+
+	uint64_t* targets = (uint64_t*)oResult.bResult;
+	oJournal.add_share(daemon_pool_id, oResult.iThreadId, oResult.sJobID, oResult.iNonce, jpsock::t64_to_diff(targets[3]),
+		bResult ? xmrstak::journal::SHARE_ACCEPTED : xmrstak::journal::SHARE_REJECTED, since_stamp(oResult.iFoundStamp));
+
+	if(bResult)
+	{
+		oEffective.add_share(xmrstak::get_timestamp_us() / 1000, daemon->get_current_diff());
+		log_result_ok(daemon->get_current_diff(), jpsock::t64_to_diff(targets[3]));
+		printer::inst()->print_msg(L1, "Block found at height %llu, accepted by the daemon.", int_port(height));
+	}
+	else
+	{
+		printer::inst()->print_msg(L1, "Block at height %llu rejected by the daemon: %s", int_port(height), error.c_str());
+		log_result_error(std::move(error));
+	}
+}
+
+void executor::check_first_hash()
+{
+	for(xmrstak::iBackend* backend : *pvThreads)
+	{
+		// The thread stores the stats right before its first hash
+		uint64_t iStamp = backend->iTimestamp.load(std::memory_order_relaxed);
+		if(backend->iHashCount.load(std::memory_order_relaxed) != 0 && (iFirstHashTime == 0 || iStamp < iFirstHashTime))
+			iFirstHashTime = iStamp;
+	}
+
+	if(iFirstHashTime != 0)
+		printer::inst()->print_msg(L1, "First hash %.1f sec after the start.", (iFirstHashTime - xmrstak::params::inst().iStartTime) / 1000.0);
+}
+
+void executor::effective_tick()
+{
+	uint64_t iHashes = 0;
+	for(xmrstak::iBackend* backend : *pvThreads)
+		iHashes += backend->iHashCount.load(std::memory_order_relaxed);
+
+	uint64_t iNew = iHashes - iEffectiveHashes;
+	iEffectiveHashes = iHashes;
+
+	// The dev pool shares don't count, neither do the hashes for it
+	jpsock* pool = pick_pool_by_id(current_pool_id);
+	if(current_pool_id == daemon_pool_id || (pool != nullptr && !pool->is_dev_pool()))
+		oEffective.add_hashes(xmrstak::get_timestamp_us() / 1000, iNew, iTickTime);
+}
+
 void executor::on_miner_result(size_t pool_id, job_result& oResult)
 {
+	if(oShareFilter.is_duplicate(pool_id, oResult.sJobID, oResult.iNonce))
+	{
+		printer::inst()->print_msg(L3, "Duplicate result dropped, it was submitted before.");
+		return;
+	}
+
+	if(pool_id == daemon_pool_id)
+	{
+		on_daemon_result(oResult);
+		return;
+	}
+
 	jpsock* pool = pick_pool_by_id(pool_id);
-	bool is_monero = jconf::inst()->IsCurrencyMonero();
 
 	if(pool->is_dev_pool())
 	{
 		//Ignore errors silently
 		if(pool->is_running() && pool->is_logged_in())
-			pool->cmd_submit(oResult.sJobID, oResult.iNonce, oResult.bResult, pvThreads->at(oResult.iThreadId), is_monero);
+			pool->cmd_submit(oResult.sJobID, oResult.iNonce, oResult.bResult, pvThreads->at(oResult.iThreadId), jconf::inst()->IsCurrencyMonero());
 
 		return;
 	}
 
 	if (!pool->is_running() || !pool->is_logged_in())
 	{
-		log_result_error("[NETWORK ERROR]");
+		hold_share(pool_id, oResult);
 		return;
 	}
 
+	submit_share(pool, oResult);
+}
+
+void executor::submit_share(jpsock* pool, job_result& oResult)
+{
 	using namespace std::chrono;
+	trace_lag(oShareSendLag, oResult.iFoundStamp);
+	xmrstak::trace_scope oTrace("submit", "share", oResult.iNonce);
+	uint64_t iSentStamp = xmrstak::get_timestamp_us();
 	size_t t_start = time_point_cast<milliseconds>(high_resolution_clock::now()).time_since_epoch().count();
-	bool bResult = pool->cmd_submit(oResult.sJobID, oResult.iNonce, oResult.bResult, pvThreads->at(oResult.iThreadId), is_monero);
+	bool bResult = pool->cmd_submit(oResult.sJobID, oResult.iNonce, oResult.bResult, pvThreads->at(oResult.iThreadId), jconf::inst()->IsCurrencyMonero());
 	size_t t_len = time_point_cast<milliseconds>(high_resolution_clock::now()).time_since_epoch().count() - t_start;
 
+	if(!pool->have_sock_error())
+	{
+		pool->record_submit(bResult, t_len, pool->get_current_diff());
+		trace_lag(oShareReplyLag, iSentStamp);
+	}
+
 	if(t_len > 0xFFFF)
 		t_len = 0xFFFF;
 	iPoolCallTimes.push_back((uint16_t)t_len);
 
+	xmrstak::trace_instant(bResult ? "share_accepted" : pool->have_sock_error() ? "submit_failed" : "share_rejected", "share", oResult.iNonce);
+	uint64_t* targets = (uint64_t*)oResult.bResult;
+	oJournal.add_share(pool->get_pool_id(), oResult.iThreadId, oResult.sJobID, oResult.iNonce, jpsock::t64_to_diff(targets[3]),
+		bResult ? xmrstak::journal::SHARE_ACCEPTED : pool->have_sock_error() ? xmrstak::journal::SHARE_NOT_SENT : xmrstak::journal::SHARE_REJECTED,
+		pool->have_sock_error() ? 0 : since_stamp(oResult.iFoundStamp));
 	if(bResult)
 	{
-		uint64_t* targets = (uint64_t*)oResult.bResult;
-		log_result_ok(jpsock::t64_to_diff(targets[3]));
+		oEffective.add_share(xmrstak::get_timestamp_us() / 1000, pool->get_current_diff());
+		log_result_ok(pool->get_current_diff(), jpsock::t64_to_diff(targets[3]));
 		printer::inst()->print_msg(L3, "Result accepted by the pool.");
 	}
 	else
@@ -455,10 +864,102 @@ void executor::on_miner_result(size_t pool_id, job_result& oResult)
 			log_result_error(std::move(error));
 		}
 		else
-			log_result_error("[NETWORK ERROR]");
+			hold_share(pool->get_pool_id(), oResult);
+	}
+}
+
+void executor::hold_share(size_t pool_id, job_result& oResult)
+{
+	if(dShareOutbox.size() >= iOutboxSize)
+	{
+		iOutboxDropped++;
+		dShareOutbox.pop_front();
+		log_result_error("[NETWORK ERROR] Share outbox full");
+	}
+
+	dShareOutbox.push_back({pool_id, oResult});
+	printer::inst()->print_msg(L3, "Pool is reconnecting, result held back (%llu waiting).", int_port(dShareOutbox.size()));
+}
+
+/*
+ * Called with every job from a user pool, so the pool is logged in. Shares of the current job
+ * are sent, shares of any other job are stale - a new job means the old one is gone for good.
+ */
+void executor::flush_share_outbox(jpsock* pool, const char* sJobID)
+{
+	if(dShareOutbox.empty())
+		return;
+
+	size_t pool_id = pool->get_pool_id();
+	size_t expired = 0;
+	std::vector<job_result> vResend;
+	for(auto it = dShareOutbox.begin(); it != dShareOutbox.end();)
+	{
+		if(it->pool_id != pool_id)
+		{
+			++it;
+			continue;
+		}
+
+		if(strncmp(it->oResult.sJobID, sJobID, sizeof(job_result::sJobID)) == 0)
+			vResend.push_back(it->oResult);
+		else
+		{
+			expired++;
+			iOutboxDropped++;
+			log_result_error("[NETWORK ERROR] Job expired");
+		}
+		it = dShareOutbox.erase(it);
+	}
+
+	if(expired != 0)
+		printer::inst()->print_msg(L2, "%llu held back results expired with their job.", int_port(expired));
+
+	if(!vResend.empty())
+		printer::inst()->print_msg(L2, "Resubmitting %llu held back results.", int_port(vResend.size()));
+
+	for(job_result& oResult : vResend)
+	{
+		// A dropped connection puts the rest back in the outbox
+		if(!pool->is_running() || !pool->is_logged_in())
+		{
+			hold_share(pool_id, oResult);
+			continue;
+		}
+
+		iOutboxResent++;
+		submit_share(pool, oResult);
 	}
 }
 
+void executor::on_proxy_result(size_t pool_id, proxy_result& oProxyResult)
+{
+	jpsock* pool = pick_pool_by_id(pool_id);
+
+	if(pool == nullptr || !pool->is_running() || !pool->is_logged_in())
+	{
+		stratum_proxy::inst()->send_result(oProxyResult.iClientId, oProxyResult.iCallId, false, "Proxy lost the pool connection");
+		return;
+	}
+
+	job_result& oResult = oProxyResult.oResult;
+
+	using namespace std::chrono;
+	size_t t_start = time_point_cast<milliseconds>(high_resolution_clock::now()).time_since_epoch().count();
+	bool bResult = pool->cmd_submit(oResult.sJobID, oResult.iNonce, oResult.bResult, nullptr, jconf::inst()->IsCurrencyMonero());
+	size_t t_len = time_point_cast<milliseconds>(high_resolution_clock::now()).time_since_epoch().count() - t_start;
+
+	if(!pool->have_sock_error())
+		pool->record_submit(bResult, t_len, pool->get_current_diff());
+
+	std::string error;
+	if(!bResult)
+		error = pool->have_sock_error() ? "[NETWORK ERROR]" : pool->get_call_error();
+
+	printer::inst()->print_msg(L3, "Proxy result %s by the pool.", bResult ? "accepted" : "rejected");
+	stratum_proxy::inst()->send_result(oProxyResult.iClientId, oProxyResult.iCallId, bResult, error.c_str());
+}
+
 #ifndef _WIN32
 
 #include <signal.h>
@@ -476,6 +977,31 @@ void disable_sigpipe()
 inline void disable_sigpipe() {}
 #endif
 
+// Names of the events in the trace
+inline const char* ev_trace_name(ex_event_name ev)
+{
+	switch(ev)
+	{
+	case EV_SOCK_READY: return "EV_SOCK_READY";
+	case EV_SOCK_ERROR: return "EV_SOCK_ERROR";
+	case EV_GPU_RES_ERROR: return "EV_GPU_RES_ERROR";
+	case EV_POOL_HAVE_JOB: return "EV_POOL_HAVE_JOB";
+	case EV_MINER_HAVE_RESULT: return "EV_MINER_HAVE_RESULT";
+	case EV_PERF_TICK: return "EV_PERF_TICK";
+	case EV_EVAL_POOL_CHOICE: return "EV_EVAL_POOL_CHOICE";
+	case EV_USR_HASHRATE: return "EV_USR_HASHRATE";
+	case EV_USR_RESULTS: return "EV_USR_RESULTS";
+	case EV_USR_CONNSTAT: return "EV_USR_CONNSTAT";
+	case EV_HASHRATE_LOOP: return "EV_HASHRATE_LOOP";
+	case EV_HTML_HASHRATE: return "EV_HTML_HASHRATE";
+	case EV_HTML_RESULTS: return "EV_HTML_RESULTS";
+	case EV_HTML_CONNSTAT: return "EV_HTML_CONNSTAT";
+	case EV_HTML_JSON: return "EV_HTML_JSON";
+	case EV_PROXY_RESULT: return "EV_PROXY_RESULT";
+	default: return "EV_INVALID_VAL";
+	}
+}
+
 void executor::ex_main()
 {
 	disable_sigpipe();
@@ -484,17 +1010,14 @@ void executor::ex_main()
 
 	xmrstak::miner_work oWork = xmrstak::miner_work();
 
-	// \todo collect all backend threads
-	pvThreads = xmrstak::BackendConnector::thread_starter(oWork);
-
-	if(pvThreads->size()==0)
+	size_t split_cnt = jconf::inst()->GetSplitCount();
+	for(size_t i=0; i < split_cnt; i++)
 	{
-		printer::inst()->print_msg(L1, "ERROR: No miner backend enabled.");
-		win_exit();
+		jconf::split_cfg cfg;
+		jconf::inst()->GetSplitConfig(i, cfg);
+		xmrstak::globalStates::inst().set_split_shares(i, cfg.cpu_share, cfg.gpu_share);
 	}
 
-	telem = new xmrstak::telemetry(pvThreads->size());
-
 	set_timestamp();
 	size_t pc = jconf::inst()->GetPoolCount();
 	bool dev_tls = true;
@@ -555,23 +1078,85 @@ void executor::ex_main()
 			pools.emplace_front(0, "donate.xmr-stak.net:4444", "", "", 0.0, true, false, "", true);
 	}
 
+	// Warm up the DNS cache so that the first connect does not wait on a lookup
+	for(jpsock& pool : pools)
+		dns_cache::inst()->prefetch(pool.get_pool_addr());
+
+	if(jconf::inst()->GetDaemonAddress()[0] != '\0')
+	{
+		if(jconf::inst()->GetProxyPort() != 0)
+		{
+			printer::inst()->print_msg(L0, "ERROR: Solo mining can't be used together with the stratum proxy.");
+			win_exit();
+		}
+
+		daemon = new daemon_rpc(jconf::inst()->GetDaemonAddress(), jconf::inst()->GetDaemonWallet());
+		dns_cache::inst()->prefetch(daemon->get_daemon_addr());
+		printer::inst()->print_msg(L1, "Solo mining enabled, polling daemon %s ...", daemon->get_daemon_addr());
+		daemon->start();
+	}
+
+	if(jconf::inst()->GetProxyPort() != 0)
+	{
+		for(jpsock& pool : pools)
+		{
+			if(!pool.is_dev_pool() && pool.is_nicehash())
+			{
+				printer::inst()->print_msg(L1, "ERROR: Proxy mode can't split the nonce of a NiceHash pool (%s).", pool.get_pool_addr());
+				win_exit();
+			}
+		}
+
+		if(!stratum_proxy::inst()->start(jconf::inst()->GetProxyBind(), jconf::inst()->GetProxyPort(), jconf::inst()->GetProxyPassword()))
+			win_exit();
+	}
+
 	ex_event ev;
 	std::thread clock_thd(&executor::ex_clock_thd, this);
 
-	eval_pool_choice();
-
 	// Place the default success result at position 0, it needs to
 	// be here even if our first result is a failure
 	vMineResults.emplace_back();
 
+	// The pool sockets connect while the self test runs and the threads start, the login
+	// waits for the event loop
+	eval_pool_choice();
+
+	// \todo collect all backend threads
+	pvThreads = xmrstak::BackendConnector::thread_starter(oWork);
+
+	if(pvThreads->size()==0)
+	{
+		printer::inst()->print_msg(L1, "ERROR: No miner backend enabled.");
+		win_exit();
+	}
+
+	telem = new xmrstak::telemetry(pvThreads->size());
+
+	if(jconf::inst()->GetJournalFile()[0] != '\0')
+	{
+		std::string error;
+		if(oJournal.open(jconf::inst()->GetJournalFile(), jconf::inst()->GetJournalSize() * 1024 * 1024, error))
+			oJournal.add_start(pvThreads->size());
+		else
+			printer::inst()->print_msg(L0, "ERROR: Can't use the journal %s: %s", jconf::inst()->GetJournalFile(), error.c_str());
+	}
+	energy = new xmrstak::energy_meter();
+	thermal = new xmrstak::thermal_monitor();
+	if(energy->get_package_count() == 0 && energy->get_unreadable_count() != 0)
+		printer::inst()->print_msg(L1, "ENERGY: The RAPL counters need root to read, power is not reported.");
+
 	// If the user requested it, start the autohash printer
 	if(jconf::inst()->GetVerboseLevel() >= 4)
 		push_timed_event(ex_event(EV_HASHRATE_LOOP), jconf::inst()->GetAutohashTime());
 
+	xmrstak::tracer::set_thread_name("executor");
+
 	size_t cnt = 0;
 	while (true)
 	{
 		ev = oEventQ.pop();
+		xmrstak::trace_scope oTrace(ev_trace_name(ev.iName), "executor", ev.iPoolId);
 		switch (ev.iName)
 		{
 		case EV_SOCK_READY:
@@ -583,6 +1168,9 @@ void executor::ex_main()
 			break;
 
 		case EV_POOL_HAVE_JOB:
+			// Pool switches hand the current job to on_pool_have_job again, only an arrival is journalled
+			oJournal.add_job(ev.iPoolId, ev.oPoolJob.sJobID, ev.oPoolJob.iTarget != 0 ? jpsock::t64_to_diff(ev.oPoolJob.iTarget) : 0,
+				since_stamp(ev.oPoolJob.iRecvStamp));
 			on_pool_have_job(ev.iPoolId, ev.oPoolJob);
 			break;
 
@@ -590,6 +1178,10 @@ void executor::ex_main()
 			on_miner_result(ev.iPoolId, ev.oJobResult);
 			break;
 
+		case EV_PROXY_RESULT:
+			on_proxy_result(ev.iPoolId, ev.oProxyResult);
+			break;
+
 		case EV_EVAL_POOL_CHOICE:
 			eval_pool_choice();
 			break;
@@ -603,6 +1195,18 @@ void executor::ex_main()
 				telem->push_perf_value(i, pvThreads->at(i)->iHashCount.load(std::memory_order_relaxed),
 				pvThreads->at(i)->iTimestamp.load(std::memory_order_relaxed));
 
+			for (xmrstak::iBackend* backend : *pvThreads)
+			{
+				xmrstak::perf_events* perf = backend->pPerfEvents.load(std::memory_order_acquire);
+				if(perf != nullptr)
+					perf->sample(backend->iHashCount.load(std::memory_order_relaxed));
+			}
+			energy->sample();
+			thermal->sample();
+			effective_tick();
+			if(iFirstHashTime == 0)
+				check_first_hash();
+
 			if((cnt++ & 0xF) == 0) //Every 16 ticks
 			{
 				double fHps = 0.0;
@@ -626,6 +1230,12 @@ void executor::ex_main()
 				if(normal && fHighestHps < fHps)
 					fHighestHps = fHps;
 			}
+
+			if(oJournal.is_open() && cnt % sec_to_ticks(60) == 0)
+			{
+				for (i = 0; i < pvThreads->size(); i++)
+					oJournal.add_hashrate(i, telem->calc_telemetry_data(10000, i), pvThreads->at(i)->iHashCount.load(std::memory_order_relaxed));
+			}
 			break;
 
 		case EV_USR_HASHRATE:
@@ -654,6 +1264,21 @@ void executor::ex_main()
 	}
 }
 
+inline const char* perf_format(double h, const char* fmt, char* buf, size_t l)
+{
+	if(std::isnormal(h) || h == 0.0)
+	{
+		// snprintf can't take the field width from fmt for the (na) case, so pad it here
+		buf[0] = ' ';
+		snprintf(buf + 1, l - 1, fmt, h);
+		return buf;
+	}
+
+	int w = atoi(fmt + 1);
+	snprintf(buf, l, " %*s", w, "(na)");
+	return buf;
+}
+
 inline const char* hps_format(double h, char* buf, size_t l)
 {
 	if(std::isnormal(h) || h == 0.0)
@@ -665,6 +1290,22 @@ inline const char* hps_format(double h, char* buf, size_t l)
 		return "   (na)";
 }
 
+inline void latency_format(xmrstak::latency_hist& oHist, const char* sName, std::string& out)
+{
+	char num[128];
+	if(oHist.get_count() == 0)
+	{
+		snprintf(num, sizeof(num), "| %-18s |       0 |    (na) |    (na) |    (na) |    (na) |\n", sName);
+		out.append(num);
+		return;
+	}
+
+	snprintf(num, sizeof(num), "| %-18s | %7llu | %7.1f | %7.1f | %7.1f | %7.1f |\n", sName, int_port(oHist.get_count()),
+		oHist.calc_quantile(0.5) / 1000.0, oHist.calc_quantile(0.9) / 1000.0, oHist.calc_quantile(0.99) / 1000.0,
+		oHist.get_max() / 1000.0);
+	out.append(num);
+}
+
 bool executor::motd_filter_console(std::string& motd)
 {
 	if(motd.size() > motd_max_length)
@@ -788,6 +1429,81 @@ void executor::hashrate_report(std::string& out)
 			if((i & 0x1) == 1) //We had odd number of threads
 				out.append("|\n");
 
+			std::string invalid;
+			for (i = 0; i < nthd; i++)
+			{
+				uint64_t iInvalid = backEnds[i]->iInvalidCount.load(std::memory_order_relaxed);
+				if(iInvalid == 0)
+					continue;
+				snprintf(num, sizeof(num), " %u: %llu", (unsigned int)i, (unsigned long long)iInvalid);
+				invalid.append(num);
+			}
+			if(!invalid.empty())
+				out.append("Invalid results, ID:").append(invalid).append(1, '\n');
+
+			std::string throttled;
+			for (i = 0; i < nthd; i++)
+			{
+				double fMhz, fBaseMhz;
+				if(!is_throttled(backEnds[i]->iThreadNo, fMhz, fBaseMhz))
+					continue;
+				snprintf(num, sizeof(num), " %u (%.0f/%.0f MHz)", (unsigned int)i, fMhz, fBaseMhz);
+				throttled.append(num);
+			}
+			if(!throttled.empty())
+				out.append("Throttled, ID:").append(throttled).append(1, '\n');
+
+			std::string phases;
+			for (i = 0; i < nthd; i++)
+			{
+				uint64_t iHashes = backEnds[i]->iPhaseHashes.load(std::memory_order_relaxed);
+				if(iHashes == 0)
+					continue;
+				snprintf(num, sizeof(num), "| %2u |", (unsigned int)i);
+				phases.append(num);
+				for(size_t p = 0; p < xmrstak::iBackend::iPhaseCount; p++)
+				{
+					uint64_t iCycles = backEnds[i]->iPhaseCycles[p].load(std::memory_order_relaxed);
+					snprintf(num, sizeof(num), " %9llu |", (unsigned long long)(iCycles / iHashes));
+					phases.append(num);
+				}
+				phases.append(1, '\n');
+			}
+			if(!phases.empty())
+			{
+				out.append("Cycles per hash\n");
+				out.append("| ID |    keccak |   explode |      loop |   implode |     final |\n");
+				out.append(phases);
+			}
+
+			std::string counters;
+			for (i = 0; i < nthd; i++)
+			{
+				xmrstak::perf_events* perf = backEnds[i]->pPerfEvents.load(std::memory_order_acquire);
+				if(perf == nullptr)
+					continue;
+
+				double fPerHash[xmrstak::perf_events::COUNTER_COUNT], fGhz;
+				perf->calc_per_hash(60000, fPerHash, fGhz);
+
+				using pe = xmrstak::perf_events;
+				snprintf(num, sizeof(num), "| %2u |", (unsigned int)i);
+				counters.append(num);
+				counters.append(perf_format(fPerHash[pe::CYCLES] / 1e6, "%8.2f", num, sizeof(num))).append(" |");
+				counters.append(perf_format(fPerHash[pe::INSTRUCTIONS] / 1e6, "%8.2f", num, sizeof(num))).append(" |");
+				counters.append(perf_format(fPerHash[pe::INSTRUCTIONS] / fPerHash[pe::CYCLES], "%5.2f", num, sizeof(num))).append(" |");
+				counters.append(perf_format(fPerHash[pe::LLC_MISSES], "%8.0f", num, sizeof(num))).append(" |");
+				counters.append(perf_format(fPerHash[pe::DTLB_MISSES], "%8.0f", num, sizeof(num))).append(" |");
+				counters.append(perf_format(fPerHash[pe::STALLED_CYCLES] * 100.0 / fPerHash[pe::CYCLES], "%6.1f", num, sizeof(num))).append(" |");
+				counters.append(perf_format(fGhz, "%5.2f", num, sizeof(num))).append(" |\n");
+			}
+			if(!counters.empty())
+			{
+				out.append("Hardware counters per hash (60s)\n");
+				out.append("| ID | Mcycles |  Minstr |   IPC | LLC miss | TLB miss | stall% |   GHz |\n");
+				out.append(counters);
+			}
+
 			if(nthd != 1)
 				out.append("-----------------------------------------------------\n");
 			else
@@ -802,6 +1518,86 @@ void executor::hashrate_report(std::string& out)
 	out.append(" H/s\nHighest: ");
 	out.append(hps_format(fHighestHps, num, sizeof(num)));
 	out.append(" H/s\n");
+
+	if(thermal->get_zone_count() != 0)
+	{
+		out.append("Temperature:");
+		for(size_t z = 0; z < thermal->get_zone_count(); z++)
+		{
+			snprintf(num, sizeof(num), " %.1f C", thermal->calc_zone_celsius(z, 10000));
+			out.append(z == 0 ? " " : ", ").append(thermal->get_zone_type(z)).append(num);
+		}
+		out.append(1, '\n');
+	}
+
+	std::vector<energy_data> vPackages;
+	energy_data oTotal;
+	calc_energy_data(vPackages, oTotal);
+	if(vPackages.empty())
+		return;
+
+	out.append("Power:   ");
+	out.append(hps_format(oTotal.fWatts, num, sizeof(num))).append(" W  ");
+	out.append(perf_format(oTotal.fHashPerJoule, "%6.2f", num, sizeof(num))).append(" H/J (60s, CPU)\n");
+	for(size_t i = 0; i < vPackages.size(); i++)
+	{
+		snprintf(num, sizeof(num), "Package %d:", energy->get_package_id(i));
+		out.append(num);
+		out.append(hps_format(vPackages[i].fWatts, num, sizeof(num))).append(" W  ");
+		out.append(perf_format(vPackages[i].fHashPerJoule, "%6.2f", num, sizeof(num))).append(" H/J\n");
+	}
+}
+
+bool executor::is_throttled(size_t iThd, double& fMhz, double& fBaseMhz)
+{
+	int64_t iCpu = thermal->find_cpu(pvThreads->at(iThd)->iAffinity);
+	if(iCpu < 0)
+		return false;
+
+	// The base ends where the recent window starts, a long throttle would pull it down too
+	fMhz = thermal->calc_cpu_mhz(iCpu, 10000);
+	fBaseMhz = thermal->calc_cpu_mhz(iCpu, 290000, 10000);
+	double fHps = telem->calc_telemetry_data(10000, iThd);
+	double fBaseHps = telem->calc_telemetry_data(300000, iThd);
+
+	// NaN until we have 5 minutes of data, the compares are false then
+	return fHps < fBaseHps * 0.9 && fMhz < fBaseMhz * 0.9;
+}
+
+void executor::calc_energy_data(std::vector<energy_data>& vPackages, energy_data& oTotal)
+{
+	size_t nPkg = energy->get_package_count();
+	vPackages.assign(nPkg, { 0.0, nan("") });
+	oTotal = { 0.0, nan("") };
+	if(nPkg == 0)
+		return;
+
+	// RAPL covers the CPU only, the GPUs have their own power supply lines
+	std::vector<double> vHps(nPkg, 0.0);
+	double fCpuHps = 0.0;
+	for(size_t i = 0; i < pvThreads->size(); i++)
+	{
+		xmrstak::iBackend* backend = pvThreads->at(i);
+		if(backend->backendType != xmrstak::iBackend::CPU)
+			continue;
+
+		double fHps = telem->calc_telemetry_data(60000, i);
+		fCpuHps += fHps;
+		for(size_t p = 0; p < nPkg; p++)
+		{
+			// With a single package every thread runs on it, pinned or not
+			if(nPkg == 1 || backend->iPackage == energy->get_package_id(p))
+				vHps[p] += fHps;
+		}
+	}
+
+	for(size_t p = 0; p < nPkg; p++)
+	{
+		vPackages[p].fWatts = energy->calc_watts(60000, p);
+		vPackages[p].fHashPerJoule = vHps[p] / vPackages[p].fWatts;
+		oTotal.fWatts += vPackages[p].fWatts;
+	}
+	oTotal.fHashPerJoule = fCpuHps / oTotal.fWatts;
 }
 
 char* time_format(char* buf, size_t len, std::chrono::system_clock::time_point time)
@@ -825,6 +1621,26 @@ char* time_format(char* buf, size_t len, std::chrono::system_clock::time_point t
 	return buf;
 }
 
+// Windows of the effective hashrate, 0 is the time since the start
+static const struct
+{
+	const char* sName;
+	uint64_t iWindowMs;
+} oEffectiveWindows[] = { {"15m", 15 * 60 * 1000}, {"1h", 3600 * 1000}, {"24h", 24 * 3600 * 1000}, {"total", 0} };
+
+inline void effective_format(xmrstak::effective_hashrate::estimate& e, const char* sName, std::string& out)
+{
+	char num[128];
+	snprintf(num, sizeof(num), "| %-6s | %6llu |", sName, int_port(e.iShares));
+	out.append(num);
+	out.append(hps_format(e.fEffective, num, sizeof(num))).append(" |");
+	out.append(hps_format(e.fLow, num, sizeof(num))).append(" -");
+	out.append(hps_format(e.fHigh, num, sizeof(num))).append(" |");
+	out.append(hps_format(e.fReported, num, sizeof(num))).append(" |");
+	out.append(perf_format(e.fLuck * 100.0, "%6.1f", num, sizeof(num))).append(" |");
+	out.append(perf_format(e.fZScore, "%6.1f", num, sizeof(num))).append(" |\n");
+}
+
 void executor::result_report(std::string& out)
 {
 	char num[128];
@@ -854,6 +1670,29 @@ void executor::result_report(std::string& out)
 	snprintf(num, sizeof(num), " (%.1f %%)\n", 100.0 * iGoodRes / iTotalRes);
 
 	out.append("Difficulty       : ").append(std::to_string(iPoolDiff)).append(1, '\n');
+	for(size_t i=1; i < xmrstak::globalStates::inst().get_slot_count(); i++)
+	{
+		size_t pool_id = split_pool_id[i];
+		uint64_t iDiff;
+		const char* sAddr;
+		jpsock* pool;
+		if(pool_id == daemon_pool_id && daemon != nullptr)
+		{
+			iDiff = daemon->get_current_diff();
+			sAddr = daemon->get_daemon_addr();
+		}
+		else if((pool = pick_pool_by_id(pool_id)) != nullptr)
+		{
+			iDiff = pool->get_current_diff();
+			sAddr = pool->get_pool_addr();
+		}
+		else
+			continue;
+
+		char sDiff[128];
+		snprintf(sDiff, sizeof(sDiff), "Difficulty slot %u: %llu (%s)\n", (unsigned int)i, int_port(iDiff), sAddr);
+		out.append(sDiff);
+	}
 	out.append("Good results     : ").append(std::to_string(iGoodRes)).append(" / ").
 		append(std::to_string(iTotalRes)).append(num);
 
@@ -863,7 +1702,28 @@ void executor::result_report(std::string& out)
 		snprintf(num, sizeof(num), "%.1f sec\n", dConnSec / iPoolCallTimes.size());
 		out.append("Avg result time  : ").append(num);
 	}
-	out.append("Pool-side hashes : ").append(std::to_string(iPoolHashes)).append(2, '\n');
+	out.append("Pool-side hashes : ").append(std::to_string(iPoolHashes)).append(1, '\n');
+	if(oShareFilter.get_suppressed() != 0)
+		out.append("Duplicates       : ").append(std::to_string(oShareFilter.get_suppressed())).append(" not submitted\n");
+	if(iOutboxResent != 0 || iOutboxDropped != 0 || !dShareOutbox.empty())
+	{
+		snprintf(num, sizeof(num), "Held back        : %llu resent, %llu dropped, %llu waiting\n",
+			int_port(iOutboxResent), int_port(iOutboxDropped), int_port(dShareOutbox.size()));
+		out.append(num);
+	}
+	if(printer::inst()->get_dropped_count() != 0)
+		out.append("Log lines lost   : ").append(std::to_string(printer::inst()->get_dropped_count())).append(1, '\n');
+
+	out.append("\nEffective hashrate from the accepted shares, with the 95% interval:\n");
+	out.append("| Window | Shares |    H/s |        Interval |  Local | Luck % |      z |\n");
+	uint64_t iNow = xmrstak::get_timestamp_us() / 1000;
+	for(const auto& w : oEffectiveWindows)
+	{
+		xmrstak::effective_hashrate::estimate e;
+		oEffective.calc(iNow, w.iWindowMs, e);
+		effective_format(e, w.sName, out);
+	}
+	out.append(1, '\n');
 	out.append("Top 10 best results found:\n");
 
 	for(size_t i=0; i < 10; i += 2)
@@ -899,9 +1759,14 @@ void executor::connection_report(std::string& out)
 	if(pool != nullptr && pool->is_dev_pool())
 		pool = pick_pool_by_id(last_usr_pool_id);
 
+	bool solo = current_pool_id == daemon_pool_id;
+
 	out.append("CONNECTION REPORT\n");
-	out.append("Pool address    : ").append(pool != nullptr ? pool->get_pool_addr() : "<not connected>").append(1, '\n');
-	if(pool != nullptr && pool->is_running() && pool->is_logged_in())
+	if(solo)
+		out.append("Daemon address  : ").append(daemon->get_daemon_addr()).append(" (solo)\n");
+	else
+		out.append("Pool address    : ").append(pool != nullptr ? pool->get_pool_addr() : "<not connected>").append(1, '\n');
+	if(solo || (pool != nullptr && pool->is_running() && pool->is_logged_in()))
 		out.append("Connected since : ").append(time_format(date, sizeof(date), tPoolConnTime)).append(1, '\n');
 	else
 		out.append("Connected since : <not connected>\n");
@@ -916,6 +1781,44 @@ void executor::connection_report(std::string& out)
 	else
 		out.append("Pool ping time  : (n/a)\n");
 
+	if(pool != nullptr && jconf::inst()->PoolScoring())
+	{
+		snprintf(num, sizeof(num), "Pool score      : %.2f\n", pool->get_pool_score());
+		out.append(num);
+	}
+
+	if(pool != nullptr && pool->is_tls())
+	{
+		size_t iFull, iResumed;
+		pool->get_tls_handshakes(iFull, iResumed);
+		snprintf(num, sizeof(num), "TLS handshakes  : %llu full, %llu resumed\n", int_port(iFull), int_port(iResumed));
+		out.append(num);
+	}
+
+	if(jconf::inst()->GetProxyPort() != 0)
+	{
+		size_t iClients, iAccepted, iRejected;
+		stratum_proxy::inst()->get_stats(iClients, iAccepted, iRejected);
+		snprintf(num, sizeof(num), "Proxy clients   : %llu, shares %llu accepted, %llu rejected\n", int_port(iClients), int_port(iAccepted), int_port(iRejected));
+		out.append(num);
+	}
+
+	out.append("\nLatency in ms since the start\n");
+	out.append("| Stage              |   Count |     50% |     90% |     99% |     Max |\n");
+	latency_format(oJobQueueLag, "Job to executor", out);
+	latency_format(oJobSwitchLag, "Job switched", out);
+	latency_format(xmrstak::globalStates::inst().oJobStartLag, "Job on all threads", out);
+	for(size_t i = 0; i < pvThreads->size(); i++)
+	{
+		xmrstak::latency_hist& oLag = pvThreads->at(i)->oJobLag;
+		if(oLag.get_count() == 0)
+			continue;
+		snprintf(num, sizeof(num), "Job on thread %u", (unsigned int)i);
+		latency_format(oLag, num, out);
+	}
+	latency_format(oShareSendLag, "Share to submit", out);
+	latency_format(oShareReplyLag, "Submit to reply", out);
+
 	out.append("\nNetwork error log:\n");
 	size_t ln = vSocketLog.size();
 	if(ln > 0)
@@ -1086,8 +1989,10 @@ void executor::http_connection_report(std::string& out)
 	if(pool != nullptr && pool->is_dev_pool())
 		pool = pick_pool_by_id(last_usr_pool_id);
 
+	bool solo = current_pool_id == daemon_pool_id;
+
 	const char* cdate = "not connected";
-	if (pool != nullptr && pool->is_running() && pool->is_logged_in())
+	if (solo || (pool != nullptr && pool->is_running() && pool->is_logged_in()))
 		cdate = time_format(date, sizeof(date), tPoolConnTime);
 
 	size_t n_calls = iPoolCallTimes.size();
@@ -1099,9 +2004,17 @@ void executor::http_connection_report(std::string& out)
 		ping_time = iPoolCallTimes[n_calls/2];
 	}
 
+	char tls_hs[64] = "n/a";
+	if(pool != nullptr && pool->is_tls())
+	{
+		size_t iFull, iResumed;
+		pool->get_tls_handshakes(iFull, iResumed);
+		snprintf(tls_hs, sizeof(tls_hs), "%llu full, %llu resumed", int_port(iFull), int_port(iResumed));
+	}
+
 	snprintf(buffer, sizeof(buffer), sHtmlConnectionBodyHigh,
-		pool != nullptr ? pool->get_pool_addr() : "not connected",
-		cdate, ping_time);
+		solo ? daemon->get_daemon_addr() : pool != nullptr ? pool->get_pool_addr() : "not connected",
+		cdate, ping_time, tls_hs);
 	out.append(buffer);
 
 
@@ -1115,6 +2028,36 @@ void executor::http_connection_report(std::string& out)
 	out.append(sHtmlConnectionBodyLow);
 }
 
+inline const char* perf_format_json(double h, char* buf, size_t l)
+{
+	if(std::isnormal(h) || h == 0.0)
+	{
+		snprintf(buf, l, "%.2f", h);
+		return buf;
+	}
+	else
+		return "null";
+}
+
+// Count, 50/90/99% and max in microseconds, then the power of 2 buckets without the empty top ones
+inline void latency_format_json(xmrstak::latency_hist& oHist, std::string& out)
+{
+	char num[256];
+	snprintf(num, sizeof(num), sJsonApiLatency, int_port(oHist.get_count()), oHist.calc_quantile(0.5),
+		oHist.calc_quantile(0.9), oHist.calc_quantile(0.99), int_port(oHist.get_max()));
+	out.append(num);
+
+	size_t iTop = xmrstak::latency_hist::iBucketCount;
+	while(iTop > 0 && oHist.get_bucket(iTop - 1) == 0)
+		iTop--;
+	for(size_t i = 0; i < iTop; i++)
+	{
+		snprintf(num, sizeof(num), i == 0 ? "%llu" : ",%llu", int_port(oHist.get_bucket(i)));
+		out.append(num);
+	}
+	out.append("]}");
+}
+
 inline const char* hps_format_json(double h, char* buf, size_t l)
 {
 	if(std::isnormal(h) || h == 0.0)
@@ -1164,6 +2107,105 @@ void executor::http_json_report(std::string& out)
 
 	a = hps_format_json(fHighestHps, num_a, sizeof(num_a));
 
+	std::string perf_thds;
+	for(xmrstak::iBackend* backend : *pvThreads)
+	{
+		xmrstak::perf_events* perf = backend->pPerfEvents.load(std::memory_order_acquire);
+		if(perf == nullptr)
+			continue;
+
+		double fPerHash[xmrstak::perf_events::COUNTER_COUNT], fGhz;
+		perf->calc_per_hash(60000, fPerHash, fGhz);
+
+		char perf_num[6][32];
+		char perf_buffer[384];
+		if(!perf_thds.empty()) perf_thds.append(1, ',');
+		snprintf(perf_buffer, sizeof(perf_buffer), sJsonApiThdPerf, (unsigned int)backend->iThreadNo,
+			perf_format_json(fPerHash[0], perf_num[0], sizeof(perf_num[0])), perf_format_json(fPerHash[1], perf_num[1], sizeof(perf_num[1])),
+			perf_format_json(fPerHash[2], perf_num[2], sizeof(perf_num[2])), perf_format_json(fPerHash[3], perf_num[3], sizeof(perf_num[3])),
+			perf_format_json(fPerHash[4], perf_num[4], sizeof(perf_num[4])), perf_format_json(fGhz, perf_num[5], sizeof(perf_num[5])));
+		perf_thds.append(perf_buffer);
+	}
+
+	// 10 second averages of the last 5 minutes, the newest first
+	constexpr size_t iSeriesStep = 10000;
+	constexpr size_t iSeriesLen = 30;
+	auto append_series = [](std::string& out, const std::function<double(size_t)>& calc)
+	{
+		char num[32];
+		for(size_t n = 0; n < iSeriesLen; n++)
+		{
+			if(n != 0) out.append(1, ',');
+			out.append(perf_format_json(calc(n * iSeriesStep), num, sizeof(num)));
+		}
+	};
+
+	std::string thermal_cpus, thermal_zones, throttled;
+	for(size_t c = 0; c < thermal->get_cpu_count(); c++)
+	{
+		char cpu_buffer[64];
+		if(c != 0) thermal_cpus.append(1, ',');
+		snprintf(cpu_buffer, sizeof(cpu_buffer), sJsonApiCpuClock, (long long)thermal->get_cpu_id(c));
+		thermal_cpus.append(cpu_buffer);
+		append_series(thermal_cpus, [&](size_t iAgo) { return thermal->calc_cpu_mhz(c, iSeriesStep, iAgo); });
+		thermal_cpus.append("]}");
+	}
+	for(size_t z = 0; z < thermal->get_zone_count(); z++)
+	{
+		char zone_buffer[128];
+		if(z != 0) thermal_zones.append(1, ',');
+		snprintf(zone_buffer, sizeof(zone_buffer), sJsonApiThermalZone, thermal->get_zone_type(z).c_str());
+		thermal_zones.append(zone_buffer);
+		append_series(thermal_zones, [&](size_t iAgo) { return thermal->calc_zone_celsius(z, iSeriesStep, iAgo); });
+		thermal_zones.append("]}");
+	}
+	for(size_t i = 0; i < nthd; i++)
+	{
+		double fMhz, fBaseMhz;
+		if(!is_throttled(i, fMhz, fBaseMhz))
+			continue;
+		if(!throttled.empty()) throttled.append(1, ',');
+		throttled.append(std::to_string(i));
+	}
+
+	std::vector<energy_data> vPackages;
+	energy_data oEnergy;
+	calc_energy_data(vPackages, oEnergy);
+
+	std::string pkg_energy;
+	for(size_t p = 0; p < vPackages.size(); p++)
+	{
+		char energy_buffer[128];
+		char num_w[32], num_hpj[32];
+		if(p != 0) pkg_energy.append(1, ',');
+		snprintf(energy_buffer, sizeof(energy_buffer), sJsonApiPackageEnergy, energy->get_package_id(p),
+			perf_format_json(vPackages[p].fWatts, num_w, sizeof(num_w)), perf_format_json(vPackages[p].fHashPerJoule, num_hpj, sizeof(num_hpj)));
+		pkg_energy.append(energy_buffer);
+	}
+
+	char num_w[32], num_hpj[32];
+	const char* energy_w = vPackages.empty() ? "null" : perf_format_json(oEnergy.fWatts, num_w, sizeof(num_w));
+	const char* energy_hpj = vPackages.empty() ? "null" : perf_format_json(oEnergy.fHashPerJoule, num_hpj, sizeof(num_hpj));
+
+	// Only CPU threads running the profiling kernels have phase counts
+	std::string phase_thds;
+	for(xmrstak::iBackend* backend : *pvThreads)
+	{
+		uint64_t iHashes = backend->iPhaseHashes.load(std::memory_order_relaxed);
+		if(iHashes == 0)
+			continue;
+
+		uint64_t iCycles[xmrstak::iBackend::iPhaseCount];
+		for(size_t p = 0; p < xmrstak::iBackend::iPhaseCount; p++)
+			iCycles[p] = backend->iPhaseCycles[p].load(std::memory_order_relaxed) / iHashes;
+
+		char phase_buffer[256];
+		if(!phase_thds.empty()) phase_thds.append(1, ',');
+		snprintf(phase_buffer, sizeof(phase_buffer), sJsonApiThdPhases, (unsigned int)backend->iThreadNo, int_port(iHashes),
+			int_port(iCycles[0]), int_port(iCycles[1]), int_port(iCycles[2]), int_port(iCycles[3]), int_port(iCycles[4]));
+		phase_thds.append(phase_buffer);
+	}
+
 	size_t iGoodRes = vMineResults[0].count, iTotalRes = iGoodRes;
 	size_t ln = vMineResults.size();
 
@@ -1175,7 +2217,7 @@ void executor::http_json_report(std::string& out)
 		pool = pick_pool_by_id(last_usr_pool_id);
 
 	size_t iConnSec = 0;
-	if(pool != nullptr && pool->is_running() && pool->is_logged_in())
+	if(current_pool_id == daemon_pool_id || (pool != nullptr && pool->is_running() && pool->is_logged_in()))
 	{
 		using namespace std::chrono;
 		iConnSec = duration_cast<seconds>(system_clock::now() - tPoolConnTime).count();
@@ -1219,15 +2261,63 @@ void executor::http_json_report(std::string& out)
 		cn_error.append(buffer);
 	}
 
-	size_t bb_size = 2048 + hr_thds.size() + res_error.size() + cn_error.size();
+	size_t iTlsFull = 0, iTlsResumed = 0;
+	if(pool != nullptr)
+		pool->get_tls_handshakes(iTlsFull, iTlsResumed);
+
+	std::string effective;
+	uint64_t iNow = xmrstak::get_timestamp_us() / 1000;
+	for(const auto& w : oEffectiveWindows)
+	{
+		xmrstak::effective_hashrate::estimate e;
+		oEffective.calc(iNow, w.iWindowMs, e);
+
+		char num_e[32], num_l[32], num_h[32], num_r[32], num_luck[32], num_z[32];
+		if(!effective.empty()) effective.append(1, ',');
+		snprintf(buffer, sizeof(buffer), sJsonApiEffective, int_port(w.iWindowMs / 1000), int_port(e.iShares), int_port(uint64_t(e.fSeconds)),
+			hps_format_json(e.fEffective, num_e, sizeof(num_e)), hps_format_json(e.fLow, num_l, sizeof(num_l)),
+			hps_format_json(e.fHigh, num_h, sizeof(num_h)), hps_format_json(e.fReported, num_r, sizeof(num_r)),
+			perf_format_json(e.fLuck, num_luck, sizeof(num_luck)), perf_format_json(e.fZScore, num_z, sizeof(num_z)));
+		effective.append(buffer);
+	}
+
+	std::string lat_job, lat_share, lat_thds;
+	auto latency_stage = [](std::string& out, const char* sName, xmrstak::latency_hist& oHist)
+	{
+		char num[64];
+		if(!out.empty()) out.append(1, ',');
+		snprintf(num, sizeof(num), sJsonApiLatencyStage, sName);
+		out.append(num);
+		latency_format_json(oHist, out);
+	};
+	latency_stage(lat_job, "to_executor", oJobQueueLag);
+	latency_stage(lat_job, "switched", oJobSwitchLag);
+	latency_stage(lat_job, "all_threads", xmrstak::globalStates::inst().oJobStartLag);
+	latency_stage(lat_share, "to_submit", oShareSendLag);
+	latency_stage(lat_share, "to_reply", oShareReplyLag);
+
+	for(size_t i = 0; i < pvThreads->size(); i++)
+	{
+		if(i != 0) lat_thds.append(1, ',');
+		snprintf(buffer, sizeof(buffer), sJsonApiLatencyThd, (unsigned int)i);
+		lat_thds.append(buffer);
+		latency_format_json(pvThreads->at(i)->oJobLag, lat_thds);
+	}
+
+	size_t bb_size = 2048 + hr_thds.size() + phase_thds.size() + perf_thds.size() + pkg_energy.size() +
+		thermal_cpus.size() + thermal_zones.size() + throttled.size() + effective.size() + res_error.size() + cn_error.size() +
+		lat_job.size() + lat_share.size() + lat_thds.size();
 	std::unique_ptr<char[]> bigbuf( new char[ bb_size ] );
 
 	int bb_len = snprintf(bigbuf.get(), bb_size, sJsonApiFormat,
-		get_version_str().c_str(), hr_thds.c_str(), hr_buffer, a,
+		get_version_str().c_str(), hr_thds.c_str(), hr_buffer, a, phase_thds.c_str(), perf_thds.c_str(),
+		energy_w, energy_hpj, pkg_energy.c_str(),
+		int_port(iSeriesStep / 1000), throttled.c_str(), thermal_cpus.c_str(), thermal_zones.c_str(),
 		int_port(iPoolDiff), int_port(iGoodRes), int_port(iTotalRes), fAvgResTime, int_port(iPoolHashes),
 		int_port(iTopDiff[0]), int_port(iTopDiff[1]), int_port(iTopDiff[2]), int_port(iTopDiff[3]), int_port(iTopDiff[4]),
 		int_port(iTopDiff[5]), int_port(iTopDiff[6]), int_port(iTopDiff[7]), int_port(iTopDiff[8]), int_port(iTopDiff[9]),
-		res_error.c_str(), pool != nullptr ? pool->get_pool_addr() : "not connected", int_port(iConnSec), int_port(iPoolPing), cn_error.c_str());
+		effective.c_str(), res_error.c_str(), pool != nullptr ? pool->get_pool_addr() : "not connected", int_port(iConnSec), int_port(iPoolPing),
+		int_port(iTlsFull), int_port(iTlsResumed), cn_error.c_str(), lat_job.c_str(), lat_share.c_str(), lat_thds.c_str());
 
 	out = std::string(bigbuf.get(), bigbuf.get() + bb_len);
 }
@@ -2,19 +2,27 @@
 
 #include "thdq.hpp"
 #include "telemetry.hpp"
+#include "energy_meter.hpp"
+#include "thermal_monitor.hpp"
+#include "latency_hist.hpp"
+#include "journal.hpp"
+#include "effective_hashrate.hpp"
 #include "xmrstak/backend/iBackend.hpp"
 #include "xmrstak/misc/environment.hpp"
 #include "xmrstak/net/msgstruct.hpp"
+#include "xmrstak/net/share_filter.hpp"
 #include "xmrstak/donate-level.hpp"
 
 #include <atomic>
 #include <array>
 #include <list>
+#include <deque>
 #include <vector>
 #include <future>
 #include <chrono>
 
 class jpsock;
+class daemon_rpc;
 
 namespace xmrstak
 {
@@ -77,15 +85,51 @@ private:
 	thdq<ex_event> oEventQ;
 
 	xmrstak::telemetry* telem;
+	xmrstak::energy_meter* energy;
+
+	struct energy_data
+	{
+		double fWatts;
+		double fHashPerJoule;
+	};
+	// Power of every RAPL package and of all of them, with the CPU hashrate on the package, over 60 seconds
+	void calc_energy_data(std::vector<energy_data>& vPackages, energy_data& oTotal);
+
+	xmrstak::thermal_monitor* thermal;
+	// Hashrate and the clock of the core the thread is pinned to both 10% under the 5 minute level
+	bool is_throttled(size_t iThd, double& fMhz, double& fBaseMhz);
 	std::vector<xmrstak::iBackend*>* pvThreads;
 
 	size_t current_pool_id = invalid_pool_id;
 	size_t last_usr_pool_id = invalid_pool_id;
+	// Last switch the pool scores made, failovers don't hold back the next one
+	size_t score_switch_time = 0;
+
+	// Split mining - the pool each extra work slot mines, invalid_pool_id means it mines with slot 0
+	std::array<size_t, xmrstak::globalStates::iMaxSlots> split_pool_id;
+
+	inline size_t get_slot_target(size_t slot) { return split_pool_id[slot] != invalid_pool_id ? split_pool_id[slot] : current_pool_id; }
+	inline bool is_split_pool(size_t pool_id)
+	{
+		for(size_t id : split_pool_id)
+			if(id == pool_id) return true;
+		return false;
+	}
 	size_t dev_timestamp;
 
 	std::list<jpsock> pools;
 
+	// Pool scoring hysteresis - a pool has to be this much better, and we stay on a pool the scores picked for at least this many seconds
+	constexpr static double fScoreMargin = 0.05;
+	constexpr static size_t iScoreDwellTime = 300;
+
+	bool score_beats(jpsock* cand, jpsock* cur);
+
 	jpsock* pick_pool_by_id(size_t pool_id);
+	bool get_current_job(size_t pool_id, pool_job& oPoolJob);
+
+	// Solo mining work source, nullptr if not configured
+	daemon_rpc* daemon = nullptr;
 
 	executor();
 
@@ -160,6 +204,20 @@ private:
 	};
 	std::vector<result_tally> vMineResults;
 
+	// Shares found while their pool was reconnecting. After the login they are resubmitted
+	// if their job is still the pool's current one, otherwise they count as network errors.
+	struct held_share
+	{
+		size_t pool_id;
+		job_result oResult;
+	};
+	constexpr static size_t iOutboxSize = 64;
+	std::deque<held_share> dShareOutbox;
+	size_t iOutboxResent = 0;
+	size_t iOutboxDropped = 0;
+
+	share_filter oShareFilter;
+
 	//More result statistics
 	std::array<size_t, 10> iTopDiff { { } }; //Initialize to zero
 
@@ -167,10 +225,42 @@ private:
 	size_t iPoolHashes = 0;
 	uint64_t iPoolDiff = 0;
 
+	// Accepted difficulty against the hashes of the threads while they mine for the user pools
+	xmrstak::effective_hashrate oEffective;
+	uint64_t iEffectiveHashes = 0;
+	void effective_tick();
+
+	// Same clock as iBackend::iTimestamp, 0 until a thread hashes
+	uint64_t iFirstHashTime = 0;
+	void check_first_hash();
+
 	// Set it to 16 bit so that we can just let it grow
 	// Maximum realistic growth rate - 5MB / month
 	std::vector<uint16_t> iPoolCallTimes;
 
+	// Job and share paths since the start, the job one goes on in globalStates and the threads
+	xmrstak::latency_hist oJobQueueLag;   // job line received until the executor takes the job
+	xmrstak::latency_hist oJobSwitchLag;  // job line received until switch_work hands it to the threads
+	xmrstak::latency_hist oShareSendLag;  // result found until the submit is sent
+	xmrstak::latency_hist oShareReplyLag; // submit sent until the reply
+
+	inline void trace_lag(xmrstak::latency_hist& oHist, uint64_t iStamp)
+	{
+		if(iStamp == 0)
+			return;
+		oHist.add(since_stamp(iStamp));
+	}
+
+	// Microseconds since a latency stamp, 0 if there is no stamp
+	inline uint64_t since_stamp(uint64_t iStamp)
+	{
+		uint64_t iNow = xmrstak::get_timestamp_us();
+		return iStamp != 0 && iNow > iStamp ? iNow - iStamp : 0;
+	}
+
+	// Empty unless journal_file is set
+	xmrstak::journal oJournal;
+
 	//Those stats are reset if we disconnect
 	inline void reset_stats()
 	{
@@ -183,16 +273,28 @@ private:
 	double fHighestHps = 0.0;
 
 	void log_socket_error(jpsock* pool, std::string&& sError);
+	void log_socket_error(const char* addr, std::string&& sError);
 	void log_result_error(std::string&& sError);
-	void log_result_ok(uint64_t iActualDiff);
+	void log_result_ok(uint64_t iShareDiff, uint64_t iActualDiff);
 
 	void on_sock_ready(size_t pool_id);
 	void on_sock_error(size_t pool_id, std::string&& sError, bool silent);
 	void on_pool_have_job(size_t pool_id, pool_job& oPoolJob);
 	void on_miner_result(size_t pool_id, job_result& oResult);
+	void submit_share(jpsock* pool, job_result& oResult);
+	void hold_share(size_t pool_id, job_result& oResult);
+	void flush_share_outbox(jpsock* pool, const char* sJobID);
+	void on_daemon_job(pool_job& oPoolJob);
+	void on_daemon_result(job_result& oResult);
+	void on_proxy_result(size_t pool_id, proxy_result& oProxyResult);
+	bool use_nicehash(jpsock* pool, pool_job& oPoolJob);
 	void connect_to_pools(std::list<jpsock*>& eval_pools);
 	bool get_live_pools(std::vector<jpsock*>& eval_pools, bool is_dev);
 	void eval_pool_choice();
+	void eval_daemon_choice();
+	void eval_split_pools(std::vector<jpsock*>& eval_pools, bool dev_time);
+	void refresh_split_slots();
+	void push_slot_job(size_t slot, size_t pool_id, pool_job& oPoolJob);
 
 	inline size_t sec_to_ticks(size_t sec) { return sec * (1000 / iTickTime); }
 };
@@ -0,0 +1,226 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "journal.hpp"
+
+#include <errno.h>
+#include <stdio.h>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace xmrstak
+{
+
+const char* journal::get_type_name(uint8_t iType)
+{
+	switch(iType)
+	{
+	case REC_START: return "start";
+	case REC_JOB: return "job";
+	case REC_SHARE: return "share";
+	case REC_POOL_SWITCH: return "pool_switch";
+	case REC_HASHRATE: return "hashrate";
+	default: return "unknown";
+	}
+}
+
+const char* journal::get_verdict_name(uint8_t iVerdict)
+{
+	switch(iVerdict)
+	{
+	case SHARE_ACCEPTED: return "accepted";
+	case SHARE_REJECTED: return "rejected";
+	case SHARE_NOT_SENT: return "not_sent";
+	default: return "";
+	}
+}
+
+bool journal::open(const char* sFile, uint64_t iSize, std::string& err)
+{
+	uint64_t iCap = iSize / sizeof(record) - 1;
+	if(iSize < 2 * sizeof(record))
+	{
+		err = "the size is too small";
+		return false;
+	}
+	iSize = (iCap + 1) * sizeof(record);
+
+	header oHdr = {};
+	memcpy(oHdr.sMagic, get_magic(), sizeof(oHdr.sMagic));
+	oHdr.iVersion = iVersion;
+	oHdr.iRecordSize = sizeof(record);
+	oHdr.iCapacity = iCap;
+
+	void* pMap;
+#ifdef _WIN32
+	HANDLE hFile = CreateFileA(sFile, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(hFile == INVALID_HANDLE_VALUE)
+	{
+		err = "can't open the file, error " + std::to_string(GetLastError());
+		return false;
+	}
+
+	/* Only a journal of another size or layout starts over, cutting it to zero clears the old
+	 * records. Any other file is most likely a typo in journal_file and is left alone.
+	 */
+	header oOld = {};
+	DWORD iRead = 0;
+	LARGE_INTEGER iFileSize;
+	if(!GetFileSizeEx(hFile, &iFileSize))
+	{
+		err = "can't get the file size, error " + std::to_string(GetLastError());
+		CloseHandle(hFile);
+		return false;
+	}
+
+	bool bJournal = ReadFile(hFile, &oOld, sizeof(oOld), &iRead, nullptr) && iRead == sizeof(oOld) &&
+		memcmp(oOld.sMagic, oHdr.sMagic, sizeof(oHdr.sMagic)) == 0;
+	if(iFileSize.QuadPart != 0 && !bJournal)
+	{
+		err = "the file is not a journal, not overwriting it";
+		CloseHandle(hFile);
+		return false;
+	}
+
+	bool bKeep = bJournal && uint64_t(iFileSize.QuadPart) == iSize && memcmp(&oOld, &oHdr, sizeof(oHdr)) == 0;
+
+	if(!bKeep)
+	{
+		LARGE_INTEGER iPos;
+		iPos.QuadPart = 0;
+		SetFilePointerEx(hFile, iPos, nullptr, FILE_BEGIN);
+		SetEndOfFile(hFile);
+		iPos.QuadPart = iSize;
+		if(!SetFilePointerEx(hFile, iPos, nullptr, FILE_BEGIN) || !SetEndOfFile(hFile))
+		{
+			err = "can't resize the file, error " + std::to_string(GetLastError());
+			CloseHandle(hFile);
+			return false;
+		}
+	}
+
+	HANDLE hMap = CreateFileMappingA(hFile, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+	pMap = hMap != nullptr ? MapViewOfFile(hMap, FILE_MAP_WRITE, 0, 0, 0) : nullptr;
+	if(pMap == nullptr)
+		err = "can't map the file, error " + std::to_string(GetLastError());
+
+	// The view keeps the file open
+	if(hMap != nullptr)
+		CloseHandle(hMap);
+	CloseHandle(hFile);
+#else
+	int fd = ::open(sFile, O_RDWR | O_CREAT, 0644);
+	if(fd < 0)
+	{
+		err = std::string("can't open the file, ") + strerror(errno);
+		return false;
+	}
+
+	/* Only a journal of another size or layout starts over, cutting it to zero clears the old
+	 * records. Any other file is most likely a typo in journal_file and is left alone.
+	 */
+	header oOld = {};
+	struct stat st;
+	if(fstat(fd, &st) != 0)
+	{
+		err = std::string("can't get the file size, ") + strerror(errno);
+		close(fd);
+		return false;
+	}
+
+	bool bJournal = pread(fd, &oOld, sizeof(oOld), 0) == sizeof(oOld) && memcmp(oOld.sMagic, oHdr.sMagic, sizeof(oHdr.sMagic)) == 0;
+	if(st.st_size != 0 && !bJournal)
+	{
+		err = "the file is not a journal, not overwriting it";
+		close(fd);
+		return false;
+	}
+
+	bool bKeep = bJournal && uint64_t(st.st_size) == iSize && memcmp(&oOld, &oHdr, sizeof(oHdr)) == 0;
+
+	if(!bKeep && (ftruncate(fd, 0) != 0 || ftruncate(fd, iSize) != 0))
+	{
+		err = std::string("can't resize the file, ") + strerror(errno);
+		close(fd);
+		return false;
+	}
+
+	pMap = mmap(nullptr, iSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(pMap == MAP_FAILED)
+	{
+		pMap = nullptr;
+		err = std::string("can't map the file, ") + strerror(errno);
+	}
+
+	// The mapping keeps the file open
+	close(fd);
+#endif // _WIN32
+
+	if(pMap == nullptr)
+		return false;
+
+	pHeader = (header*)pMap;
+	memcpy(pHeader, &oHdr, sizeof(oHdr));
+	iCapacity = iCap;
+
+	uint64_t iLast = 0;
+	record* pRecs = (record*)pMap + 1;
+	for(uint64_t i = 0; i < iCap; i++)
+	{
+		if(pRecs[i].iSeq > iLast)
+			iLast = pRecs[i].iSeq;
+	}
+	iNext.store(iLast, std::memory_order_relaxed);
+
+	pRecords = pRecs;
+	return true;
+}
+
+void journal::write(record& rec)
+{
+	if(pRecords == nullptr)
+		return;
+
+	using namespace std::chrono;
+	rec.iTime = time_point_cast<milliseconds>(system_clock::now()).time_since_epoch().count();
+
+	uint64_t n = iNext.fetch_add(1, std::memory_order_relaxed);
+	record* pSlot = &pRecords[n % iCapacity];
+
+	// A record cut by a crash keeps the zero sequence number and the reader skips it
+	pSlot->iSeq = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy((char*)pSlot + sizeof(rec.iSeq), (char*)&rec + sizeof(rec.iSeq), sizeof(record) - sizeof(rec.iSeq));
+	std::atomic_thread_fence(std::memory_order_release);
+	pSlot->iSeq = n + 1;
+}
+
+} // namepsace xmrstak
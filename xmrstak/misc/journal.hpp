@@ -0,0 +1,146 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+
+namespace xmrstak
+{
+
+/* Binary journal of shares, jobs, pool switches and hashrate samples in a memory mapped file.
+ *
+ * The file is a header and a fixed number of 64 byte records. Writing a record is a copy into
+ * the mapping, the kernel writes the pages back on its own and they survive a crash of the
+ * miner. Once the file is full the oldest records are overwritten, the sequence number tells
+ * the order. A restart with the same file and size continues after the last record.
+ * The layout is read by the xmr-stak-journal tool, change iVersion with it.
+ */
+class journal
+{
+public:
+	constexpr static uint32_t iVersion = 1;
+
+	enum record_type : uint8_t { REC_START = 1, REC_JOB, REC_SHARE, REC_POOL_SWITCH, REC_HASHRATE };
+	enum share_verdict : uint8_t { SHARE_ACCEPTED = 1, SHARE_REJECTED, SHARE_NOT_SENT };
+
+	struct header
+	{
+		char sMagic[8];
+		uint32_t iVersion;
+		uint32_t iRecordSize;
+		uint64_t iCapacity;
+		uint64_t iReserved[5];
+	};
+
+	/* Pool ids are the executor ones, 0 is the dev pool, 0xFFFE the daemon and 0xFFFF none.
+	 * iValue by type:
+	 *   REC_START       - thread count
+	 *   REC_JOB         - microseconds from the socket to the executor
+	 *   REC_SHARE       - microseconds from the find to the pool reply (0 if unknown)
+	 *   REC_POOL_SWITCH - previous pool id
+	 *   REC_HASHRATE    - 10s average in mH/s, iDiff holds the hash count of the thread
+	 */
+	struct record
+	{
+		// 1 based, 0 for a slot that was never written or is being written
+		uint64_t iSeq;
+		// Milliseconds since the epoch
+		uint64_t iTime;
+		uint8_t iType;
+		uint8_t iVerdict;
+		uint16_t iPool;
+		uint32_t iThread;
+		uint32_t iNonce;
+		uint32_t iReserved;
+		uint64_t iDiff;
+		uint64_t iValue;
+		// Truncated, without the terminating zero if it is 16 bytes long
+		char sJobID[16];
+	};
+
+	static_assert(sizeof(header) == 64, "journal header has to be 64 bytes");
+	static_assert(sizeof(record) == 64, "journal record has to be 64 bytes");
+
+	static const char* get_magic() { return "XMRJRNL"; }
+	static const char* get_type_name(uint8_t iType);
+	static const char* get_verdict_name(uint8_t iVerdict);
+
+	journal() : iNext(0) {}
+
+	// iSize in bytes, false and the reason in err if the file can't be created or mapped
+	bool open(const char* sFile, uint64_t iSize, std::string& err);
+	inline bool is_open() { return pRecords != nullptr; }
+
+	inline void add_start(size_t iThreads)
+	{
+		record rec = {};
+		rec.iType = REC_START;
+		rec.iPool = 0xFFFF;
+		rec.iValue = iThreads;
+		write(rec);
+	}
+
+	inline void add_job(size_t iPool, const char* sJobID, uint64_t iDiff, uint64_t iLagUs)
+	{
+		record rec = {};
+		rec.iType = REC_JOB;
+		rec.iPool = uint16_t(iPool);
+		rec.iDiff = iDiff;
+		rec.iValue = iLagUs;
+		copy_job_id(rec, sJobID);
+		write(rec);
+	}
+
+	inline void add_share(size_t iPool, size_t iThread, const char* sJobID, uint32_t iNonce, uint64_t iDiff,
+		share_verdict verdict, uint64_t iLatencyUs)
+	{
+		record rec = {};
+		rec.iType = REC_SHARE;
+		rec.iVerdict = verdict;
+		rec.iPool = uint16_t(iPool);
+		rec.iThread = uint32_t(iThread);
+		rec.iNonce = iNonce;
+		rec.iDiff = iDiff;
+		rec.iValue = iLatencyUs;
+		copy_job_id(rec, sJobID);
+		write(rec);
+	}
+
+	inline void add_pool_switch(size_t iPool, size_t iPrevPool)
+	{
+		record rec = {};
+		rec.iType = REC_POOL_SWITCH;
+		rec.iPool = uint16_t(iPool);
+		rec.iValue = uint16_t(iPrevPool);
+		write(rec);
+	}
+
+	inline void add_hashrate(size_t iThread, double fHps, uint64_t iHashCount)
+	{
+		record rec = {};
+		rec.iType = REC_HASHRATE;
+		rec.iPool = 0xFFFF;
+		rec.iThread = uint32_t(iThread);
+		rec.iDiff = iHashCount;
+		rec.iValue = fHps > 0.0 ? uint64_t(fHps * 1000.0) : 0;
+		write(rec);
+	}
+
+private:
+	static inline void copy_job_id(record& rec, const char* sJobID)
+	{
+		size_t len = strlen(sJobID);
+		memcpy(rec.sJobID, sJobID, len < sizeof(rec.sJobID) ? len : sizeof(rec.sJobID));
+	}
+
+	// Any thread, no system calls
+	void write(record& rec);
+
+	header* pHeader = nullptr;
+	record* pRecords = nullptr;
+	uint64_t iCapacity = 0;
+	std::atomic<uint64_t> iNext;
+};
+
+} // namepsace xmrstak
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace xmrstak
+{
+
+// Steady clock in microseconds, for the latency stamps only - zero is never a valid stamp
+inline uint64_t get_timestamp_us()
+{
+	using namespace std::chrono;
+	return time_point_cast<microseconds>(steady_clock::now()).time_since_epoch().count();
+}
+
+/* Histogram of latencies in microseconds with power of 2 buckets.
+ *
+ * Bucket 0 counts zero, bucket i the lags from 2^(i-1) to 2^i - 1 and the last bucket
+ * everything from ~4.5 minutes up. Adding is lock free so the mining threads can record
+ * their own lag, reading is approximate while they do. Header only because the backend
+ * plugins record into it too.
+ */
+class latency_hist
+{
+public:
+	constexpr static size_t iBucketCount = 30;
+
+	latency_hist() : iCount(0), iMax(0)
+	{
+		for(std::atomic<uint64_t>& b : iBuckets)
+			b.store(0, std::memory_order_relaxed);
+	}
+
+	inline void add(uint64_t iLagUs)
+	{
+		size_t i = 0;
+		for(uint64_t v = iLagUs; v != 0 && i < iBucketCount - 1; v >>= 1)
+			i++;
+
+		iBuckets[i].fetch_add(1, std::memory_order_relaxed);
+		iCount.fetch_add(1, std::memory_order_relaxed);
+
+		uint64_t iPrev = iMax.load(std::memory_order_relaxed);
+		while(iLagUs > iPrev && !iMax.compare_exchange_weak(iPrev, iLagUs, std::memory_order_relaxed))
+			;
+	}
+
+	inline uint64_t get_count() { return iCount.load(std::memory_order_relaxed); }
+	inline uint64_t get_max() { return iMax.load(std::memory_order_relaxed); }
+	inline uint64_t get_bucket(size_t i) { return iBuckets[i].load(std::memory_order_relaxed); }
+
+	// Lag in microseconds that a fraction fQuantile (0 - 1) of the samples is under, interpolated
+	// inside the bucket and capped at the maximum. Zero if there are no samples.
+	double calc_quantile(double fQuantile)
+	{
+		uint64_t iTotal = 0;
+		uint64_t iCounts[iBucketCount];
+		for(size_t i = 0; i < iBucketCount; i++)
+		{
+			iCounts[i] = iBuckets[i].load(std::memory_order_relaxed);
+			iTotal += iCounts[i];
+		}
+
+		if(iTotal == 0)
+			return 0.0;
+
+		double fMax = double(get_max());
+		double fRank = fQuantile * iTotal;
+		uint64_t iBelow = 0;
+		for(size_t i = 0; i < iBucketCount; i++)
+		{
+			if(iCounts[i] == 0 || iBelow + iCounts[i] < fRank)
+			{
+				iBelow += iCounts[i];
+				continue;
+			}
+
+			if(i == 0)
+				return 0.0;
+
+			double fLow = double(uint64_t(1) << (i - 1));
+			double fHigh = i < iBucketCount - 1 ? double(uint64_t(1) << i) : fMax;
+			double fLag = fLow + (fHigh - fLow) * (fRank - iBelow) / iCounts[i];
+			return fLag < fMax ? fLag : fMax;
+		}
+
+		return fMax;
+	}
+
+private:
+	std::atomic<uint64_t> iBuckets[iBucketCount];
+	std::atomic<uint64_t> iCount;
+	std::atomic<uint64_t> iMax;
+};
+
+} // namepsace xmrstak
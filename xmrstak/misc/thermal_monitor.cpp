@@ -0,0 +1,187 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "thermal_monitor.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+namespace xmrstak
+{
+
+static bool read_file_i64(const std::string& sFile, int64_t& iValue)
+{
+	FILE* f = fopen(sFile.c_str(), "r");
+	if(f == nullptr)
+		return false;
+
+	long long v;
+	bool bOk = fscanf(f, "%lld", &v) == 1;
+	fclose(f);
+	iValue = v;
+	return bOk;
+}
+
+// Entries of sDir named <prefix><number>, sorted by the number
+static std::vector<std::pair<int64_t, std::string>> list_numbered(const char* sDir, const char* sPrefix)
+{
+	std::vector<std::pair<int64_t, std::string>> vOut;
+#ifndef _WIN32
+	DIR* dir = opendir(sDir);
+	if(dir == nullptr)
+		return vOut;
+
+	size_t iLen = strlen(sPrefix);
+	while(dirent* ent = readdir(dir))
+	{
+		const char* name = ent->d_name;
+		if(strncmp(name, sPrefix, iLen) != 0 || name[iLen] < '0' || name[iLen] > '9')
+			continue;
+
+		char* end;
+		long long id = strtoll(name + iLen, &end, 10);
+		if(*end != '\0')
+			continue;
+		vOut.emplace_back(id, std::string(sDir) + "/" + name + "/");
+	}
+	closedir(dir);
+
+	std::sort(vOut.begin(), vOut.end());
+#endif
+	return vOut;
+}
+
+thermal_monitor::thermal_monitor(const char* sCpuDir, const char* sThermalDir) : vTimestamps(iBucketSize, 0)
+{
+	int64_t iValue;
+	for(auto& cpu : list_numbered(sCpuDir, "cpu"))
+	{
+		source src;
+		src.id = cpu.first;
+		src.sFile = cpu.second + "cpufreq/scaling_cur_freq";
+		if(!read_file_i64(src.sFile, iValue))
+			continue;
+		src.vValues.resize(iBucketSize, -1);
+		vCpus.push_back(src);
+	}
+
+	for(auto& zone : list_numbered(sThermalDir, "thermal_zone"))
+	{
+		source src;
+		src.id = zone.first;
+		src.sFile = zone.second + "temp";
+		if(!read_file_i64(src.sFile, iValue))
+			continue;
+
+		char type[64] = "unknown";
+		FILE* f = fopen((zone.second + "type").c_str(), "r");
+		if(f != nullptr)
+		{
+			if(fscanf(f, "%63s", type) != 1)
+				strcpy(type, "unknown");
+			fclose(f);
+		}
+		src.sType = type;
+		src.vValues.resize(iBucketSize, -1);
+		vZones.push_back(src);
+	}
+}
+
+int64_t thermal_monitor::find_cpu(int64_t iCpu)
+{
+	for(size_t i = 0; i < vCpus.size(); i++)
+	{
+		if(vCpus[i].id == iCpu)
+			return i;
+	}
+	return -1;
+}
+
+void thermal_monitor::sample()
+{
+	if(vCpus.empty() && vZones.empty())
+		return;
+
+	using namespace std::chrono;
+	vTimestamps[iBucketTop] = time_point_cast<milliseconds>(steady_clock::now()).time_since_epoch().count();
+
+	for(std::vector<source>* list : { &vCpus, &vZones })
+	{
+		for(source& src : *list)
+		{
+			int64_t iValue;
+			src.vValues[iBucketTop] = read_file_i64(src.sFile, iValue) ? iValue : -1;
+		}
+	}
+
+	iBucketTop = (iBucketTop + 1) & iBucketMask;
+}
+
+double thermal_monitor::calc_avg(const source& src, size_t iLastMilisec, size_t iAgoMilisec)
+{
+	uint64_t iLatest = vTimestamps[(iBucketTop - 1) & iBucketMask];
+	double fSum = 0.0;
+	size_t iCount = 0;
+
+	//Start at 1, buckettop points to next empty
+	for(size_t n = 1; n < iBucketSize; n++)
+	{
+		size_t idx = (iBucketTop - n) & iBucketMask;
+		if(vTimestamps[idx] == 0)
+			break; //That means we don't have the data yet
+
+		uint64_t iAge = iLatest - vTimestamps[idx];
+		if(iAge < iAgoMilisec)
+			continue;
+		if(iAge >= iAgoMilisec + iLastMilisec)
+			break; //We are out of the requested time period
+
+		if(src.vValues[idx] >= 0)
+		{
+			fSum += src.vValues[idx];
+			iCount++;
+		}
+	}
+
+	return iCount != 0 ? fSum / iCount : nan("");
+}
+
+double thermal_monitor::calc_cpu_mhz(size_t i, size_t iLastMilisec, size_t iAgoMilisec)
+{
+	return i < vCpus.size() ? calc_avg(vCpus[i], iLastMilisec, iAgoMilisec) / 1000.0 : nan("");
+}
+
+double thermal_monitor::calc_zone_celsius(size_t i, size_t iLastMilisec, size_t iAgoMilisec)
+{
+	return i < vZones.size() ? calc_avg(vZones[i], iLastMilisec, iAgoMilisec) / 1000.0 : nan("");
+}
+
+} // namepsace xmrstak
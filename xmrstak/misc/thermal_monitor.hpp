@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace xmrstak
+{
+
+/* Clock of every CPU (cpufreq scaling_cur_freq) and the thermal zone temperatures.
+ *
+ * Linux only, elsewhere (and in most VMs) there is nothing to read and the lists stay
+ * empty. The samples of the last ~8 minutes are kept, the calc functions average them
+ * over a time window that ends iAgoMilisec before the last sample, so the API can send
+ * a time series and the reports can compare now with a few minutes ago. One sampling thread.
+ */
+class thermal_monitor
+{
+public:
+	thermal_monitor(const char* sCpuDir = "/sys/devices/system/cpu", const char* sThermalDir = "/sys/class/thermal");
+
+	inline size_t get_cpu_count() { return vCpus.size(); }
+	inline int64_t get_cpu_id(size_t i) { return vCpus[i].id; }
+	// Index of a logical cpu in our list, -1 if we don't read its clock
+	int64_t find_cpu(int64_t iCpu);
+
+	inline size_t get_zone_count() { return vZones.size(); }
+	inline const std::string& get_zone_type(size_t i) { return vZones[i].sType; }
+
+	void sample();
+
+	// NaN if there was no sample in the window
+	double calc_cpu_mhz(size_t i, size_t iLastMilisec, size_t iAgoMilisec = 0);
+	double calc_zone_celsius(size_t i, size_t iLastMilisec, size_t iAgoMilisec = 0);
+
+private:
+	constexpr static size_t iBucketSize = 2 << 9; //Power of 2 to simplify calculations
+	constexpr static size_t iBucketMask = iBucketSize - 1;
+
+	struct source
+	{
+		int64_t id;
+		std::string sType;
+		std::string sFile;
+		// kHz for cpus, milli degree for zones, -1 if the read failed
+		std::vector<int64_t> vValues;
+	};
+
+	double calc_avg(const source& src, size_t iLastMilisec, size_t iAgoMilisec);
+
+	std::vector<source> vCpus;
+	std::vector<source> vZones;
+	std::vector<uint64_t> vTimestamps;
+	size_t iBucketTop = 0;
+};
+
+} // namepsace xmrstak
@@ -0,0 +1,166 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "tracer.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace xmrstak
+{
+
+void tracer::start()
+{
+	auto& env = environment::inst();
+	if(env.pTracer == nullptr)
+		env.pTracer = new tracer;
+}
+
+tracer::tracer()
+{
+	iStartStamp = get_timestamp_us();
+}
+
+tracer::ring* tracer::get_thread_ring()
+{
+	// Every thread gets a ring on the first event. The ring of a thread that ended is handed to
+	// the next new thread, pool threads come and go with the connection.
+	struct ring_owner
+	{
+		tracer* tr = nullptr;
+		ring* pRing = nullptr;
+
+		~ring_owner()
+		{
+			if(pRing == nullptr)
+				return;
+			std::unique_lock<std::mutex> lck(tr->mtx);
+			tr->vFreeRings.push_back(pRing);
+		}
+	};
+	static thread_local ring_owner owner;
+	if(owner.pRing != nullptr)
+		return owner.pRing;
+
+	std::unique_lock<std::mutex> lck(mtx);
+	owner.tr = this;
+	if(!vFreeRings.empty())
+	{
+		owner.pRing = vFreeRings.back();
+		vFreeRings.pop_back();
+	}
+	else
+	{
+		owner.pRing = new ring(vRings.size() + 1);
+		vRings.push_back(owner.pRing);
+	}
+	owner.pRing->sName = "thread " + std::to_string(owner.pRing->iTid);
+	return owner.pRing;
+}
+
+void tracer::record(const char* sName, const char* sCat, char ph, uint64_t iStart, uint64_t iDuration, uint64_t iArg)
+{
+	ring* r = get_thread_ring();
+	uint64_t iHead = r->iHead.load(std::memory_order_relaxed);
+
+	event& ev = r->oEvents[iHead & iRingMask];
+	ev.sName = sName;
+	ev.sCat = sCat;
+	ev.iStart = iStart;
+	ev.iDuration = iDuration;
+	ev.iArg = iArg;
+	ev.ph = ph;
+
+	r->iHead.store(iHead + 1, std::memory_order_release);
+}
+
+void tracer::set_thread_name(const std::string& sName)
+{
+	tracer* tr = inst();
+	if(tr == nullptr)
+		return;
+
+	ring* r = tr->get_thread_ring();
+	std::unique_lock<std::mutex> lck(tr->mtx);
+	r->sName = sName;
+}
+
+void tracer::dump(std::string& out)
+{
+	char buf[512];
+	std::vector<event> vEvents;
+	bool bFirst = true;
+
+	out.reserve(1024 * 1024);
+	out.assign("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	std::unique_lock<std::mutex> lck(mtx);
+	for(ring* r : vRings)
+	{
+		snprintf(buf, sizeof(buf), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			bFirst ? "" : ",", r->iTid, r->sName.c_str());
+		out.append(buf);
+		bFirst = false;
+
+		uint64_t iHead = r->iHead.load(std::memory_order_acquire);
+		uint64_t iFirst = iHead > iRingSize ? iHead - iRingSize : 0;
+		vEvents.clear();
+		for(uint64_t i = iFirst; i < iHead; i++)
+			vEvents.push_back(r->oEvents[i & iRingMask]);
+
+		// The owner thread kept on writing, drop what it may have overwritten while we copied
+		uint64_t iNewHead = r->iHead.load(std::memory_order_acquire);
+		size_t iSkip = 0;
+		if(iNewHead + 1 > iFirst + iRingSize)
+			iSkip = iNewHead + 1 - iRingSize - iFirst;
+
+		for(size_t i = iSkip; i < vEvents.size(); i++)
+		{
+			const event& ev = vEvents[i];
+			uint64_t iTs = ev.iStart > iStartStamp ? ev.iStart - iStartStamp : 0;
+			if(ev.ph == 'X')
+				snprintf(buf, sizeof(buf), ",{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":1,\"tid\":%u,\"args\":{\"arg\":%llu}}",
+					ev.sName, ev.sCat, (unsigned long long)iTs, (unsigned long long)ev.iDuration, r->iTid, (unsigned long long)ev.iArg);
+			else
+				snprintf(buf, sizeof(buf), ",{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":1,\"tid\":%u,\"args\":{\"arg\":%llu}}",
+					ev.sName, ev.sCat, (unsigned long long)iTs, r->iTid, (unsigned long long)ev.iArg);
+			out.append(buf);
+		}
+	}
+	out.append("]}");
+}
+
+bool tracer::dump_file(const char* sFile)
+{
+	std::string out;
+	dump(out);
+
+	FILE* f = fopen(sFile, "wb");
+	if(f == nullptr)
+		return false;
+
+	bool bOk = fwrite(out.data(), 1, out.size(), f) == out.size();
+	return fclose(f) == 0 && bOk;
+}
+
+} // namepsace xmrstak
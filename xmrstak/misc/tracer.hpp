@@ -0,0 +1,116 @@
+#pragma once
+
+#include "environment.hpp"
+#include "latency_hist.hpp"
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace xmrstak
+{
+
+/* Timeline of the executor, network and mining thread events for chrome://tracing and Perfetto.
+ *
+ * Off unless started with --trace. Every thread records into its own ring of the last
+ * iRingSize events without locks, the names have to be string literals. dump() can run at
+ * any time from any thread, events overwritten while it copies a ring are left out.
+ * The instance is shared with the backend plugins through the environment.
+ */
+class tracer
+{
+public:
+	// nullptr if tracing is off
+	static inline tracer* inst()
+	{
+		return environment::inst().pTracer;
+	}
+
+	static void start();
+
+	// ph is the trace event phase, 'X' for complete events with a duration, 'i' for instant ones
+	void record(const char* sName, const char* sCat, char ph, uint64_t iStart, uint64_t iDuration, uint64_t iArg);
+
+	// Thread name shown in the timeline, no-op if tracing is off
+	static void set_thread_name(const std::string& sName);
+
+	// Chrome trace event JSON of all threads
+	void dump(std::string& out);
+	bool dump_file(const char* sFile);
+
+private:
+	tracer();
+
+	constexpr static size_t iRingSize = 2 << 12; //Power of 2 to simplify calculations
+	constexpr static size_t iRingMask = iRingSize - 1;
+
+	struct event
+	{
+		const char* sName;
+		const char* sCat;
+		uint64_t iStart;
+		uint64_t iDuration;
+		uint64_t iArg;
+		char ph;
+	};
+
+	struct ring
+	{
+		uint32_t iTid;
+		std::string sName;
+		// Events written so far, the slot of the next one is iHead & iRingMask
+		std::atomic<uint64_t> iHead;
+		event oEvents[iRingSize];
+
+		ring(uint32_t iTid) : iTid(iTid), iHead(0) {}
+	};
+
+	ring* get_thread_ring();
+
+	std::mutex mtx;
+	std::vector<ring*> vRings;
+	std::vector<ring*> vFreeRings;
+	uint64_t iStartStamp;
+};
+
+// Event of the time between the construction and the end of the scope
+class trace_scope
+{
+public:
+	inline trace_scope(const char* sName, const char* sCat, uint64_t iArg = 0) :
+		tr(tracer::inst()), sName(sName), sCat(sCat), iArg(iArg)
+	{
+		if(tr != nullptr)
+			iStart = get_timestamp_us();
+	}
+
+	inline ~trace_scope()
+	{
+		if(tr != nullptr)
+			tr->record(sName, sCat, 'X', iStart, get_timestamp_us() - iStart, iArg);
+	}
+
+	// The argument can be set once the result is known
+	inline void set_arg(uint64_t iArg) { this->iArg = iArg; }
+
+	trace_scope(trace_scope const&) = delete;
+	trace_scope& operator=(trace_scope const&) = delete;
+
+private:
+	tracer* tr;
+	const char* sName;
+	const char* sCat;
+	uint64_t iArg;
+	uint64_t iStart = 0;
+};
+
+inline void trace_instant(const char* sName, const char* sCat, uint64_t iArg = 0)
+{
+	tracer* tr = tracer::inst();
+	if(tr != nullptr)
+		tr->record(sName, sCat, 'i', get_timestamp_us(), 0, iArg);
+}
+
+} // namepsace xmrstak
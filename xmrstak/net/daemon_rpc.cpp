@@ -0,0 +1,453 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "daemon_rpc.hpp"
+#include "dns_cache.hpp"
+#include "jpsock.hpp"
+
+#include "xmrstak/misc/executor.hpp"
+#include "xmrstak/misc/console.hpp"
+#include "xmrstak/misc/jext.hpp"
+#include "xmrstak/misc/latency_hist.hpp"
+#include "xmrstak/jconf.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+using namespace rapidjson;
+
+// Offset of the nonce in a monero hashing blob, the backends and the pool code assume it
+constexpr static size_t iBlobNonceOffset = 39;
+// A block template with all its transactions can get large, but not this large
+constexpr static size_t iMaxResponseSize = 16 * 1024 * 1024;
+
+daemon_rpc::daemon_rpc(const char* sAddr, const char* sWallet) :
+	net_addr(sAddr), wallet(sWallet), bReady(false), iDifficulty(0), iHeight(0)
+{
+	dns_cache::split_addr(sAddr, host, port);
+}
+
+void daemon_rpc::start()
+{
+	std::thread(&daemon_rpc::poll_thd, this).detach();
+}
+
+bool daemon_rpc::get_current_job(pool_job& job)
+{
+	std::unique_lock<std::mutex> lck(tpl_mutex);
+	if(oCurrentJob.iWorkLen == 0)
+		return false;
+
+	job = oCurrentJob;
+	job.iRecvStamp = 0;
+	return true;
+}
+
+void daemon_rpc::poll_thd()
+{
+	while(true)
+	{
+		std::string sError;
+		bool bOk = poll_template(sError);
+
+		if(!bOk && bReady)
+		{
+			bReady = false;
+			executor::inst()->push_event(ex_event(std::move(sError), false, daemon_pool_id));
+		}
+		else if(!bOk)
+			printer::inst()->print_msg(L2, "Daemon %s: %s", net_addr.c_str(), sError.c_str());
+
+		std::unique_lock<std::mutex> lck(poll_mutex);
+		poll_cond.wait_for(lck, std::chrono::seconds(bOk ? iPollTime : jconf::inst()->GetNetRetry()), [&]{ return bPollNow; });
+		bPollNow = false;
+	}
+}
+
+bool daemon_rpc::poll_template(std::string& sError)
+{
+	std::string sParams = "{\"wallet_address\":\"" + wallet + "\",\"reserve_size\":0}";
+	std::string sResult;
+	if(!call_rpc("get_block_template", sParams, sResult, sError))
+		return false;
+	uint64_t iRecvStamp = xmrstak::get_timestamp_us();
+
+	Document oDoc;
+	if(oDoc.Parse(sResult.c_str()).HasParseError() || !oDoc.IsObject())
+	{
+		sError = "PARSE error: Invalid JSON";
+		return false;
+	}
+
+	const Value* res = GetObjectMember(oDoc, "result");
+	if(res == nullptr || !res->IsObject())
+	{
+		const Value* err = GetObjectMember(oDoc, "error");
+		const Value* msg = err != nullptr && err->IsObject() ? GetObjectMember(*err, "message") : nullptr;
+		sError = msg != nullptr && msg->IsString() ? msg->GetString() : "get_block_template failed";
+		return false;
+	}
+
+	const Value* hblob = GetObjectMember(*res, "blockhashing_blob");
+	const Value* tblob = GetObjectMember(*res, "blocktemplate_blob");
+	const Value* diff = GetObjectMember(*res, "difficulty");
+	const Value* height = GetObjectMember(*res, "height");
+	const Value* prev = GetObjectMember(*res, "prev_hash");
+
+	if(hblob == nullptr || tblob == nullptr || diff == nullptr || height == nullptr || prev == nullptr ||
+		!hblob->IsString() || !tblob->IsString() || !diff->IsUint64() || !height->IsUint64() || !prev->IsString())
+	{
+		sError = "PARSE error: Incomplete block template";
+		return false;
+	}
+
+	if(diff->GetUint64() == 0)
+	{
+		sError = "PARSE error: Invalid difficulty";
+		return false;
+	}
+
+	// An unchanged chain tip only needs new work now and then, to pick up new transactions
+	size_t now = get_timestamp();
+	if(bReady && sPrevHash == prev->GetString() && now - iTemplateTime < iTemplateRefresh)
+		return true;
+
+	size_t iHashLen = hblob->GetStringLength();
+	size_t iTplLen = tblob->GetStringLength();
+	if((iHashLen & 1) != 0 || (iTplLen & 1) != 0 || iHashLen / 2 > sizeof(pool_job::bWorkBlob) || iTplLen == 0)
+	{
+		sError = "PARSE error: Invalid blob size";
+		return false;
+	}
+
+	pool_job oJob;
+	oJob.iWorkLen = iHashLen / 2;
+	oJob.iRecvStamp = iRecvStamp;
+	if(!jpsock::hex2bin(hblob->GetString(), iHashLen, oJob.bWorkBlob))
+	{
+		sError = "PARSE error: Invalid hashing blob";
+		return false;
+	}
+
+	block_template oTpl;
+	oTpl.sBlob.resize(iTplLen / 2);
+	if(!jpsock::hex2bin(tblob->GetString(), iTplLen, (unsigned char*)&oTpl.sBlob.front()))
+	{
+		sError = "PARSE error: Invalid block template blob";
+		return false;
+	}
+
+	// Both blobs start with the same block header, the miners put the nonce in at a fixed place
+	size_t iHashOffset, iTplOffset;
+	if(!get_nonce_offset(oJob.bWorkBlob, oJob.iWorkLen, iHashOffset) || iHashOffset != iBlobNonceOffset ||
+		!get_nonce_offset((const uint8_t*)oTpl.sBlob.data(), oTpl.sBlob.size(), iTplOffset) || iTplOffset != iBlobNonceOffset)
+	{
+		sError = "PARSE error: Unsupported block header";
+		return false;
+	}
+
+	uint64_t iDiff = diff->GetUint64();
+	oTpl.iHeight = height->GetUint64();
+	oTpl.iDifficulty = iDiff;
+	oTpl.iNonceOffset = iTplOffset;
+	memset(oTpl.sJobID, 0, sizeof(oTpl.sJobID));
+	snprintf(oTpl.sJobID, sizeof(oTpl.sJobID), "%llu-%llu", (unsigned long long)oTpl.iHeight, (unsigned long long)iTemplateCnt++);
+
+	memcpy(oJob.sJobID, oTpl.sJobID, sizeof(pool_job::sJobID));
+	oJob.iTarget = jpsock::diff_to_t64(iDiff);
+
+	{
+		std::unique_lock<std::mutex> lck(tpl_mutex);
+		dTemplates.push_front(std::move(oTpl));
+		if(dTemplates.size() > iTemplateHistory)
+			dTemplates.pop_back();
+		oCurrentJob = oJob;
+	}
+
+	sPrevHash = prev->GetString();
+	iTemplateTime = now;
+	iDifficulty = iDiff;
+	iHeight = height->GetUint64();
+
+	executor::inst()->push_event(ex_event(oJob, daemon_pool_id));
+
+	if(!bReady)
+	{
+		bReady = true;
+		executor::inst()->push_event(ex_event(EV_EVAL_POOL_CHOICE));
+	}
+
+	return true;
+}
+
+bool daemon_rpc::submit_block(const job_result& oResult, std::string& sError, uint64_t& iBlockHeight)
+{
+	std::string sBlob;
+	size_t iNonceOffset = 0;
+	uint64_t iDiff = 0;
+	{
+		std::unique_lock<std::mutex> lck(tpl_mutex);
+		for(const block_template& tpl : dTemplates)
+		{
+			if(strncmp(tpl.sJobID, oResult.sJobID, sizeof(block_template::sJobID)) == 0)
+			{
+				sBlob = tpl.sBlob;
+				iNonceOffset = tpl.iNonceOffset;
+				iDiff = tpl.iDifficulty;
+				iBlockHeight = tpl.iHeight;
+				break;
+			}
+		}
+	}
+
+	if(sBlob.empty())
+	{
+		sError = "Block template is too old";
+		return false;
+	}
+
+	// The backends only compared the top 64 bits of the hash
+	if(!check_hash(oResult.bResult, iDiff))
+	{
+		sError.clear();
+		return false;
+	}
+
+	memcpy(&sBlob[iNonceOffset], &oResult.iNonce, sizeof(oResult.iNonce));
+
+	std::string sParams;
+	sParams.resize(sBlob.size() * 2 + 4);
+	sParams[0] = '[';
+	sParams[1] = '"';
+	jpsock::bin2hex((const unsigned char*)sBlob.data(), sBlob.size(), &sParams[2]);
+	sParams[sParams.size() - 2] = '"';
+	sParams[sParams.size() - 1] = ']';
+
+	std::string sResult;
+	bool bOk = call_rpc("submit_block", sParams, sResult, sError);
+
+	if(bOk)
+	{
+		Document oDoc;
+		if(oDoc.Parse(sResult.c_str()).HasParseError() || !oDoc.IsObject())
+		{
+			sError = "PARSE error: Invalid JSON";
+			bOk = false;
+		}
+		else
+		{
+			const Value* err = GetObjectMember(oDoc, "error");
+			if(err != nullptr && err->IsObject())
+			{
+				const Value* msg = GetObjectMember(*err, "message");
+				sError = msg != nullptr && msg->IsString() ? msg->GetString() : "Block not accepted";
+				bOk = false;
+			}
+		}
+	}
+
+	// The chain tip has most likely moved, don't wait for the next poll
+	std::unique_lock<std::mutex> lck(poll_mutex);
+	bPollNow = true;
+	poll_cond.notify_one();
+
+	return bOk;
+}
+
+bool daemon_rpc::call_rpc(const char* sMethod, const std::string& sParams, std::string& sResult, std::string& sError)
+{
+	std::string sBody = "{\"jsonrpc\":\"2.0\",\"id\":\"0\",\"method\":\"";
+	sBody += sMethod;
+	sBody += "\",\"params\":";
+	sBody += sParams;
+	sBody += "}";
+
+	return http_post(sBody, sResult, sError);
+}
+
+bool daemon_rpc::http_post(const std::string& sBody, std::string& sResponse, std::string& sError)
+{
+	char sSockErrText[512];
+	std::vector<dns_cache::addr_entry> vAddrs;
+	if(!dns_cache::inst()->get_addr_list(host, port, vAddrs, sError))
+		return false;
+
+	SOCKET sck = INVALID_SOCKET;
+	for(const dns_cache::addr_entry& addr : vAddrs)
+	{
+		sck = socket(addr.family, addr.socktype, addr.protocol);
+		if(sck == INVALID_SOCKET)
+			continue;
+
+#ifdef _WIN32
+		DWORD timeout = jconf::inst()->GetCallTimeout() * 1000;
+#else
+		timeval timeout = { (time_t)jconf::inst()->GetCallTimeout(), 0 };
+#endif
+		setsockopt(sck, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+		setsockopt(sck, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+
+		if(connect(sck, (const sockaddr*)&addr.addr, addr.addrlen) == 0)
+			break;
+
+		sError = std::string("CONNECT error: ") + sock_strerror(sSockErrText, sizeof(sSockErrText));
+		sock_close(sck);
+		sck = INVALID_SOCKET;
+	}
+
+	if(sck == INVALID_SOCKET)
+	{
+		if(sError.empty())
+			sError = std::string("CONNECT error: ") + sock_strerror(sSockErrText, sizeof(sSockErrText));
+		return false;
+	}
+
+	char sHeader[256];
+	snprintf(sHeader, sizeof(sHeader), "POST /json_rpc HTTP/1.1\r\nHost: %s:%s\r\nContent-Type: application/json\r\n"
+		"Content-Length: %u\r\nConnection: close\r\n\r\n", host.c_str(), port.c_str(), (unsigned)sBody.size());
+
+	std::string sRequest = sHeader;
+	sRequest += sBody;
+
+	size_t pos = 0;
+	while(pos < sRequest.size())
+	{
+		int ret = send(sck, sRequest.data() + pos, sRequest.size() - pos, 0);
+		if(ret <= 0)
+		{
+			sError = std::string("SEND error: ") + sock_strerror(sSockErrText, sizeof(sSockErrText));
+			sock_close(sck);
+			return false;
+		}
+		pos += ret;
+	}
+
+	std::string sData;
+	char buf[4096];
+	size_t iHeaderLen = std::string::npos;
+	size_t iContentLen = std::string::npos;
+	while(true)
+	{
+		int ret = recv(sck, buf, sizeof(buf), 0);
+		if(ret == 0)
+			break;
+
+		if(ret < 0)
+		{
+			sError = std::string("RECEIVE error: ") + sock_strerror(sSockErrText, sizeof(sSockErrText));
+			sock_close(sck);
+			return false;
+		}
+
+		sData.append(buf, ret);
+		if(sData.size() > iMaxResponseSize)
+		{
+			sError = "RECEIVE error: Response too large";
+			sock_close(sck);
+			return false;
+		}
+
+		if(iHeaderLen == std::string::npos && (iHeaderLen = sData.find("\r\n\r\n")) != std::string::npos)
+		{
+			iHeaderLen += 4;
+			const char* sLen = strstr(sData.c_str(), "Content-Length:");
+			if(sLen == nullptr)
+				sLen = strstr(sData.c_str(), "content-length:");
+			if(sLen != nullptr && size_t(sLen - sData.c_str()) < iHeaderLen)
+				iContentLen = strtoull(sLen + 15, nullptr, 10);
+		}
+
+		if(iContentLen != std::string::npos && sData.size() >= iHeaderLen + iContentLen)
+			break;
+	}
+	sock_close(sck);
+
+	if(iHeaderLen == std::string::npos)
+	{
+		sError = "RECEIVE error: Incomplete HTTP response";
+		return false;
+	}
+
+	int iStatus = 0;
+	if(sscanf(sData.c_str(), "HTTP/%*u.%*u %d", &iStatus) != 1 || iStatus != 200)
+	{
+		sError = "HTTP error: " + sData.substr(0, sData.find("\r\n"));
+		return false;
+	}
+
+	if(iContentLen != std::string::npos && sData.size() > iHeaderLen + iContentLen)
+		sData.resize(iHeaderLen + iContentLen);
+
+	sResponse = sData.substr(iHeaderLen);
+	return true;
+}
+
+/* Block header: varint major version, varint minor version, varint timestamp,
+ * 32 bytes previous block id, then the 4 byte nonce
+ */
+bool daemon_rpc::get_nonce_offset(const uint8_t* blob, size_t len, size_t& offset)
+{
+	size_t pos = 0;
+	for(size_t i=0; i < 3; i++)
+	{
+		size_t iVarLen = 0;
+		while(pos < len && iVarLen < 10 && (blob[pos] & 0x80) != 0)
+		{
+			pos++;
+			iVarLen++;
+		}
+
+		if(pos >= len || iVarLen >= 10)
+			return false;
+		pos++;
+	}
+
+	offset = pos + 32;
+	return offset + sizeof(uint32_t) <= len;
+}
+
+// Same as the daemon's check_hash - hash * difficulty has to fit in 256 bits
+bool daemon_rpc::check_hash(const uint8_t* hash, uint64_t difficulty)
+{
+	uint32_t h[8];
+	memcpy(h, hash, sizeof(h));
+
+	const uint32_t d[2] = { uint32_t(difficulty), uint32_t(difficulty >> 32) };
+	uint32_t r[10] = {};
+
+	for(size_t j=0; j < 2; j++)
+	{
+		uint64_t carry = 0;
+		for(size_t i=0; i < 8; i++)
+		{
+			uint64_t t = uint64_t(h[i]) * d[j] + r[i + j] + carry;
+			r[i + j] = uint32_t(t);
+			carry = t >> 32;
+		}
+		r[8 + j] = uint32_t(carry);
+	}
+
+	return r[8] == 0 && r[9] == 0;
+}
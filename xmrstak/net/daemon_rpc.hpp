@@ -0,0 +1,85 @@
+#pragma once
+
+#include "msgstruct.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <string>
+#include <deque>
+
+// Pool id of the daemon work source, it is not in the executor's pool list
+constexpr static size_t daemon_pool_id = (-2);
+
+/* Solo mining work source. The poll thread asks the daemon's JSON-RPC port for a block template
+ * and hands its hashing blob to the executor in a normal EV_POOL_HAVE_JOB event, so the backends
+ * can't tell it apart from pool work. The miners filter results with the top 64 bits of the network
+ * target, the full 256 bit check is done here before the block goes back with submit_block.
+ *
+ * monerod has no long-poll for templates, so we poll and only push work when the previous block
+ * changes, or when the template is old enough that new transactions are worth picking up.
+ */
+class daemon_rpc
+{
+public:
+	daemon_rpc(const char* sAddr, const char* sWallet);
+
+	void start();
+
+	inline const char* get_daemon_addr() { return net_addr.c_str(); }
+	inline bool is_ready() { return bReady; }
+	inline uint64_t get_current_diff() { return iDifficulty; }
+	inline uint64_t get_current_height() { return iHeight; }
+
+	bool get_current_job(pool_job& job);
+
+	// Executor thread. Returns false with an empty error if the hash doesn't beat the network target.
+	bool submit_block(const job_result& oResult, std::string& sError, uint64_t& iBlockHeight);
+
+private:
+	struct block_template
+	{
+		char sJobID[64];
+		uint64_t iHeight;
+		uint64_t iDifficulty;
+		size_t iNonceOffset;
+		std::string sBlob;
+	};
+
+	// Templates are kept for a while, a block found just before the switch is still good
+	static constexpr size_t iTemplateHistory = 4;
+	// Seconds between polls, and after which an unchanged template is refreshed
+	static constexpr size_t iPollTime = 1;
+	static constexpr size_t iTemplateRefresh = 30;
+
+	void poll_thd();
+	bool poll_template(std::string& sError);
+
+	bool call_rpc(const char* sMethod, const std::string& sParams, std::string& sResult, std::string& sError);
+	bool http_post(const std::string& sBody, std::string& sResponse, std::string& sError);
+
+	static bool get_nonce_offset(const uint8_t* blob, size_t len, size_t& offset);
+	static bool check_hash(const uint8_t* hash, uint64_t difficulty);
+
+	std::string net_addr;
+	std::string host;
+	std::string port;
+	std::string wallet;
+
+	std::atomic<bool> bReady;
+	std::atomic<uint64_t> iDifficulty;
+	std::atomic<uint64_t> iHeight;
+
+	std::string sPrevHash;
+	size_t iTemplateTime = 0;
+	size_t iTemplateCnt = 0;
+
+	std::mutex tpl_mutex;
+	std::deque<block_template> dTemplates;
+	pool_job oCurrentJob;
+
+	std::mutex poll_mutex;
+	std::condition_variable poll_cond;
+	bool bPollNow = false;
+};
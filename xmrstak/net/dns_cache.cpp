@@ -0,0 +1,275 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "dns_cache.hpp"
+#include "msgstruct.hpp"
+#include "xmrstak/jconf.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+dns_cache* dns_cache::oInst = nullptr;
+
+// Failed lookups are retried quicker than the cache time
+constexpr static size_t iFailedRetryTime = 5;
+
+dns_cache::dns_cache()
+{
+	oResolverThd = std::thread(&dns_cache::resolver_thd, this);
+	oResolverThd.detach();
+}
+
+bool dns_cache::split_addr(const char* sAddr, std::string& host, std::string& port)
+{
+	const char* sTmp;
+	if((sTmp = strstr(sAddr, "//")) != nullptr)
+		sAddr = sTmp + 2;
+
+	const char* sPort = strchr(sAddr, ':');
+	if(sPort == nullptr)
+		return false;
+
+	host.assign(sAddr, sPort - sAddr);
+	port.assign(sPort + 1);
+	return true;
+}
+
+bool dns_cache::resolve(const std::string& host, const std::string& port, std::vector<addr_entry>& out, std::string& err)
+{
+	addrinfo hints = { 0 };
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	addrinfo *pAddrRoot = nullptr;
+	int ret;
+	if((ret = getaddrinfo(host.c_str(), port.c_str(), &hints, &pAddrRoot)) != 0)
+	{
+		char sSockErrText[512];
+		err.assign("CONNECT error: GetAddrInfo: ");
+		err.append(sock_gai_strerror(ret, sSockErrText, sizeof(sSockErrText)));
+		return false;
+	}
+
+	out.clear();
+	for(addrinfo *ptr = pAddrRoot; ptr != nullptr; ptr = ptr->ai_next)
+	{
+		if(ptr->ai_family != AF_INET && ptr->ai_family != AF_INET6)
+			continue;
+
+		if(ptr->ai_addrlen > sizeof(sockaddr_storage))
+			continue;
+
+		addr_entry e;
+		memset(&e, 0, sizeof(e));
+		e.family = ptr->ai_family;
+		e.socktype = ptr->ai_socktype;
+		e.protocol = ptr->ai_protocol;
+		e.addrlen = (socklen_t)ptr->ai_addrlen;
+		memcpy(&e.addr, ptr->ai_addr, ptr->ai_addrlen);
+		out.push_back(e);
+	}
+
+	freeaddrinfo(pAddrRoot);
+
+	if(out.empty())
+	{
+		err.assign("CONNECT error: I found some DNS records but no IPv4 or IPv6 addresses.");
+		return false;
+	}
+
+	return true;
+}
+
+bool dns_cache::addr_to_str(const addr_entry& addr, std::string& out)
+{
+	char sHost[64];
+	char sPort[16];
+
+	if(getnameinfo((const sockaddr*)&addr.addr, addr.addrlen, sHost, sizeof(sHost), sPort, sizeof(sPort), NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+		return false;
+
+	if(addr.family == AF_INET6)
+		out.assign("[").append(sHost).append("]:").append(sPort);
+	else
+		out.assign(sHost).append(":").append(sPort);
+	return true;
+}
+
+dns_cache::cache_entry* dns_cache::find_entry(const std::string& host, const std::string& port)
+{
+	for(cache_entry& e : lEntries)
+	{
+		if(e.host == host && e.port == port)
+			return &e;
+	}
+	return nullptr;
+}
+
+void dns_cache::prefetch(const char* sAddr)
+{
+	std::string host, port;
+	if(!split_addr(sAddr, host, port))
+		return;
+
+	std::unique_lock<std::mutex> lck(cache_mutex);
+	if(find_entry(host, port) == nullptr)
+	{
+		lEntries.emplace_back();
+		lEntries.back().host = host;
+		lEntries.back().port = port;
+	}
+	lck.unlock();
+	cache_cond.notify_one();
+}
+
+/*
+ * Order the list the same way we used to pick the address - preferred family first,
+ * and a random start inside a family so that round-robin DNS still spreads the load.
+ */
+inline void order_addr_list(std::vector<dns_cache::addr_entry>& addrs)
+{
+	std::vector<dns_cache::addr_entry> ipv4;
+	std::vector<dns_cache::addr_entry> ipv6;
+
+	for(const dns_cache::addr_entry& e : addrs)
+	{
+		if(e.family == AF_INET)
+			ipv4.push_back(e);
+		else
+			ipv6.push_back(e);
+	}
+
+	if(ipv4.size() > 1)
+		std::rotate(ipv4.begin(), ipv4.begin() + (rand() % ipv4.size()), ipv4.end());
+	if(ipv6.size() > 1)
+		std::rotate(ipv6.begin(), ipv6.begin() + (rand() % ipv6.size()), ipv6.end());
+
+	std::vector<dns_cache::addr_entry>& first = jconf::inst()->PreferIpv4() ? ipv4 : ipv6;
+	std::vector<dns_cache::addr_entry>& second = jconf::inst()->PreferIpv4() ? ipv6 : ipv4;
+
+	addrs.clear();
+	addrs.insert(addrs.end(), first.begin(), first.end());
+	addrs.insert(addrs.end(), second.begin(), second.end());
+}
+
+bool dns_cache::get_addr_list(const std::string& host, const std::string& port, std::vector<addr_entry>& out, std::string& err)
+{
+	std::unique_lock<std::mutex> lck(cache_mutex);
+	cache_entry* e = find_entry(host, port);
+
+	if(e != nullptr && !e->addrs.empty())
+	{
+		out = e->addrs;
+		if(get_timestamp() - e->resolve_time >= jconf::inst()->GetDnsCacheTime())
+			cache_cond.notify_one();
+		lck.unlock();
+
+		order_addr_list(out);
+		return true;
+	}
+	lck.unlock();
+
+	// Cold miss, we are on a socket thread so it is fine to wait here
+	std::vector<addr_entry> addrs;
+	bool ret = resolve(host, port, addrs, err);
+
+	lck.lock();
+	if((e = find_entry(host, port)) == nullptr)
+	{
+		lEntries.emplace_back();
+		e = &lEntries.back();
+		e->host = host;
+		e->port = port;
+	}
+
+	if(!e->resolving)
+	{
+		e->resolve_time = get_timestamp();
+		if(ret)
+		{
+			e->addrs = addrs;
+			e->error.clear();
+		}
+		else
+			e->error = err;
+	}
+	lck.unlock();
+
+	if(!ret)
+		return false;
+
+	out = std::move(addrs);
+	order_addr_list(out);
+	return true;
+}
+
+void dns_cache::resolver_thd()
+{
+	std::unique_lock<std::mutex> lck(cache_mutex);
+	while(true)
+	{
+		cache_cond.wait_for(lck, std::chrono::seconds(1));
+
+		size_t cache_time = jconf::inst()->GetDnsCacheTime();
+		bool again = true;
+		while(again)
+		{
+			again = false;
+			for(cache_entry& e : lEntries)
+			{
+				if(e.resolving)
+					continue;
+
+				size_t age = get_timestamp() - e.resolve_time;
+				if(e.resolve_time != 0 && age < (e.addrs.empty() ? iFailedRetryTime : cache_time))
+					continue;
+
+				std::string host = e.host;
+				std::string port = e.port;
+				e.resolving = true;
+				lck.unlock();
+
+				std::vector<addr_entry> addrs;
+				std::string err;
+				bool ret = resolve(host, port, addrs, err);
+
+				lck.lock();
+				e.resolving = false;
+				e.resolve_time = get_timestamp();
+				if(ret)
+				{
+					e.addrs = std::move(addrs);
+					e.error.clear();
+				}
+				else // Keep serving the old list, if we have one
+					e.error = std::move(err);
+
+				// The list might have changed while we were unlocked
+				again = true;
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "socks.hpp"
+
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <string>
+#include <vector>
+#include <list>
+
+/* getaddrinfo is synchronous and a slow resolver can stall it for many seconds.
+ * The cache resolves pool hostnames on its own thread, ahead of time, and hands
+ * out the address list to the socket recv threads. The executor never waits on it.
+ *
+ * getaddrinfo does not give us the record TTL, so entries are refreshed in
+ * the background after dns_cache_time seconds. A stale entry is still served
+ * while the refresh is in flight.
+ */
+class dns_cache
+{
+public:
+	static dns_cache* inst()
+	{
+		if (oInst == nullptr) oInst = new dns_cache;
+		return oInst;
+	};
+
+	struct addr_entry
+	{
+		int family;
+		int socktype;
+		int protocol;
+		sockaddr_storage addr;
+		socklen_t addrlen;
+	};
+
+	// Splits "[proto://]host:port" - returns false if the port is missing
+	static bool split_addr(const char* sAddr, std::string& host, std::string& port);
+
+	// Queue a background lookup, never blocks
+	void prefetch(const char* sAddr);
+
+	// Returns the cached list, ordered by preference. On a cold miss this resolves on the
+	// calling thread, so it must only be called from a socket thread.
+	bool get_addr_list(const std::string& host, const std::string& port, std::vector<addr_entry>& out, std::string& err);
+
+	// Numeric "ip:port" or "[ip6]:port" form of an address
+	static bool addr_to_str(const addr_entry& addr, std::string& out);
+
+private:
+	dns_cache();
+	static dns_cache* oInst;
+
+	struct cache_entry
+	{
+		std::string host;
+		std::string port;
+		std::vector<addr_entry> addrs;
+		std::string error;
+		size_t resolve_time = 0;
+		bool resolving = false;
+	};
+
+	static bool resolve(const std::string& host, const std::string& port, std::vector<addr_entry>& out, std::string& err);
+
+	cache_entry* find_entry(const std::string& host, const std::string& port);
+	void resolver_thd();
+
+	std::list<cache_entry> lEntries;
+	std::mutex cache_mutex;
+	std::condition_variable cache_cond;
+	std::thread oResolverThd;
+};
@@ -24,14 +24,21 @@
 #include <stdarg.h>
 #include <assert.h>
 #include <algorithm>
+#include <cmath>
 
 #include "jpsock.hpp"
 #include "socks.hpp"
 #include "socket.hpp"
 
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
 #include "xmrstak/misc/executor.hpp"
 #include "xmrstak/jconf.hpp"
 #include "xmrstak/misc/jext.hpp"
+#include "xmrstak/misc/latency_hist.hpp"
+#include "xmrstak/misc/tracer.hpp"
 #include "xmrstak/version.hpp"
 
 using namespace rapidjson;
@@ -93,8 +100,8 @@ struct jpsock::opq_json_val
 };
 
 jpsock::jpsock(size_t id, const char* sAddr, const char* sLogin, const char* sPassword, double pool_weight, bool dev_pool, bool tls, const char* tls_fp, bool nicehash) :
-	net_addr(sAddr), usr_login(sLogin), usr_pass(sPassword), tls_fp(tls_fp), pool_id(id), pool_weight(pool_weight), pool(dev_pool), nicehash(nicehash),
-	connect_time(0), connect_attempts(0), disconnect_time(0), quiet_close(false)
+	net_addr(sAddr), usr_login(sLogin), usr_pass(sPassword), tls_fp(tls_fp), pool_id(id), pool_weight(pool_weight), pool(dev_pool), nicehash(nicehash), use_tls(tls), score_mode(!dev_pool && jconf::inst()->PoolScoring()),
+	connect_time(0), connect_attempts(0), disconnect_time(0), tls_full_cnt(0), tls_resumed_cnt(0), bTlsResumed(false), quiet_close(false)
 {
 	sock_init();
 
@@ -186,9 +193,115 @@ bool jpsock::set_socket_error_strerr(const char* a, int res)
 	return set_socket_error(a, sock_gai_strerror(res, sSockErrText, sizeof(sSockErrText)));
 }
 
+void jpsock::set_tls_handshake(bool resumed)
+{
+	bTlsResumed = resumed;
+	if(resumed)
+		tls_resumed_cnt++;
+	else
+		tls_full_cnt++;
+}
+
+inline size_t get_timestamp_ms()
+{
+	using namespace std::chrono;
+	return time_point_cast<milliseconds>(steady_clock::now()).time_since_epoch().count();
+}
+
+// Weight of a new sample in the moving averages below
+constexpr double fStatsAlpha = 0.1;
+// Number of shares after which the measured score fully replaces the config weight
+constexpr double fScoreWarmup = 20.0;
+// Disconnects are forgotten after an hour
+constexpr size_t iDisconnectWindow = 3600;
+
+void jpsock::record_submit(bool accepted, size_t rtt_ms, uint64_t diff)
+{
+	std::unique_lock<std::mutex> lck(stats_mutex);
+	if(accepted)
+	{
+		iSubmitAccepted++;
+		fDiffAccepted += double(diff);
+	}
+	else
+	{
+		iSubmitRejected++;
+		fDiffRejected += double(diff);
+	}
+
+	if(iSubmitAccepted + iSubmitRejected == 1)
+		fRttEwma = double(rtt_ms);
+	else
+		fRttEwma += fStatsAlpha * (double(rtt_ms) - fRttEwma);
+}
+
+void jpsock::record_job_arrival()
+{
+	size_t now = get_timestamp_ms();
+	std::unique_lock<std::mutex> lck(stats_mutex);
+
+	if(iLastJobTime != 0)
+	{
+		double interval = double(now - iLastJobTime);
+		if(iJobSamples == 0)
+			fJobIntervalEwma = interval;
+		else
+		{
+			fJobJitterEwma += fStatsAlpha * (std::abs(interval - fJobIntervalEwma) - fJobJitterEwma);
+			fJobIntervalEwma += fStatsAlpha * (interval - fJobIntervalEwma);
+		}
+		iJobSamples++;
+	}
+	iLastJobTime = now;
+}
+
+void jpsock::record_disconnect()
+{
+	std::unique_lock<std::mutex> lck(stats_mutex);
+	vDisconnects.push_back(get_timestamp());
+}
+
+/*
+ * The score estimates the accepted difficulty per second relative to our own hashrate,
+ * scaled to the same 0 - 9.8 range as the normalised config weights. Every pool sees the
+ * same hashrate, so the raw difficulty per second would only add share luck:
+ *  - share acceptance weighted by the share difficulty, a rejected share costs the hashes
+ *    it took (with a 98% prior so that one early reject doesn't sink a pool)
+ *  - work lost to stale jobs, estimated as the submit RTT over the average job interval.
+ *    Job arrival jitter is mostly block luck and the same for every pool, so it only gets
+ *    a small weight.
+ *  - each disconnect in the last hour costs a quarter of the score
+ * Until we have a few shares the config weight dominates.
+ */
+double jpsock::get_pool_score()
+{
+	std::unique_lock<std::mutex> lck(stats_mutex);
+
+	size_t now = get_timestamp();
+	vDisconnects.erase(std::remove_if(vDisconnects.begin(), vDisconnects.end(),
+		[now](size_t t) { return now - t > iDisconnectWindow; }), vDisconnects.end());
+
+	double shares = double(iSubmitAccepted + iSubmitRejected);
+	double diff = fDiffAccepted + fDiffRejected;
+	double prior = fScoreWarmup * (shares > 0.0 && diff > 0.0 ? diff / shares : 1.0);
+	double accept = (fDiffAccepted + 0.98 * prior) / (diff + prior);
+
+	double stale = 0.0;
+	if(iJobSamples >= 2 && fJobIntervalEwma > 0.0)
+		stale = std::min(0.5, (fRttEwma + 0.1 * fJobJitterEwma) / fJobIntervalEwma);
+
+	double measured = 9.8 * accept * (1.0 - stale);
+	double blend = shares / (shares + fScoreWarmup);
+	double score = (1.0 - blend) * pool_weight + blend * measured;
+
+	return score / (1.0 + 0.25 * vDisconnects.size());
+}
+
 void jpsock::jpsock_thread()
 {
+	xmrstak::tracer::set_thread_name("pool " + std::to_string(pool_id));
 	jpsock_thd_main();
+	xmrstak::trace_instant(bHaveSocketError ? "socket_error" : "socket_closed", "net", pool_id);
 	executor::inst()->push_event(ex_event(std::move(sSocketError), quiet_close, pool_id));
 
 	// If a call is wating, send an error to end it
@@ -209,7 +322,10 @@ void jpsock::jpsock_thread()
 	bLoggedIn = false;
 
 	if(bHaveSocketError && !quiet_close)
+	{
 		disconnect_time = get_timestamp();
+		record_disconnect();
+	}
 	else
 		disconnect_time = 0;
 
@@ -220,53 +336,77 @@ void jpsock::jpsock_thread()
 
 bool jpsock::jpsock_thd_main()
 {
-	if(!sck->connect())
-		return false;
+	{
+		// Address lookup can block, so it is done here and not on the executor thread
+		xmrstak::trace_scope oTrace("connect", "net", pool_id);
+		if(!sck->set_hostname(net_addr.c_str()))
+			return false;
+
+		if(!sck->connect())
+			return false;
+	}
 
 	executor::inst()->push_event(ex_event(EV_SOCK_READY, pool_id));
 
-	char buf[iSockBufferSize];
-	size_t datalen = 0;
+	/* Lines are parsed in place, between lnstart and datalen. Leftover data is only moved
+	 * to the front once the tail of the buffer is used up, and the buffer only grows if a
+	 * single line doesn't fit. Searching for '\n' resumes where the last recv ended.
+	 */
+	std::vector<char> buf(iSockBufferSize);
+	size_t lnstart = 0, scanpos = 0, datalen = 0;
 	while (true)
 	{
-		int ret = sck->recv(buf + datalen, sizeof(buf) - datalen);
+		if (datalen == buf.size())
+		{
+			if (lnstart > 0)
+			{
+				memmove(buf.data(), buf.data() + lnstart, datalen - lnstart);
+				datalen -= lnstart;
+				scanpos -= lnstart;
+				lnstart = 0;
+			}
+			else if (buf.size() < iSockBufferMax)
+				buf.resize(buf.size() * 2);
+			else
+			{
+				sck->close(false);
+				return set_socket_error("RECEIVE error: data overflow");
+			}
+		}
+
+		int ret = sck->recv(buf.data() + datalen, buf.size() - datalen);
 
 		if(ret <= 0)
 			return false;
 
 		datalen += ret;
 
-		if (datalen >= sizeof(buf))
-		{
-			sck->close(false);
-			return set_socket_error("RECEIVE error: data overflow");
-		}
-
 		char* lnend;
-		char* lnstart = buf;
-		while ((lnend = (char*)memchr(lnstart, '\n', datalen)) != nullptr)
+		while ((lnend = (char*)memchr(buf.data() + scanpos, '\n', datalen - scanpos)) != nullptr)
 		{
 			lnend++;
-			int lnlen = lnend - lnstart;
+			size_t lnlen = lnend - (buf.data() + lnstart);
 
-			if (!process_line(lnstart, lnlen))
+			if (!process_line(buf.data() + lnstart, lnlen))
 			{
 				sck->close(false);
 				return false;
 			}
 
-			datalen -= lnlen;
-			lnstart = lnend;
+			lnstart += lnlen;
+			scanpos = lnstart;
 		}
 
-		//Got leftover data? Move it to the front
-		if (datalen > 0 && buf != lnstart)
-			memmove(buf, lnstart, datalen);
+		if (lnstart == datalen)
+			lnstart = datalen = 0;
+		scanpos = datalen;
 	}
 }
 
 bool jpsock::process_line(char* line, size_t len)
 {
+	uint64_t iRecvStamp = xmrstak::get_timestamp_us();
+
 	prv->jsonDoc.SetNull();
 	prv->parseAllocator.Clear();
 	prv->callAllocator.Clear();
@@ -298,7 +438,7 @@ bool jpsock::process_line(char* line, size_t len)
 			return set_socket_error("PARSE error: Protocol error 2");
 
 		opq_json_val v(mt);
-		return process_pool_job(&v);
+		return process_pool_job(&v, iRecvStamp);
 	}
 	else
 	{
@@ -343,6 +483,7 @@ bool jpsock::process_line(char* line, size_t len)
 
 		prv->oCallRsp.bHaveResponse = true;
 		prv->oCallRsp.iCallId = iCallId;
+		xmrstak::trace_instant("call_reply", "net", pool_id);
 
 		if(sError != nullptr)
 		{
@@ -359,7 +500,7 @@ bool jpsock::process_line(char* line, size_t len)
 	}
 }
 
-bool jpsock::process_pool_job(const opq_json_val* params)
+bool jpsock::process_pool_job(const opq_json_val* params, uint64_t iRecvStamp)
 {
 	if (!params->val->IsObject())
 		return set_socket_error("PARSE error: Job error 1");
@@ -388,6 +529,7 @@ bool jpsock::process_pool_job(const opq_json_val* params)
 		return set_socket_error("PARSE error: Job error 4");
 
 	oPoolJob.iWorkLen = iWorkLn;
+	oPoolJob.iRecvStamp = iRecvStamp;
 	memset(oPoolJob.sJobID, 0, sizeof(pool_job::sJobID));
 	memcpy(oPoolJob.sJobID, jobid->GetString(), jobid->GetStringLength()); //Bounds checking at proto error 3
 
@@ -428,6 +570,8 @@ bool jpsock::process_pool_job(const opq_json_val* params)
 	}
 
 	iJobDiff = t64_to_diff(oPoolJob.iTarget);
+	record_job_arrival();
+	xmrstak::trace_instant("job_received", "net", pool_id);
 
 	executor::inst()->push_event(ex_event(oPoolJob, pool_id));
 
@@ -440,22 +584,17 @@ bool jpsock::connect(std::string& sConnectError)
 {
 	ext_algo = ext_backend = ext_hashcount = ext_motd = false;
 	bHaveSocketError = false;
+	bTlsResumed = false;
 	sSocketError.clear();
+	iLastJobTime = 0;
 	iJobDiff = 0;
 	connect_attempts++;
 	connect_time = get_timestamp();
 
-	if(sck->set_hostname(net_addr.c_str()))
-	{
-		bRunning = true;
-		disconnect_time = 0;
-		oRecvThd = new std::thread(&jpsock::jpsock_thread, this);
-		return true;
-	}
-
-	disconnect_time = get_timestamp();
-	sConnectError = std::move(sSocketError);
-	return false;
+	bRunning = true;
+	disconnect_time = 0;
+	oRecvThd = new std::thread(&jpsock::jpsock_thread, this);
+	return true;
 }
 
 void jpsock::disconnect(bool quiet)
@@ -583,8 +722,9 @@ bool jpsock::cmd_login()
 		}
 	}
 
+	// The login reply was parsed by the receive thread a moment ago, close enough for the job lag
 	opq_json_val v(job);
-	if(!process_pool_job(&v))
+	if(!process_pool_job(&v, xmrstak::get_timestamp_us()))
 	{
 		disconnect();
 		return false;
@@ -606,10 +746,11 @@ bool jpsock::cmd_submit(const char* sJobId, uint32_t iNonce, const uint8_t* bRes
 	char sBackend[64] = {0};
 	char sHashcount[64] = {0};
 
-	if(ext_backend)
+	// Shares forwarded for proxy clients don't have a local backend
+	if(ext_backend && bend != nullptr)
 		snprintf(sBackend, sizeof(sBackend), ",\"backend\":\"%s\"", xmrstak::iBackend::getName(bend->backendType));
 
-	if(ext_hashcount)
+	if(ext_hashcount && bend != nullptr)
 		snprintf(sHashcount, sizeof(sHashcount), ",\"hashcount\":%llu", int_port(bend->iHashCount.load(std::memory_order_relaxed)));
 
 	if(ext_algo)
@@ -642,6 +783,8 @@ bool jpsock::get_current_job(pool_job& job)
 		return false;
 
 	job = oCurrentJob;
+	// A job we push again is not traced, its lag would be the time since it came
+	job.iRecvStamp = 0;
 	return true;
 }
 
@@ -660,6 +803,25 @@ bool jpsock::get_pool_motd(std::string& strin)
 	return false;
 }
 
+#if defined(__SSSE3__)
+/* 16 bytes at a time. Every char is checked to be a hex digit, upper or lower case,
+ * then the nibble values are made with masks and pairs are merged by maddubs.
+ */
+inline __m128i hf_hex2bin_sse(__m128i c, int& valid)
+{
+	const __m128i lc = _mm_or_si128(c, _mm_set1_epi8(0x20));
+	const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+	const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lc, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lc, _mm_set1_epi8('f' + 1)));
+	valid &= _mm_movemask_epi8(_mm_or_si128(digit, alpha));
+
+	const __m128i val = _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+		_mm_and_si128(alpha, _mm_sub_epi8(lc, _mm_set1_epi8('a' - 10))));
+
+	// High nibble * 16 + low nibble, one 16 bit word per output byte
+	return _mm_maddubs_epi16(val, _mm_set1_epi16(0x0110));
+}
+#endif
+
 inline unsigned char hf_hex2bin(char c, bool &err)
 {
 	if (c >= '0' && c <= '9')
@@ -675,8 +837,22 @@ inline unsigned char hf_hex2bin(char c, bool &err)
 
 bool jpsock::hex2bin(const char* in, unsigned int len, unsigned char* out)
 {
+	unsigned int i = 0;
+#if defined(__SSSE3__)
+	int valid = 0xFFFF;
+	for (; i + 32 <= len; i += 32)
+	{
+		__m128i a = hf_hex2bin_sse(_mm_loadu_si128((const __m128i*)(in + i)), valid);
+		__m128i b = hf_hex2bin_sse(_mm_loadu_si128((const __m128i*)(in + i + 16)), valid);
+		_mm_storeu_si128((__m128i*)(out + i / 2), _mm_packus_epi16(a, b));
+	}
+
+	if (valid != 0xFFFF)
+		return false;
+#endif
+
 	bool error = false;
-	for (unsigned int i = 0; i < len; i += 2)
+	for (; i < len; i += 2)
 	{
 		out[i / 2] = (hf_hex2bin(in[i], error) << 4) | hf_hex2bin(in[i + 1], error);
 		if (error) return false;
@@ -694,7 +870,21 @@ inline char hf_bin2hex(unsigned char c)
 
 void jpsock::bin2hex(const unsigned char* in, unsigned int len, char* out)
 {
-	for (unsigned int i = 0; i < len; i++)
+	unsigned int i = 0;
+#if defined(__SSSE3__)
+	const __m128i lut = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+		__m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+		__m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+		_mm_storeu_si128((__m128i*)(out + i * 2), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i*)(out + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+#endif
+
+	for (; i < len; i++)
 	{
 		out[i * 2] = hf_bin2hex((in[i] & 0xF0) >> 4);
 		out[i * 2 + 1] = hf_bin2hex(in[i] & 0x0F);
@@ -8,6 +8,7 @@
 #include <condition_variable>
 #include <thread>
 #include <string>
+#include <vector>
 
 
 /* Our pool can have two kinds of errors:
@@ -41,7 +42,7 @@ public:
 
 	inline double get_pool_weight(bool gross_weight) 
 	{ 
-		double ret = pool_weight; 
+		double ret = score_mode ? get_pool_score() : pool_weight; 
 		if(gross_weight && bRunning)
 			ret += 10.0;
 		if(gross_weight && bLoggedIn)
@@ -58,9 +59,19 @@ public:
 	inline const char* get_pool_addr() { return net_addr.c_str(); }
 	inline const char* get_tls_fp() { return tls_fp.c_str(); }
 	inline bool is_nicehash() { return nicehash; }
+	inline bool is_tls() { return use_tls; }
+
+	// Called by the TLS socket once the handshake is verified
+	void set_tls_handshake(bool resumed);
+	inline bool is_tls_resumed() { return bTlsResumed; }
+	inline void get_tls_handshakes(size_t& full, size_t& resumed) { full = tls_full_cnt; resumed = tls_resumed_cnt; }
 
 	bool get_pool_motd(std::string& strin);
 
+	// Measured pool quality, used instead of the config weight if pool_scoring is set
+	void record_submit(bool accepted, size_t rtt_ms, uint64_t diff);
+	double get_pool_score();
+
 	std::string&& get_call_error();
 	bool have_sock_error() { return bHaveSocketError; }
 
@@ -89,6 +100,8 @@ private:
 	double pool_weight;
 	bool pool;
 	bool nicehash;
+	bool use_tls;
+	bool score_mode;
 
 	bool ext_algo = false;
 	bool ext_backend = false;
@@ -102,6 +115,26 @@ private:
 	std::atomic<size_t> connect_attempts;
 	std::atomic<size_t> disconnect_time;
 
+	std::atomic<size_t> tls_full_cnt;
+	std::atomic<size_t> tls_resumed_cnt;
+	std::atomic<bool> bTlsResumed;
+
+	// Pool statistics for the scoring mode, times in ms
+	std::mutex stats_mutex;
+	size_t iSubmitAccepted = 0;
+	size_t iSubmitRejected = 0;
+	double fDiffAccepted = 0.0;
+	double fDiffRejected = 0.0;
+	double fRttEwma = 0.0;
+	size_t iLastJobTime = 0;
+	size_t iJobSamples = 0;
+	double fJobIntervalEwma = 0.0;
+	double fJobJitterEwma = 0.0;
+	std::vector<size_t> vDisconnects;
+
+	void record_job_arrival();
+	void record_disconnect();
+
 	std::atomic<bool> bRunning;
 	std::atomic<bool> bLoggedIn;
 	std::atomic<bool> quiet_close;
@@ -111,7 +144,9 @@ private:
 	uint8_t* bJsonCallMem;
 
 	static constexpr size_t iJsonMemSize = 4096;
+	// The receive buffer starts small and doubles for long lines (big motd, big blobs)
 	static constexpr size_t iSockBufferSize = 4096;
+	static constexpr size_t iSockBufferMax = 1024 * 1024;
 
 	struct call_rsp;
 	struct opaque_private;
@@ -120,7 +155,7 @@ private:
 	void jpsock_thread();
 	bool jpsock_thd_main();
 	bool process_line(char* line, size_t len);
-	bool process_pool_job(const opq_json_val* params);
+	bool process_pool_job(const opq_json_val* params, uint64_t iRecvStamp);
 	bool cmd_ret_wait(const char* sPacket, opq_json_val& poResult);
 
 	char sMinerId[64];
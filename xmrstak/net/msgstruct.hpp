@@ -14,10 +14,12 @@ struct pool_job
 	uint64_t	iTarget;
 	uint32_t	iWorkLen;
 	uint32_t	iSavedNonce;
+	// get_timestamp_us() when the job line arrived, zero if the job is not fresh from the pool
+	uint64_t	iRecvStamp;
 
-	pool_job() : iWorkLen(0), iSavedNonce(0) {}
+	pool_job() : iWorkLen(0), iSavedNonce(0), iRecvStamp(0) {}
 	pool_job(const char* sJobID, uint64_t iTarget, const uint8_t* bWorkBlob, uint32_t iWorkLen) :
-		iTarget(iTarget), iWorkLen(iWorkLen), iSavedNonce(0)
+		iTarget(iTarget), iWorkLen(iWorkLen), iSavedNonce(0), iRecvStamp(0)
 	{
 		assert(iWorkLen <= sizeof(pool_job::bWorkBlob));
 		memcpy(this->sJobID, sJobID, sizeof(pool_job::sJobID));
@@ -31,9 +33,11 @@ struct job_result
 	char		sJobID[64];
 	uint32_t	iNonce;
 	uint32_t	iThreadId;
+	// get_timestamp_us() when the backend found the result, zero if unknown
+	uint64_t	iFoundStamp;
 
-	job_result() {}
-	job_result(const char* sJobID, uint32_t iNonce, const uint8_t* bResult, uint32_t iThreadId) : iNonce(iNonce), iThreadId(iThreadId)
+	job_result() : iFoundStamp(0) {}
+	job_result(const char* sJobID, uint32_t iNonce, const uint8_t* bResult, uint32_t iThreadId) : iNonce(iNonce), iThreadId(iThreadId), iFoundStamp(0)
 	{
 		memcpy(this->sJobID, sJobID, sizeof(job_result::sJobID));
 		memcpy(this->bResult, bResult, sizeof(job_result::bResult));
@@ -63,6 +67,17 @@ struct sock_err
 	sock_err& operator=(sock_err const&) = delete;
 };
 
+// A share from a proxy client, sJobID is the upstream job id
+struct proxy_result
+{
+	job_result oResult;
+	size_t iClientId;
+	uint64_t iCallId;
+
+	proxy_result() {}
+	proxy_result(const job_result& res, size_t iClientId, uint64_t iCallId) : oResult(res), iClientId(iClientId), iCallId(iCallId) {}
+};
+
 // Unlike socket errors, GPU errors are read-only strings
 struct gpu_res_err
 {
@@ -73,7 +88,7 @@ struct gpu_res_err
 enum ex_event_name { EV_INVALID_VAL, EV_SOCK_READY, EV_SOCK_ERROR, EV_GPU_RES_ERROR,
 	EV_POOL_HAVE_JOB, EV_MINER_HAVE_RESULT, EV_PERF_TICK, EV_EVAL_POOL_CHOICE, 
 	EV_USR_HASHRATE, EV_USR_RESULTS, EV_USR_CONNSTAT, EV_HASHRATE_LOOP, 
-	EV_HTML_HASHRATE, EV_HTML_RESULTS, EV_HTML_CONNSTAT, EV_HTML_JSON };
+	EV_HTML_HASHRATE, EV_HTML_RESULTS, EV_HTML_CONNSTAT, EV_HTML_JSON, EV_PROXY_RESULT };
 
 /*
    This is how I learned to stop worrying and love c++11 =).
@@ -96,6 +111,7 @@ struct ex_event
 		job_result oJobResult;
 		sock_err oSocketError;
 		gpu_res_err oGpuError;
+		proxy_result oProxyResult;
 	};
 
 	ex_event() { iName = EV_INVALID_VAL; iPoolId = 0;}
@@ -103,6 +119,7 @@ struct ex_event
 	ex_event(std::string&& err, bool silent, size_t id) : iName(EV_SOCK_ERROR), iPoolId(id), oSocketError(std::move(err), silent) { }
 	ex_event(job_result dat, size_t id) : iName(EV_MINER_HAVE_RESULT), iPoolId(id), oJobResult(dat) {}
 	ex_event(pool_job dat, size_t id) : iName(EV_POOL_HAVE_JOB), iPoolId(id), oPoolJob(dat) {}
+	ex_event(proxy_result dat, size_t id) : iName(EV_PROXY_RESULT), iPoolId(id), oProxyResult(dat) {}
 	ex_event(ex_event_name ev, size_t id = 0) : iName(ev), iPoolId(id) {}
 
 	// Delete the copy operators to make sure we are moving only what is needed
@@ -125,6 +142,9 @@ struct ex_event
 		case EV_POOL_HAVE_JOB:
 			oPoolJob = from.oPoolJob;
 			break;
+		case EV_PROXY_RESULT:
+			oProxyResult = from.oProxyResult;
+			break;
 		case EV_GPU_RES_ERROR:
 			oGpuError = from.oGpuError;
 		default:
@@ -154,6 +174,9 @@ struct ex_event
 		case EV_POOL_HAVE_JOB:
 			oPoolJob = from.oPoolJob;
 			break;
+		case EV_PROXY_RESULT:
+			oProxyResult = from.oProxyResult;
+			break;
 		case EV_GPU_RES_ERROR:
 			oGpuError = from.oGpuError;
 		default:
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+
+/* Nonces we have already submitted, per pool and job.
+ *
+ * A nonce range can be hashed twice - the saved nonce of a pool is restored after a pool
+ * switch, nicehash mode overwrites the top byte, and a reconnect can hand out the same job
+ * again. Sending such a share only buys a "duplicate share" reject, so we drop it here.
+ *
+ * The set is exact (open addressing on the 32 bit nonce), a bloom or cuckoo filter would
+ * now and then throw away a good share. Executor thread only.
+ */
+class share_filter
+{
+public:
+	// Records the nonce and returns false, or returns true if it was already there
+	bool is_duplicate(size_t pool_id, const char* sJobID, uint32_t iNonce)
+	{
+		job_set& job = find_job(pool_id, sJobID);
+
+		if(iNonce == 0)
+		{
+			if(job.bHaveZero)
+				return suppress();
+			job.bHaveZero = true;
+			return false;
+		}
+
+		size_t mask = job.vSlots.size() - 1;
+		size_t i = hash(iNonce) & mask;
+		for(; job.vSlots[i] != 0; i = (i + 1) & mask)
+		{
+			if(job.vSlots[i] == iNonce)
+				return suppress();
+		}
+
+		job.vSlots[i] = iNonce;
+		if(++job.iCount * 2 > job.vSlots.size())
+			grow(job);
+		return false;
+	}
+
+	inline size_t get_suppressed() { return iSuppressed; }
+
+private:
+	// Jobs are only looked at while they can still get shares
+	static constexpr size_t iJobHistory = 16;
+	static constexpr size_t iInitialSlots = 64;
+
+	struct job_set
+	{
+		size_t pool_id;
+		char sJobID[64];
+		bool bHaveZero = false;
+		size_t iCount = 0;
+		std::vector<uint32_t> vSlots;
+	};
+
+	std::deque<job_set> dJobs;
+	size_t iSuppressed = 0;
+
+	inline bool suppress()
+	{
+		iSuppressed++;
+		return true;
+	}
+
+	static inline size_t hash(uint32_t iNonce)
+	{
+		// Threads count up from far apart start values, so mix the high bits down too
+		uint32_t h = iNonce * 0x9E3779B1u;
+		return h ^ (h >> 16);
+	}
+
+	job_set& find_job(size_t pool_id, const char* sJobID)
+	{
+		for(job_set& job : dJobs)
+		{
+			if(job.pool_id == pool_id && strncmp(job.sJobID, sJobID, sizeof(job_set::sJobID)) == 0)
+				return job;
+		}
+
+		if(dJobs.size() >= iJobHistory)
+			dJobs.pop_front();
+
+		dJobs.emplace_back();
+		job_set& job = dJobs.back();
+		job.pool_id = pool_id;
+		strncpy(job.sJobID, sJobID, sizeof(job_set::sJobID));
+		job.vSlots.resize(iInitialSlots, 0);
+		return job;
+	}
+
+	static void grow(job_set& job)
+	{
+		std::vector<uint32_t> vOld;
+		vOld.swap(job.vSlots);
+		job.vSlots.resize(vOld.size() * 2, 0);
+
+		size_t mask = job.vSlots.size() - 1;
+		for(uint32_t iNonce : vOld)
+		{
+			if(iNonce == 0)
+				continue;
+
+			size_t i = hash(iNonce) & mask;
+			while(job.vSlots[i] != 0)
+				i = (i + 1) & mask;
+			job.vSlots[i] = iNonce;
+		}
+	}
+};
@@ -40,97 +40,64 @@
 plain_socket::plain_socket(jpsock* err_callback) : pCallback(err_callback)
 {
 	hSocket = INVALID_SOCKET;
-	pSockAddr = nullptr;
 }
 
-bool plain_socket::set_hostname(const char* sAddr)
+inline bool get_pool_addr_list(jpsock* pCallback, const char* sAddr, std::vector<dns_cache::addr_entry>& vAddrs)
 {
-	char sAddrMb[256];
-	char *sTmp, *sPort;
-
-	size_t ln = strlen(sAddr);
-	if (ln >= sizeof(sAddrMb))
-		return pCallback->set_socket_error("CONNECT error: Pool address overflow.");
-
-	memcpy(sAddrMb, sAddr, ln);
-	sAddrMb[ln] = '\0';
-
-	if ((sTmp = strstr(sAddrMb, "//")) != nullptr)
-	{
-		sTmp += 2;
-		memmove(sAddrMb, sTmp, strlen(sTmp) + 1);
-	}
-
-	if ((sPort = strchr(sAddrMb, ':')) == nullptr)
+	std::string sHost, sPort, sError;
+	if(!dns_cache::split_addr(sAddr, sHost, sPort))
 		return pCallback->set_socket_error("CONNECT error: Pool port number not specified, please use format <hostname>:<port>.");
 
-	sPort[0] = '\0';
-	sPort++;
-
-	addrinfo hints = { 0 };
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_STREAM;
-	hints.ai_protocol = IPPROTO_TCP;
+	if(!dns_cache::inst()->get_addr_list(sHost, sPort, vAddrs, sError))
+		return pCallback->set_socket_error(sError.c_str());
 
-	pAddrRoot = nullptr;
-	int err;
-	if ((err = getaddrinfo(sAddrMb, sPort, &hints, &pAddrRoot)) != 0)
-		return pCallback->set_socket_error_strerr("CONNECT error: GetAddrInfo: ", err);
+	return true;
+}
 
-	addrinfo *ptr = pAddrRoot;
-	std::vector<addrinfo*> ipv4;
-	std::vector<addrinfo*> ipv6;
+bool plain_socket::set_hostname(const char* sAddr)
+{
+	return get_pool_addr_list(pCallback, sAddr, vAddrs);
+}
 
-	while (ptr != nullptr)
+bool plain_socket::connect()
+{
+	/* Walk the list in preference order, a dead address should not fail the whole pool.
+	 * Failures stay local until every address failed, the first socket error sticks and
+	 * would fail the login on the address that works. The socket is only published to
+	 * hSocket once it is connected, so close(false) never sees a half made one.
+	 */
+	char sSockErrText[512];
+	std::string sError = "CONNECT error: Pool has no address.";
+	for(const dns_cache::addr_entry& addr : vAddrs)
 	{
-		if (ptr->ai_family == AF_INET)
-			ipv4.push_back(ptr);
-		if (ptr->ai_family == AF_INET6)
-			ipv6.push_back(ptr);
-		ptr = ptr->ai_next;
-	}
+		SOCKET hConn = socket(addr.family, addr.socktype, addr.protocol);
 
-	if (ipv4.empty() && ipv6.empty())
-	{
-		freeaddrinfo(pAddrRoot);
-		pAddrRoot = nullptr;
-		return pCallback->set_socket_error("CONNECT error: I found some DNS records but no IPv4 or IPv6 addresses.");
-	}
-	else if (!ipv4.empty() && ipv6.empty())
-		pSockAddr = ipv4[rand() % ipv4.size()];
-	else if (ipv4.empty() && !ipv6.empty())
-		pSockAddr = ipv6[rand() % ipv6.size()];
-	else if (!ipv4.empty() && !ipv6.empty())
-	{
-		if(jconf::inst()->PreferIpv4())
-			pSockAddr = ipv4[rand() % ipv4.size()];
+		if(hConn == INVALID_SOCKET)
+		{
+			sError = std::string("CONNECT error: Socket creation failed ") + sock_strerror(sSockErrText, sizeof(sSockErrText));
+			continue;
+		}
+
+		if(::connect(hConn, (const sockaddr*)&addr.addr, (int)addr.addrlen) == 0)
+		{
+			std::lock_guard<std::mutex> lck(sock_mutex);
+			if(!bClosing)
+			{
+				hSocket = hConn;
+				return true;
+			}
+		}
 		else
-			pSockAddr = ipv6[rand() % ipv6.size()];
-	}
+			sError = std::string("CONNECT error: ") + sock_strerror(sSockErrText, sizeof(sSockErrText));
 
-	hSocket = socket(pSockAddr->ai_family, pSockAddr->ai_socktype, pSockAddr->ai_protocol);
+		sock_close(hConn);
 
-	if (hSocket == INVALID_SOCKET)
-	{
-		freeaddrinfo(pAddrRoot);
-		pAddrRoot = nullptr;
-		return pCallback->set_socket_error_strerr("CONNECT error: Socket creation failed ");
+		std::lock_guard<std::mutex> lck(sock_mutex);
+		if(bClosing)
+			return pCallback->set_socket_error("CONNECT error: Connection closed");
 	}
 
-	return true;
-}
-
-bool plain_socket::connect()
-{
-	int ret = ::connect(hSocket, pSockAddr->ai_addr, (int)pSockAddr->ai_addrlen);
-
-	freeaddrinfo(pAddrRoot);
-	pAddrRoot = nullptr;
-
-	if (ret != 0)
-		return pCallback->set_socket_error_strerr("CONNECT error: ");
-	else
-		return true;
+	return pCallback->set_socket_error(sError.c_str());
 }
 
 int plain_socket::recv(char* buf, unsigned int len)
@@ -165,11 +132,15 @@ bool plain_socket::send(const char* buf)
 
 void plain_socket::close(bool free)
 {
+	std::lock_guard<std::mutex> lck(sock_mutex);
 	if(hSocket != INVALID_SOCKET)
 	{
 		sock_close(hSocket);
 		hSocket = INVALID_SOCKET;
 	}
+
+	// free comes after the recv thread has ended, the next connect starts afresh
+	bClosing = !free;
 }
 
 #ifndef CONF_NO_TLS
@@ -177,7 +148,7 @@ tls_socket::tls_socket(jpsock* err_callback) : pCallback(err_callback)
 {
 }
 
-void tls_socket::print_error()
+void tls_socket::get_error(std::string& sError)
 {
 	BIO* err_bio = BIO_new(BIO_s_mem());
 	ERR_print_errors(err_bio);
@@ -185,19 +156,26 @@ void tls_socket::print_error()
 	char *buf = nullptr;
 	size_t len = BIO_get_mem_data(err_bio, &buf);
 
-	if(buf == nullptr)
+	if(buf == nullptr || len == 0)
 	{
 		if(jconf::inst()->TlsSecureAlgos())
-			pCallback->set_socket_error("Unknown TLS error. Secure TLS maybe unspported, try setting tls_secure_algo to false.");
+			sError = "Unknown TLS error. Secure TLS maybe unspported, try setting tls_secure_algo to false.";
 		else
-			pCallback->set_socket_error("Unknown TLS error.");
+			sError = "Unknown TLS error.";
 	}
 	else
-		pCallback->set_socket_error(buf, len);
+		sError.assign(buf, len);
 
 	BIO_free(err_bio);
 }
 
+void tls_socket::print_error()
+{
+	std::string sError;
+	get_error(sError);
+	pCallback->set_socket_error(sError.c_str());
+}
+
 void tls_socket::init_ctx()
 {
 	const SSL_METHOD* method = SSLv23_method();
@@ -213,6 +191,31 @@ void tls_socket::init_ctx()
 	{
 		SSL_CTX_set_options(ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3 | SSL_OP_NO_TLSv1 | SSL_OP_NO_COMPRESSION);
 	}
+
+	/* The ctx lives as long as the pool, so keep the session (or ticket) around and
+	 * offer it on reconnect. With TLS 1.3 the ticket arrives after the handshake,
+	 * hence the callback rather than SSL_get1_session. */
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_set_app_data(ctx, this);
+	SSL_CTX_sess_set_new_cb(ctx, new_session_cb);
+}
+
+int tls_socket::new_session_cb(SSL* ssl, SSL_SESSION* sess)
+{
+	tls_socket* self = (tls_socket*)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+	if(self->session != nullptr)
+		SSL_SESSION_free(self->session);
+	self->session = sess;
+	return 1; // We keep the reference
+}
+
+void tls_socket::drop_session()
+{
+	if(session != nullptr)
+	{
+		SSL_SESSION_free(session);
+		session = nullptr;
+	}
 }
 
 bool tls_socket::set_hostname(const char* sAddr)
@@ -227,47 +230,92 @@ bool tls_socket::set_hostname(const char* sAddr)
 		}
 	}
 
-	if((bio = BIO_new_ssl_connect(ctx)) == nullptr)
+	return get_pool_addr_list(pCallback, sAddr, vAddrs);
+}
+
+bool tls_socket::connect_addr(const dns_cache::addr_entry& addr, std::string& sError)
+{
+	std::string sAddr;
+	if(!dns_cache::addr_to_str(addr, sAddr))
 	{
-		print_error();
+		sError = "CONNECT error: Invalid pool address.";
 		return false;
 	}
 
-	if(BIO_set_conn_hostname(bio, sAddr) != 1)
+	ERR_clear_error();
+
+	BIO* bio_conn = BIO_new_ssl_connect(ctx);
+	if(bio_conn == nullptr)
 	{
-		print_error();
+		get_error(sError);
 		return false;
 	}
 
-	BIO_get_ssl(bio, &ssl);
-	if(ssl == nullptr)
+	SSL* ssl_conn = nullptr;
+	if(BIO_set_conn_hostname(bio_conn, sAddr.c_str()) == 1)
+		BIO_get_ssl(bio_conn, &ssl_conn);
+
+	if(ssl_conn == nullptr)
 	{
-		print_error();
+		get_error(sError);
+		BIO_free_all(bio_conn);
 		return false;
 	}
 
+	if(session != nullptr)
+		SSL_set_session(ssl_conn, session);
+
 	if(jconf::inst()->TlsSecureAlgos())
 	{
-		if(SSL_set_cipher_list(ssl, "HIGH:!aNULL:!kRSA:!PSK:!SRP:!MD5:!RC4:!SHA1") != 1)
+		if(SSL_set_cipher_list(ssl_conn, "HIGH:!aNULL:!kRSA:!PSK:!SRP:!MD5:!RC4:!SHA1") != 1)
 		{
-			print_error();
+			get_error(sError);
+			BIO_free_all(bio_conn);
 			return false;
 		}
 	}
 
+	if(BIO_do_connect(bio_conn) != 1)
+	{
+		get_error(sError);
+		BIO_free_all(bio_conn);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lck(sock_mutex);
+	if(bClosing)
+	{
+		sError = "CONNECT error: Connection closed";
+		BIO_free_all(bio_conn);
+		return false;
+	}
+
+	bio = bio_conn;
+	ssl = ssl_conn;
 	return true;
 }
 
 bool tls_socket::connect()
 {
-	if(BIO_do_connect(bio) != 1)
+	// Same as the plain socket, only the last failure is reported and only if all failed
+	std::string sError = "CONNECT error: Pool has no address.";
+	bool bConnected = false;
+	for(const dns_cache::addr_entry& addr : vAddrs)
 	{
-		print_error();
-		return false;
+		if((bConnected = connect_addr(addr, sError)))
+			break;
+
+		std::lock_guard<std::mutex> lck(sock_mutex);
+		if(bClosing)
+			break;
 	}
 
+	if(!bConnected)
+		return pCallback->set_socket_error(sError.c_str());
+
 	if(BIO_do_handshake(bio) != 1)
 	{
+		drop_session();
 		print_error();
 		return false;
 	}
@@ -327,6 +375,7 @@ bool tls_socket::connect()
 		}
 
 		pCallback->set_socket_error("FINGERPRINT FAILED CHECK");
+		drop_session();
 		BIO_free_all(b64);
 		X509_free(cert);
 		return false;
@@ -335,6 +384,9 @@ bool tls_socket::connect()
 	BIO_free_all(b64);
 
 	X509_free(cert);
+
+	// A resumed session still carries the peer certificate, so the check above holds
+	pCallback->set_tls_handshake(SSL_session_reused(ssl) == 1);
 	return true;
 }
 
@@ -357,6 +409,10 @@ bool tls_socket::send(const char* buf)
 
 void tls_socket::close(bool free)
 {
+	std::lock_guard<std::mutex> lck(sock_mutex);
+	// free comes after the recv thread has ended, the next connect starts afresh
+	bClosing = !free;
+
 	if(bio == nullptr || ssl == nullptr)
 		return;
 
@@ -1,6 +1,12 @@
 #pragma once
 
 #include "socks.hpp"
+#include "dns_cache.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
 
 class jpsock;
 
@@ -27,14 +33,18 @@ public:
 
 private:
 	jpsock* pCallback;
-	addrinfo *pSockAddr;
-	addrinfo *pAddrRoot;
-	SOCKET hSocket;
+	std::vector<dns_cache::addr_entry> vAddrs;
+	std::atomic<SOCKET> hSocket;
+
+	// close(false) may come from the executor while the recv thread connects
+	std::mutex sock_mutex;
+	bool bClosing = false;
 };
 
 typedef struct ssl_ctx_st SSL_CTX;
 typedef struct bio_st BIO;
 typedef struct ssl_st SSL;
+typedef struct ssl_session_st SSL_SESSION;
 
 class tls_socket : public base_socket
 {
@@ -50,10 +60,22 @@ public:
 private:
 	void init_ctx();
 	void print_error();
+	void get_error(std::string& sError);
+	bool connect_addr(const dns_cache::addr_entry& addr, std::string& sError);
+	void drop_session();
+	static int new_session_cb(SSL* ssl, SSL_SESSION* sess);
 
 	jpsock* pCallback;
+	std::vector<dns_cache::addr_entry> vAddrs;
 
 	SSL_CTX* ctx = nullptr;
 	BIO* bio = nullptr;
 	SSL* ssl = nullptr;
+
+	// Guards publishing bio against close(false) from the executor
+	std::mutex sock_mutex;
+	bool bClosing = false;
+
+	// Last session the pool gave us, offered again on reconnect
+	SSL_SESSION* session = nullptr;
 };
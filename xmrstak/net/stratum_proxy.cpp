@@ -0,0 +1,598 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+#include "stratum_proxy.hpp"
+#include "jpsock.hpp"
+
+#include "xmrstak/backend/cpu/minethd.hpp"
+#include "xmrstak/jconf.hpp"
+#include "xmrstak/misc/executor.hpp"
+#include "xmrstak/misc/console.hpp"
+#include "xmrstak/misc/jext.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace rapidjson;
+
+typedef GenericDocument<UTF8<>, MemoryPoolAllocator<>, MemoryPoolAllocator<>> MemDocument;
+
+stratum_proxy* stratum_proxy::oInst = nullptr;
+
+// A client that doesn't read its socket for this long is dropped
+constexpr static int iSendTimeout = 5;
+
+struct stratum_proxy::proxy_client
+{
+	size_t id;
+	SOCKET sck;
+	uint8_t nonce_byte;
+	bool logged_in;
+	std::string addr;
+
+	// Lines for the send thread, closed once the client is being dropped
+	std::mutex send_mutex;
+	std::condition_variable send_cond;
+	std::deque<std::string> dSendQueue;
+	bool bSendClosed;
+	std::thread oSendThd;
+
+	uint8_t bJsonRecvMem[iJsonMemSize];
+	uint8_t bJsonParseMem[iJsonMemSize];
+	MemoryPoolAllocator<> recvAllocator;
+	MemoryPoolAllocator<> parseAllocator;
+	MemDocument jsonDoc;
+
+	proxy_client(size_t id, SOCKET sck, uint8_t nonce_byte) : id(id), sck(sck), nonce_byte(nonce_byte), logged_in(false), bSendClosed(false),
+		recvAllocator(bJsonRecvMem, iJsonMemSize),
+		parseAllocator(bJsonParseMem, iJsonMemSize),
+		jsonDoc(&recvAllocator, iJsonMemSize, &parseAllocator)
+	{
+	}
+};
+
+// One context for all clients, a client submits a share every few minutes at most
+struct stratum_proxy::share_checker
+{
+	std::mutex mtx;
+	cryptonight_ctx* ctx;
+	xmrstak::cpu::minethd::cn_hash_fun hash_fun;
+};
+
+inline void sock_shutdown(SOCKET s)
+{
+#ifdef _WIN32
+	shutdown(s, SD_BOTH);
+#else
+	shutdown(s, SHUT_RDWR);
+#endif
+}
+
+bool stratum_proxy::start(const char* sBind, uint16_t port, const char* sPass)
+{
+	char sSockErrText[512];
+
+	sock_init();
+	sPassword.assign(sPass);
+
+	pChecker = new share_checker;
+	pChecker->ctx = xmrstak::cpu::minethd::minethd_alloc_ctx();
+	if(pChecker->ctx == nullptr)
+	{
+		printer::inst()->print_msg(L0, "PROXY ERROR: No memory to check the shares of the rigs.");
+		return false;
+	}
+	pChecker->hash_fun = xmrstak::cpu::minethd::func_selector(jconf::inst()->HaveHardwareAes(),
+		true /*bNoPrefetch*/, jconf::inst()->IsCurrencyMonero());
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST;
+
+	addrinfo* pAddr = nullptr;
+	std::string sPort = std::to_string(port);
+	int err = getaddrinfo(sBind, sPort.c_str(), &hints, &pAddr);
+	if(err != 0)
+	{
+		printer::inst()->print_msg(L0, "PROXY ERROR: Invalid proxy_bind address %s: %s", sBind, sock_gai_strerror(err, sSockErrText, sizeof(sSockErrText)));
+		return false;
+	}
+
+	listen_sck = socket(pAddr->ai_family, pAddr->ai_socktype, pAddr->ai_protocol);
+	if(listen_sck == INVALID_SOCKET)
+	{
+		printer::inst()->print_msg(L0, "PROXY ERROR: socket: %s", sock_strerror(sSockErrText, sizeof(sSockErrText)));
+		freeaddrinfo(pAddr);
+		return false;
+	}
+
+	int on = 1;
+	setsockopt(listen_sck, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+
+	if(bind(listen_sck, pAddr->ai_addr, (int)pAddr->ai_addrlen) != 0 || listen(listen_sck, SOMAXCONN) != 0)
+	{
+		printer::inst()->print_msg(L0, "PROXY ERROR: Can't listen on %s port %u: %s", sBind, unsigned(port), sock_strerror(sSockErrText, sizeof(sSockErrText)));
+		sock_close(listen_sck);
+		listen_sck = INVALID_SOCKET;
+		freeaddrinfo(pAddr);
+		return false;
+	}
+	freeaddrinfo(pAddr);
+
+	std::thread(&stratum_proxy::accept_thd, this).detach();
+
+	printer::inst()->print_msg(L0, "Stratum proxy listening on %s port %u%s.", sBind, unsigned(port),
+		sPassword.empty() ? ", no password" : "");
+	return true;
+}
+
+void stratum_proxy::accept_thd()
+{
+	while(true)
+	{
+		sockaddr_storage addr;
+		socklen_t addrlen = sizeof(addr);
+		SOCKET sck = accept(listen_sck, (sockaddr*)&addr, &addrlen);
+
+		if(sck == INVALID_SOCKET)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			continue;
+		}
+
+		char sHost[64];
+		if(getnameinfo((const sockaddr*)&addr, addrlen, sHost, sizeof(sHost), nullptr, 0, NI_NUMERICHOST) != 0)
+			snprintf(sHost, sizeof(sHost), "<unknown>");
+
+		std::unique_lock<std::mutex> lck(proxy_mutex);
+
+		// Lowest free top nonce byte, zero is ours
+		size_t nonce_byte = 1;
+		for(; nonce_byte <= iMaxClients; nonce_byte++)
+		{
+			bool used = false;
+			for(proxy_client* client : lClients)
+			{
+				if(client->nonce_byte == nonce_byte)
+				{
+					used = true;
+					break;
+				}
+			}
+
+			if(!used)
+				break;
+		}
+
+		if(nonce_byte > iMaxClients)
+		{
+			lck.unlock();
+			printer::inst()->print_msg(L1, "Proxy is full, refusing %s.", sHost);
+			sock_close(sck);
+			continue;
+		}
+
+		proxy_client* client = new proxy_client(iNextClientId++, sck, uint8_t(nonce_byte));
+		client->addr.assign(sHost);
+		lClients.push_back(client);
+		lck.unlock();
+
+#ifdef _WIN32
+		DWORD timeout = iSendTimeout * 1000;
+#else
+		timeval timeout = { iSendTimeout, 0 };
+#endif
+		setsockopt(sck, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+
+		client->oSendThd = std::thread(&stratum_proxy::client_send_thd, this, client);
+		std::thread(&stratum_proxy::client_thd, this, client).detach();
+	}
+}
+
+void stratum_proxy::client_send_thd(proxy_client* client)
+{
+	std::string sLine;
+	while(true)
+	{
+		std::unique_lock<std::mutex> lck(client->send_mutex);
+		client->send_cond.wait(lck, [client]{ return client->bSendClosed || !client->dSendQueue.empty(); });
+		if(client->bSendClosed)
+			break;
+
+		sLine = std::move(client->dSendQueue.front());
+		client->dSendQueue.pop_front();
+		lck.unlock();
+
+		size_t pos = 0;
+		while(pos < sLine.size())
+		{
+			int ret = send(client->sck, sLine.data() + pos, sLine.size() - pos, 0);
+			if(ret <= 0)
+				break;
+			pos += ret;
+		}
+
+		if(pos < sLine.size())
+			break;
+	}
+
+	// Wakes up the client thread, which drops the client
+	std::unique_lock<std::mutex> lck(client->send_mutex);
+	client->bSendClosed = true;
+	lck.unlock();
+	sock_shutdown(client->sck);
+}
+
+void stratum_proxy::client_thd(proxy_client* client)
+{
+	printer::inst()->print_msg(L2, "Proxy client %s connected, nonce byte %u.", client->addr.c_str(), unsigned(client->nonce_byte));
+
+	char buf[iSockBufferSize];
+	size_t datalen = 0;
+	bool bRunning = true;
+	while(bRunning)
+	{
+		int ret = recv(client->sck, buf + datalen, sizeof(buf) - datalen, 0);
+
+		if(ret <= 0)
+			break;
+
+		datalen += ret;
+
+		if(datalen >= sizeof(buf))
+		{
+			printer::inst()->print_msg(L1, "Proxy client %s: data overflow.", client->addr.c_str());
+			break;
+		}
+
+		char* lnend;
+		char* lnstart = buf;
+		while((lnend = (char*)memchr(lnstart, '\n', datalen)) != nullptr)
+		{
+			lnend++;
+			int lnlen = lnend - lnstart;
+
+			if(!process_line(client, lnstart, lnlen))
+			{
+				printer::inst()->print_msg(L1, "Proxy client %s: protocol error.", client->addr.c_str());
+				bRunning = false;
+				break;
+			}
+
+			datalen -= lnlen;
+			lnstart = lnend;
+		}
+
+		//Got leftover data? Move it to the front
+		if(datalen > 0 && buf != lnstart)
+			memmove(buf, lnstart, datalen);
+	}
+
+	std::unique_lock<std::mutex> lck(proxy_mutex);
+	lClients.remove(client);
+	lck.unlock();
+
+	// Nobody queues lines any more, stop the send thread before the socket goes
+	std::unique_lock<std::mutex> send_lck(client->send_mutex);
+	client->bSendClosed = true;
+	send_lck.unlock();
+	client->send_cond.notify_one();
+	client->oSendThd.join();
+
+	sock_close(client->sck);
+	printer::inst()->print_msg(L2, "Proxy client %s disconnected.", client->addr.c_str());
+	delete client;
+}
+
+bool stratum_proxy::process_line(proxy_client* client, char* line, size_t len)
+{
+	client->jsonDoc.SetNull();
+	client->parseAllocator.Clear();
+
+	/*NULL terminate the line instead of '\n', parsing will add some more NULLs*/
+	line[len-1] = '\0';
+
+	MemDocument& doc = client->jsonDoc;
+	if(doc.ParseInsitu(line).HasParseError() || !doc.IsObject())
+		return false;
+
+	const Value* id = GetObjectMember(doc, "id");
+	const Value* method = GetObjectMember(doc, "method");
+	const Value* params = GetObjectMember(doc, "params");
+
+	if(id == nullptr || !id->IsUint64() || method == nullptr || !method->IsString() || params == nullptr || !params->IsObject())
+		return false;
+
+	uint64_t call_id = id->GetUint64();
+	const char* sMethod = method->GetString();
+
+	char sJob[512];
+	char buf[1024];
+
+	if(strcmp(sMethod, "login") == 0 || strcmp(sMethod, "getjob") == 0)
+	{
+		bool login = sMethod[0] == 'l';
+
+		// Hold the lock until the reply is queued, so that push_job can't queue a newer job before it
+		std::unique_lock<std::mutex> lck(proxy_mutex);
+		if(dJobs.empty())
+		{
+			lck.unlock();
+			return send_error(client, call_id, "No job available yet, try again later");
+		}
+
+		if(!login && !client->logged_in)
+		{
+			lck.unlock();
+			return send_error(client, call_id, "Unauthenticated");
+		}
+
+		if(login && !sPassword.empty())
+		{
+			const Value* pass = GetObjectMember(*params, "pass");
+			if(pass == nullptr || !pass->IsString() || sPassword != pass->GetString())
+			{
+				lck.unlock();
+				printer::inst()->print_msg(L1, "Proxy client %s: wrong password.", client->addr.c_str());
+				return send_error(client, call_id, "Wrong password");
+			}
+		}
+
+		format_job(sJob, sizeof(sJob), client, dJobs.back());
+		if(login)
+			snprintf(buf, sizeof(buf), "{\"id\":%llu,\"jsonrpc\":\"2.0\",\"error\":null,\"result\":{\"id\":\"%llx\",\"job\":%s,\"status\":\"OK\"}}\n",
+				int_port(call_id), int_port(client->id), sJob);
+		else
+			snprintf(buf, sizeof(buf), "{\"id\":%llu,\"jsonrpc\":\"2.0\",\"error\":null,\"result\":%s}\n", int_port(call_id), sJob);
+
+		client->logged_in = true;
+		return send_line(client, buf);
+	}
+
+	if(!client->logged_in)
+		return send_error(client, call_id, "Unauthenticated");
+
+	if(strcmp(sMethod, "keepalived") == 0)
+	{
+		snprintf(buf, sizeof(buf), "{\"id\":%llu,\"jsonrpc\":\"2.0\",\"error\":null,\"result\":{\"status\":\"KEEPALIVED\"}}\n", int_port(call_id));
+		return send_line(client, buf);
+	}
+
+	if(strcmp(sMethod, "submit") != 0)
+		return send_error(client, call_id, "Unsupported method");
+
+	const Value* jobid = GetObjectMember(*params, "job_id");
+	const Value* nonce = GetObjectMember(*params, "nonce");
+	const Value* result = GetObjectMember(*params, "result");
+
+	if(jobid == nullptr || nonce == nullptr || result == nullptr || !jobid->IsString() || !nonce->IsString() || !result->IsString() ||
+		nonce->GetStringLength() != 8 || result->GetStringLength() != 64)
+	{
+		iRejected++;
+		return send_error(client, call_id, "Malformed share");
+	}
+
+	job_result oResult;
+	memset(&oResult, 0, sizeof(oResult));
+	if(!jpsock::hex2bin(nonce->GetString(), 8, (unsigned char*)&oResult.iNonce) || !jpsock::hex2bin(result->GetString(), 64, oResult.bResult))
+	{
+		iRejected++;
+		return send_error(client, call_id, "Malformed share");
+	}
+
+	if((oResult.iNonce >> 24) != client->nonce_byte)
+	{
+		iRejected++;
+		return send_error(client, call_id, "Nonce outside of the assigned range, is use_nicehash set?");
+	}
+
+	std::unique_lock<std::mutex> lck(proxy_mutex);
+	const proxy_job* job = find_job(jobid->GetString());
+	if(job == nullptr)
+	{
+		lck.unlock();
+		iRejected++;
+		return send_error(client, call_id, "Stale job");
+	}
+
+	pool_job oJob = job->oJob;
+	size_t pool_id = job->pool_id;
+	lck.unlock();
+
+	if(((uint64_t*)oResult.bResult)[3] >= oJob.iTarget)
+	{
+		iRejected++;
+		return send_error(client, call_id, "Low difficulty share");
+	}
+
+	// The result is whatever the client claims, the pool would hold a bad one against our login
+	if(!check_share(oJob, oResult))
+	{
+		iRejected++;
+		printer::inst()->print_msg(L1, "Proxy client %s sent an invalid result.", client->addr.c_str());
+		return send_error(client, call_id, "Invalid result");
+	}
+
+	memcpy(oResult.sJobID, oJob.sJobID, sizeof(job_result::sJobID));
+
+	executor::inst()->push_event(ex_event(proxy_result(oResult, client->id, call_id), pool_id));
+	return true;
+}
+
+void stratum_proxy::format_job(char* buf, size_t len, const proxy_client* client, const proxy_job& job)
+{
+	uint8_t bBlob[sizeof(pool_job::bWorkBlob)];
+	memcpy(bBlob, job.oJob.bWorkBlob, job.oJob.iWorkLen);
+	bBlob[iNonceOffset + 3] = client->nonce_byte;
+
+	char sBlob[sizeof(pool_job::bWorkBlob) * 2 + 1];
+	jpsock::bin2hex(bBlob, job.oJob.iWorkLen, sBlob);
+	sBlob[job.oJob.iWorkLen * 2] = '\0';
+
+	// Full 64 bit target, so that the clients see exactly the upstream difficulty
+	char sTarget[17];
+	jpsock::bin2hex((const unsigned char*)&job.oJob.iTarget, sizeof(job.oJob.iTarget), sTarget);
+	sTarget[16] = '\0';
+
+	snprintf(buf, len, "{\"blob\":\"%s\",\"job_id\":\"%x\",\"target\":\"%s\"}", sBlob, job.iProxyJobId, sTarget);
+}
+
+bool stratum_proxy::check_share(const pool_job& oJob, job_result& oResult)
+{
+	uint8_t bBlob[sizeof(pool_job::bWorkBlob)];
+	memcpy(bBlob, oJob.bWorkBlob, oJob.iWorkLen);
+	memcpy(bBlob + iNonceOffset, &oResult.iNonce, sizeof(oResult.iNonce));
+
+	uint8_t bHash[32];
+	std::unique_lock<std::mutex> lck(pChecker->mtx);
+	pChecker->hash_fun(bBlob, oJob.iWorkLen, bHash, pChecker->ctx);
+	lck.unlock();
+
+	return memcmp(bHash, oResult.bResult, sizeof(bHash)) == 0;
+}
+
+const stratum_proxy::proxy_job* stratum_proxy::find_job(const char* sJobId)
+{
+	char* end;
+	unsigned long id = strtoul(sJobId, &end, 16);
+	if(end == sJobId || *end != '\0')
+		return nullptr;
+
+	for(const proxy_job& job : dJobs)
+	{
+		if(job.iProxyJobId == id)
+			return &job;
+	}
+
+	return nullptr;
+}
+
+bool stratum_proxy::send_line(proxy_client* client, const char* buf)
+{
+	std::unique_lock<std::mutex> lck(client->send_mutex);
+	if(client->bSendClosed)
+		return false;
+
+	// Not reading its socket, the send thread shuts it down
+	if(client->dSendQueue.size() >= iMaxSendQueue)
+		client->bSendClosed = true;
+	else
+		client->dSendQueue.emplace_back(buf);
+
+	bool bQueued = !client->bSendClosed;
+	lck.unlock();
+
+	client->send_cond.notify_one();
+	return bQueued;
+}
+
+bool stratum_proxy::send_error(proxy_client* client, uint64_t call_id, const char* error)
+{
+	// Pool error messages are passed on, keep them valid JSON
+	char sError[256];
+	size_t i = 0;
+	for(; error[i] != '\0' && i < sizeof(sError) - 1; i++)
+		sError[i] = (error[i] == '"' || error[i] == '\\' || (unsigned char)error[i] < 0x20) ? ' ' : error[i];
+	sError[i] = '\0';
+
+	char buf[512];
+	snprintf(buf, sizeof(buf), "{\"id\":%llu,\"jsonrpc\":\"2.0\",\"error\":{\"code\":-1,\"message\":\"%s\"}}\n", int_port(call_id), sError);
+	return send_line(client, buf);
+}
+
+void stratum_proxy::push_job(size_t pool_id, const pool_job& oPoolJob)
+{
+	if(oPoolJob.iWorkLen < iNonceOffset + 4)
+		return;
+
+	std::unique_lock<std::mutex> lck(proxy_mutex);
+
+	// Same job again, for example when we come back from the dev pool
+	if(!dJobs.empty() && dJobs.back().pool_id == pool_id && strcmp(dJobs.back().oJob.sJobID, oPoolJob.sJobID) == 0)
+		return;
+
+	dJobs.emplace_back();
+	proxy_job& job = dJobs.back();
+	job.iProxyJobId = iNextJobId++;
+	job.pool_id = pool_id;
+	job.oJob = oPoolJob;
+
+	if(dJobs.size() > iJobHistory)
+		dJobs.pop_front();
+
+	char sJob[512];
+	char buf[640];
+	for(proxy_client* client : lClients)
+	{
+		if(!client->logged_in)
+			continue;
+
+		format_job(sJob, sizeof(sJob), client, job);
+		snprintf(buf, sizeof(buf), "{\"jsonrpc\":\"2.0\",\"method\":\"job\",\"params\":%s}\n", sJob);
+		send_line(client, buf);
+	}
+}
+
+void stratum_proxy::send_result(size_t client_id, uint64_t call_id, bool accepted, const char* error)
+{
+	if(accepted)
+		iAccepted++;
+	else
+		iRejected++;
+
+	std::unique_lock<std::mutex> lck(proxy_mutex);
+	for(proxy_client* client : lClients)
+	{
+		if(client->id != client_id)
+			continue;
+
+		if(accepted)
+		{
+			char buf[128];
+			snprintf(buf, sizeof(buf), "{\"id\":%llu,\"jsonrpc\":\"2.0\",\"error\":null,\"result\":{\"status\":\"OK\"}}\n", int_port(call_id));
+			send_line(client, buf);
+		}
+		else
+			send_error(client, call_id, error);
+		break;
+	}
+}
+
+void stratum_proxy::get_stats(size_t& clients, size_t& accepted, size_t& rejected)
+{
+	std::unique_lock<std::mutex> lck(proxy_mutex);
+	clients = 0;
+	for(proxy_client* client : lClients)
+	{
+		if(client->logged_in)
+			clients++;
+	}
+	lck.unlock();
+
+	accepted = iAccepted;
+	rejected = iRejected;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "socks.hpp"
+#include "msgstruct.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <list>
+#include <deque>
+#include <condition_variable>
+
+/* Stratum proxy mode - other rigs log in to us as if we were a pool, and their shares
+ * go upstream through our own pool connection.
+ *
+ * The upstream nonce space is split by the top nonce byte, the same way a NiceHash pool
+ * does it. Every client gets its own value (1 - 255) and has to mine in nicehash mode,
+ * value 0 is kept for our own threads. The requests are parsed with the same rapidjson
+ * setup as jpsock. Shares are hashed again before they are handed to the executor, which
+ * submits them on the upstream socket and calls us back with the pool's answer.
+ *
+ * The executor never touches a client socket, it only queues lines for the client's send
+ * thread. A client that falls iMaxSendQueue lines behind is dropped.
+ */
+class stratum_proxy
+{
+public:
+	static stratum_proxy* inst()
+	{
+		if (oInst == nullptr) oInst = new stratum_proxy;
+		return oInst;
+	};
+
+	// sBind is a numeric IPv4 or IPv6 address, an empty sPass lets every client in
+	bool start(const char* sBind, uint16_t port, const char* sPass);
+
+	// Executor thread - a new upstream job, queued for all clients
+	void push_job(size_t pool_id, const pool_job& oPoolJob);
+
+	// Executor thread - the upstream answer to a share from proxy_result
+	void send_result(size_t client_id, uint64_t call_id, bool accepted, const char* error);
+
+	void get_stats(size_t& clients, size_t& accepted, size_t& rejected);
+
+	static constexpr size_t iMaxClients = 255;
+
+private:
+	stratum_proxy() : iAccepted(0), iRejected(0) {}
+	static stratum_proxy* oInst;
+
+	// Offset of the nonce in the hashing blob
+	static constexpr size_t iNonceOffset = 39;
+	// Old jobs are kept so that shares sent during a job switch still go through
+	static constexpr size_t iJobHistory = 4;
+	static constexpr size_t iSockBufferSize = 4096;
+	static constexpr size_t iJsonMemSize = 4096;
+	static constexpr size_t iMaxSendQueue = 64;
+
+	struct proxy_job
+	{
+		uint32_t iProxyJobId;
+		size_t pool_id;
+		pool_job oJob;
+	};
+
+	struct proxy_client;
+	struct share_checker;
+
+	void accept_thd();
+	void client_thd(proxy_client* client);
+	void client_send_thd(proxy_client* client);
+	bool process_line(proxy_client* client, char* line, size_t len);
+	bool check_share(const pool_job& oJob, job_result& oResult);
+
+	// Only queues the line, any thread and with proxy_mutex held
+	bool send_line(proxy_client* client, const char* buf);
+	bool send_error(proxy_client* client, uint64_t call_id, const char* error);
+	void format_job(char* buf, size_t len, const proxy_client* client, const proxy_job& job);
+	const proxy_job* find_job(const char* sJobId);
+
+	SOCKET listen_sck = INVALID_SOCKET;
+	std::string sPassword;
+	share_checker* pChecker = nullptr;
+
+	// Guards the client list and the job history, taken before a client's send_mutex
+	std::mutex proxy_mutex;
+	std::list<proxy_client*> lClients;
+	std::deque<proxy_job> dJobs;
+	uint32_t iNextJobId = 1;
+	size_t iNextClientId = 1;
+
+	std::atomic<size_t> iAccepted;
+	std::atomic<size_t> iRejected;
+};
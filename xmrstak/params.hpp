@@ -2,6 +2,7 @@
 
 #include "xmrstak/misc/environment.hpp"
 
+#include <stdint.h>
 #include <string>
 
 namespace xmrstak
@@ -23,6 +24,18 @@ struct params
 	bool useAMD;
 	bool useNVIDIA;
 	bool useCPU;
+	// Run the CPU kernels that count cycles per hash phase, for the reports
+	bool profileCPU = false;
+	// Open the hardware performance counters of every CPU thread
+	bool perfEvents = false;
+	// Hash for a minute without pools and report hashrate and power, see do_benchmark
+	bool benchmark = false;
+	// Record a timeline of the miner threads, the 't' key writes it to this file, see tracer
+	std::string traceFile;
+	// Start of main, in milliseconds on the clock of iBackend::iTimestamp
+	uint64_t iStartTime = 0;
+	// Keep the compiled OpenCL kernels on disk between starts
+	bool AMDCache = true;
 
 	bool poolUseTls = false;
 	std::string poolURL;
@@ -38,6 +51,11 @@ struct params
 	std::string configFileNVIDIA;
 	std::string configFileCPU;
 
+	// Offline hashing with --hash-file, the miner is not started
+	std::string hashFile;
+	size_t hashThreads = 0;
+	size_t hashMultiway = 1;
+
 	params() :
 		binaryName("xmr-stak"),
 		executablePrefix(""),
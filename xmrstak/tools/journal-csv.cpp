@@ -0,0 +1,189 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Converts the binary journal of the miner (journal_file in the config) to CSV.
+ *
+ * The records are written in the order they happened, the slots that were never written
+ * and a record cut by a crash are left out. It only reads the file, so it can run while
+ * the miner is writing to it.
+ */
+
+#include "xmrstak/misc/journal.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+using xmrstak::journal;
+
+static void help()
+{
+	using namespace std;
+	cout<<"Usage: xmr-stak-journal [OPTION]... FILE"<<endl;
+	cout<<" "<<endl;
+	cout<<"  -h, --help            show this help"<<endl;
+	cout<<"  -o, --output FILE     write the CSV to FILE instead of stdout"<<endl;
+	cout<<"  --type TYPE           only records of this type: start, job, share, pool_switch"<<endl;
+	cout<<"                        or hashrate"<<endl;
+	cout<<" "<<endl;
+}
+
+static void print_pool(FILE* out, uint64_t iPool)
+{
+	if(iPool == 0xFFFF)
+		return;
+	if(iPool == 0xFFFE)
+		fputs("daemon", out);
+	else
+		fprintf(out, "%llu", (unsigned long long)iPool);
+}
+
+static void print_record(FILE* out, const journal::record& rec)
+{
+	char sJobID[sizeof(rec.sJobID) + 1] = {};
+	memcpy(sJobID, rec.sJobID, sizeof(rec.sJobID));
+
+	fprintf(out, "%llu,%llu,%s,", (unsigned long long)rec.iSeq, (unsigned long long)rec.iTime, journal::get_type_name(rec.iType));
+	print_pool(out, rec.iPool);
+	fputc(',', out);
+
+	switch(rec.iType)
+	{
+	case journal::REC_START:
+		fprintf(out, "%llu,,,,,,,,\n", (unsigned long long)rec.iValue);
+		break;
+	case journal::REC_JOB:
+		fprintf(out, ",%s,,%llu,,%llu,,,\n", sJobID, (unsigned long long)rec.iDiff, (unsigned long long)rec.iValue);
+		break;
+	case journal::REC_SHARE:
+		fprintf(out, "%u,%s,%08x,%llu,%s,%llu,,,\n", rec.iThread, sJobID, rec.iNonce, (unsigned long long)rec.iDiff,
+			journal::get_verdict_name(rec.iVerdict), (unsigned long long)rec.iValue);
+		break;
+	case journal::REC_POOL_SWITCH:
+		fputs(",,,,,,,,", out);
+		print_pool(out, rec.iValue);
+		fputc('\n', out);
+		break;
+	case journal::REC_HASHRATE:
+		fprintf(out, "%u,,,,,,%.3f,%llu,\n", rec.iThread, rec.iValue / 1000.0, (unsigned long long)rec.iDiff);
+		break;
+	default:
+		fputs(",,,,,,,,\n", out);
+		break;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string sFile;
+	std::string sOutFile;
+	std::string sType;
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string opName(argv[i]);
+
+		if(opName == "-h" || opName == "--help")
+		{
+			help();
+			return 0;
+		}
+
+		if(opName == "-o" || opName == "--output" || opName == "--type")
+		{
+			if(i + 1 >= argc)
+			{
+				printf("No argument for parameter '%s' given\n", opName.c_str());
+				return 1;
+			}
+			(opName == "--type" ? sType : sOutFile) = argv[++i];
+		}
+		else if(opName[0] == '-' || !sFile.empty())
+		{
+			printf("Parameter unknown '%s'\n", opName.c_str());
+			help();
+			return 1;
+		}
+		else
+			sFile = opName;
+	}
+
+	if(sFile.empty())
+	{
+		help();
+		return 1;
+	}
+
+	FILE* in = fopen(sFile.c_str(), "rb");
+	if(in == nullptr)
+	{
+		printf("Can't open journal %s\n", sFile.c_str());
+		return 1;
+	}
+
+	journal::header oHdr;
+	if(fread(&oHdr, sizeof(oHdr), 1, in) != 1 || memcmp(oHdr.sMagic, journal::get_magic(), sizeof(oHdr.sMagic)) != 0)
+	{
+		printf("%s is not a journal of the miner\n", sFile.c_str());
+		return 1;
+	}
+
+	if(oHdr.iVersion != journal::iVersion || oHdr.iRecordSize != sizeof(journal::record))
+	{
+		printf("%s is a journal version %u, this tool reads version %u\n", sFile.c_str(), oHdr.iVersion, journal::iVersion);
+		return 1;
+	}
+
+	std::vector<journal::record> vRecords;
+	journal::record rec;
+	for(uint64_t i = 0; i < oHdr.iCapacity && fread(&rec, sizeof(rec), 1, in) == 1; i++)
+	{
+		if(rec.iSeq == 0)
+			continue;
+		if(!sType.empty() && sType != journal::get_type_name(rec.iType))
+			continue;
+		vRecords.push_back(rec);
+	}
+	fclose(in);
+
+	std::sort(vRecords.begin(), vRecords.end(), [](const journal::record& a, const journal::record& b) { return a.iSeq < b.iSeq; });
+
+	FILE* out = stdout;
+	if(!sOutFile.empty() && (out = fopen(sOutFile.c_str(), "w")) == nullptr)
+	{
+		printf("Can't open output file %s\n", sOutFile.c_str());
+		return 1;
+	}
+
+	fputs("seq,time_ms,type,pool,thread,job_id,nonce,difficulty,verdict,latency_us,hashrate,hash_count,prev_pool\n", out);
+	for(const journal::record& r : vRecords)
+		print_record(out, r);
+
+	if(out != stdout)
+		fclose(out);
+	return 0;
+}
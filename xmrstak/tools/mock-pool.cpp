@@ -0,0 +1,799 @@
+/*
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  * Additional permission under GNU GPL version 3 section 7
+  *
+  * If you modify this Program, or any covered work, by linking or combining
+  * it with OpenSSL (or a modified version of that library), containing parts
+  * covered by the terms of OpenSSL License and SSLeay License, the licensors
+  * of this Program grant you additional permission to convey the resulting work.
+  *
+  */
+
+/*
+ * Mock stratum pool for end-to-end benchmarks of the miner's network and job pipeline.
+ *
+ * It speaks the login / job / submit / keepalived protocol that jpsock expects and sends
+ * either a synthetic job stream or a recorded one. Latency, rejects and disconnects can be
+ * injected, and every share is logged with the time since its job was sent. The hashes are
+ * not verified, so the numbers measure the pipeline and not the pool.
+ *
+ * With --daemon it stands in for monerod instead, and answers get_block_template and
+ * submit_block on the HTTP JSON-RPC port. Every job is a new block template, and every
+ * submitted block counts as a share.
+ */
+
+#include "xmrstak/net/socks.hpp"
+#include "xmrstak/rapidjson/document.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <deque>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+using namespace rapidjson;
+
+struct mock_cfg
+{
+	uint16_t port = 3333;
+	bool daemon = false;
+	size_t job_interval = 30000;
+	std::string replay_file;
+	uint64_t diff = 5000;
+	size_t latency = 0;
+	size_t reject_pct = 0;
+	size_t disconnect_time = 0;
+	size_t duration = 0;
+	size_t report_time = 10;
+	std::string log_file;
+	uint32_t seed = 1;
+};
+
+struct replay_job
+{
+	size_t delay;
+	std::string blob;
+	std::string target;
+};
+
+struct sent_job
+{
+	uint64_t seq;
+	std::string job_id;
+	std::string blob;
+	std::string target;
+	std::string tpl; // Block template blob, daemon mode only
+	size_t sent_time;
+	size_t next_time = 0; // When the job that replaced it was sent
+	std::set<std::string> nonces;
+};
+
+struct mock_conn
+{
+	size_t id;
+	SOCKET sck;
+	size_t connect_time;
+	bool logged_in = false;
+	bool kicked = false;
+	std::mutex send_mutex;
+};
+
+// Everything below is guarded by oMutex
+static mock_cfg oCfg;
+static std::mutex oMutex;
+static std::list<mock_conn*> lConns;
+static std::deque<sent_job> dJobs;
+static std::vector<replay_job> vReplay;
+static std::mt19937 oRand;
+static FILE* fLog = nullptr;
+
+static size_t iShares = 0;
+static size_t iAccepted = 0;
+static size_t iRejected = 0;
+static size_t iStale = 0;
+static size_t iDuplicate = 0;
+static size_t iUnknownJob = 0;
+static size_t iDisconnects = 0;
+static size_t iLastKickTime = 0;
+static std::vector<size_t> vShareLatency;
+static std::vector<size_t> vStaleDelay;
+static std::vector<size_t> vReconnectTime;
+
+// Old jobs are kept so that stale shares can still be timed
+constexpr static size_t iJobHistory = 16;
+
+static size_t now_ms()
+{
+	using namespace std::chrono;
+	static const steady_clock::time_point start = steady_clock::now();
+	return duration_cast<milliseconds>(steady_clock::now() - start).count();
+}
+
+static void log_event(size_t conn, const char* event, const char* job_id, size_t latency, const char* result)
+{
+	if(fLog == nullptr)
+		return;
+	fprintf(fLog, "%llu,%llu,%s,%s,%llu,%s\n", (unsigned long long)now_ms(), (unsigned long long)conn, event, job_id,
+		(unsigned long long)latency, result);
+}
+
+static void bin2hex(const uint8_t* in, size_t len, char* out)
+{
+	static const char hex[] = "0123456789abcdef";
+	for(size_t i = 0; i < len; i++)
+	{
+		out[i * 2] = hex[in[i] >> 4];
+		out[i * 2 + 1] = hex[in[i] & 0x0F];
+	}
+	out[len * 2] = '\0';
+}
+
+static std::string diff_to_target(uint64_t diff)
+{
+	// Compact 32 bit form, every miner understands it
+	uint32_t target = uint32_t(0xFFFFFFFFULL / diff);
+	char buf[9];
+	bin2hex((const uint8_t*)&target, 4, buf);
+	return buf;
+}
+
+static bool send_line(mock_conn* conn, const std::string& line)
+{
+	std::unique_lock<std::mutex> lck(conn->send_mutex);
+	size_t pos = 0;
+	while(pos < line.size())
+	{
+		int ret = send(conn->sck, line.data() + pos, line.size() - pos, 0);
+		if(ret <= 0)
+			return false;
+		pos += ret;
+	}
+	return true;
+}
+
+static std::string job_json(const sent_job& job)
+{
+	return "{\"blob\":\"" + job.blob + "\",\"job_id\":\"" + job.job_id + "\",\"target\":\"" + job.target + "\"}";
+}
+
+static std::string error_json(uint64_t id, const char* msg)
+{
+	return "{\"id\":" + std::to_string(id) + ",\"jsonrpc\":\"2.0\",\"error\":{\"code\":-1,\"message\":\"" + msg + "\"}}\n";
+}
+
+static std::string ok_json(uint64_t id, const std::string& result)
+{
+	return "{\"id\":" + std::to_string(id) + ",\"jsonrpc\":\"2.0\",\"error\":null,\"result\":" + result + "}\n";
+}
+
+// Called with oMutex held
+static void new_job()
+{
+	static uint64_t seq = 0;
+	static size_t replay_pos = 0;
+
+	sent_job job;
+	job.seq = ++seq;
+	job.job_id = "mock" + std::to_string(job.seq);
+	job.sent_time = now_ms();
+
+	if(!vReplay.empty())
+	{
+		const replay_job& r = vReplay[replay_pos++ % vReplay.size()];
+		job.blob = r.blob;
+		job.target = r.target;
+	}
+	else
+	{
+		// Same layout as a Monero hashing blob, 39 bytes of header, the nonce and the tree root
+		uint8_t blob[76];
+		for(size_t i = 0; i < sizeof(blob); i++)
+			blob[i] = uint8_t(oRand());
+		blob[0] = 7;
+		blob[1] = 7;
+		// Five byte varint timestamp, so that the header parses like a real one
+		for(size_t i = 2; i < 6; i++)
+			blob[i] |= 0x80;
+		blob[6] &= 0x7F;
+		memset(blob + 39, 0, 4);
+
+		char sBlob[sizeof(blob) * 2 + 1];
+		bin2hex(blob, sizeof(blob), sBlob);
+		job.blob = sBlob;
+		job.target = diff_to_target(oCfg.diff);
+	}
+
+	if(oCfg.daemon)
+	{
+		// Header, then a fake miner transaction and no other transactions
+		job.tpl = job.blob.substr(0, 43 * 2);
+		for(size_t i = 0; i < 64; i++)
+		{
+			char sByte[3];
+			uint8_t b = uint8_t(oRand());
+			bin2hex(&b, 1, sByte);
+			job.tpl += sByte;
+		}
+		job.tpl += "00";
+	}
+
+	if(!dJobs.empty())
+		dJobs.back().next_time = job.sent_time;
+
+	dJobs.push_back(std::move(job));
+	if(dJobs.size() > iJobHistory)
+		dJobs.pop_front();
+
+	const sent_job& cur = dJobs.back();
+	if(oCfg.daemon)
+	{
+		log_event(0, "template", cur.job_id.c_str(), 0, "");
+		return;
+	}
+
+	std::string line = "{\"jsonrpc\":\"2.0\",\"method\":\"job\",\"params\":" + job_json(cur) + "}\n";
+	for(mock_conn* conn : lConns)
+	{
+		if(conn->logged_in && !conn->kicked)
+			send_line(conn, line);
+	}
+	log_event(0, "job", cur.job_id.c_str(), 0, "");
+}
+
+// Called with oMutex held, after new_job
+static size_t next_job_delay()
+{
+	if(vReplay.empty())
+		return oCfg.job_interval;
+	return vReplay[(dJobs.back().seq - 1) % vReplay.size()].delay;
+}
+
+static std::string handle_submit(mock_conn* conn, uint64_t id, const Value& params)
+{
+	Value::ConstMemberIterator jobid = params.FindMember("job_id");
+	Value::ConstMemberIterator nonce = params.FindMember("nonce");
+	if(jobid == params.MemberEnd() || nonce == params.MemberEnd() || !jobid->value.IsString() || !nonce->value.IsString())
+		return error_json(id, "Malformed share");
+
+	size_t now = now_ms();
+	std::lock_guard<std::mutex> lck(oMutex);
+	iShares++;
+
+	sent_job* job = nullptr;
+	for(sent_job& j : dJobs)
+	{
+		if(j.job_id == jobid->value.GetString())
+			job = &j;
+	}
+
+	if(job == nullptr)
+	{
+		iUnknownJob++;
+		iRejected++;
+		log_event(conn->id, "submit", jobid->value.GetString(), 0, "unknown_job");
+		return error_json(id, "Block expired");
+	}
+
+	size_t latency = now - job->sent_time;
+	if(!job->nonces.insert(nonce->value.GetString()).second)
+	{
+		iDuplicate++;
+		iRejected++;
+		log_event(conn->id, "submit", job->job_id.c_str(), latency, "duplicate");
+		return error_json(id, "Duplicate share");
+	}
+
+	if(job->next_time != 0)
+	{
+		iStale++;
+		vStaleDelay.push_back(now - job->next_time);
+	}
+	else
+		vShareLatency.push_back(latency);
+
+	if(oCfg.reject_pct != 0 && oRand() % 100 < oCfg.reject_pct)
+	{
+		iRejected++;
+		log_event(conn->id, "submit", job->job_id.c_str(), latency, "injected_reject");
+		return error_json(id, "Low difficulty share");
+	}
+
+	iAccepted++;
+	log_event(conn->id, "submit", job->job_id.c_str(), latency, job->next_time != 0 ? "stale" : "ok");
+	return ok_json(id, "{\"status\":\"OK\"}");
+}
+
+static bool process_line(mock_conn* conn, char* line)
+{
+	Document doc;
+	if(doc.ParseInsitu(line).HasParseError() || !doc.IsObject())
+		return false;
+
+	Value::ConstMemberIterator id = doc.FindMember("id");
+	Value::ConstMemberIterator method = doc.FindMember("method");
+	Value::ConstMemberIterator params = doc.FindMember("params");
+	if(id == doc.MemberEnd() || !id->value.IsUint64() || method == doc.MemberEnd() || !method->value.IsString() ||
+		params == doc.MemberEnd() || !params->value.IsObject())
+		return false;
+
+	uint64_t call_id = id->value.GetUint64();
+	std::string sMethod = method->value.GetString();
+	std::string reply;
+
+	if(sMethod == "login")
+	{
+		std::unique_lock<std::mutex> lck(oMutex);
+		size_t now = now_ms();
+		if(iLastKickTime != 0)
+		{
+			vReconnectTime.push_back(now - iLastKickTime);
+			iLastKickTime = 0;
+		}
+		conn->logged_in = true;
+		reply = ok_json(call_id, "{\"id\":\"" + std::to_string(conn->id) + "\",\"job\":" + job_json(dJobs.back()) + ",\"status\":\"OK\"}");
+		log_event(conn->id, "login", dJobs.back().job_id.c_str(), 0, "");
+		lck.unlock();
+	}
+	else if(!conn->logged_in)
+		reply = error_json(call_id, "Unauthenticated");
+	else if(sMethod == "submit")
+		reply = handle_submit(conn, call_id, params->value);
+	else if(sMethod == "keepalived")
+		reply = ok_json(call_id, "{\"status\":\"KEEPALIVED\"}");
+	else
+		reply = error_json(call_id, "Unsupported method");
+
+	if(oCfg.latency != 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(oCfg.latency));
+
+	return send_line(conn, reply);
+}
+
+static void conn_thd(mock_conn* conn)
+{
+	char buf[4096];
+	size_t datalen = 0;
+	while(true)
+	{
+		int ret = recv(conn->sck, buf + datalen, sizeof(buf) - datalen - 1, 0);
+		if(ret <= 0)
+			break;
+		datalen += ret;
+
+		if(datalen >= sizeof(buf) - 1)
+			break;
+
+		char* lnend;
+		char* lnstart = buf;
+		bool bOk = true;
+		while(bOk && (lnend = (char*)memchr(lnstart, '\n', datalen)) != nullptr)
+		{
+			*lnend = '\0';
+			size_t lnlen = lnend - lnstart + 1;
+			bOk = process_line(conn, lnstart);
+			datalen -= lnlen;
+			lnstart = lnend + 1;
+		}
+
+		if(!bOk)
+			break;
+
+		if(datalen > 0 && buf != lnstart)
+			memmove(buf, lnstart, datalen);
+	}
+
+	std::unique_lock<std::mutex> lck(oMutex);
+	lConns.remove(conn);
+	log_event(conn->id, "disconnect", "", now_ms() - conn->connect_time, conn->kicked ? "injected" : "client");
+	lck.unlock();
+
+	sock_close(conn->sck);
+	delete conn;
+}
+
+static std::string http_reply(uint64_t id, const std::string& json)
+{
+	std::string body = "{\"id\":\"" + std::to_string(id) + "\",\"jsonrpc\":\"2.0\"," + json + "}";
+	return "HTTP/1.1 200 Ok\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) +
+		"\r\nConnection: close\r\n\r\n" + body;
+}
+
+static std::string handle_template(uint64_t id)
+{
+	std::lock_guard<std::mutex> lck(oMutex);
+	const sent_job& job = dJobs.back();
+	return http_reply(id, "\"result\":{\"blockhashing_blob\":\"" + job.blob + "\",\"blocktemplate_blob\":\"" + job.tpl +
+		"\",\"difficulty\":" + std::to_string(oCfg.diff) + ",\"height\":" + std::to_string(job.seq) +
+		",\"prev_hash\":\"" + job.job_id + "\",\"reserved_offset\":0,\"status\":\"OK\"}");
+}
+
+static std::string handle_block(mock_conn* conn, uint64_t id, const Value& params)
+{
+	if(!params.IsArray() || params.Size() != 1 || !params[0].IsString())
+		return http_reply(id, "\"error\":{\"code\":-2,\"message\":\"Wrong param\"}");
+
+	// The nonce is the only part of the template the miner may change
+	std::string blob = params[0].GetString();
+	std::string nonce = blob.size() >= 43 * 2 ? blob.substr(39 * 2, 4 * 2) : "";
+
+	size_t now = now_ms();
+	std::lock_guard<std::mutex> lck(oMutex);
+	iShares++;
+
+	sent_job* job = nullptr;
+	for(sent_job& j : dJobs)
+	{
+		if(j.tpl.size() == blob.size() && j.tpl.compare(0, 39 * 2, blob, 0, 39 * 2) == 0 &&
+			j.tpl.compare(43 * 2, std::string::npos, blob, 43 * 2, std::string::npos) == 0)
+			job = &j;
+	}
+
+	if(job == nullptr)
+	{
+		iUnknownJob++;
+		iRejected++;
+		log_event(conn->id, "submit", "", 0, "unknown_job");
+		return http_reply(id, "\"error\":{\"code\":-7,\"message\":\"Block not accepted\"}");
+	}
+
+	size_t latency = now - job->sent_time;
+	if(!job->nonces.insert(nonce).second)
+	{
+		iDuplicate++;
+		iRejected++;
+		log_event(conn->id, "submit", job->job_id.c_str(), latency, "duplicate");
+		return http_reply(id, "\"error\":{\"code\":-7,\"message\":\"Block not accepted\"}");
+	}
+
+	if(job->next_time != 0)
+	{
+		iStale++;
+		vStaleDelay.push_back(now - job->next_time);
+	}
+	else
+		vShareLatency.push_back(latency);
+
+	if(oCfg.reject_pct != 0 && oRand() % 100 < oCfg.reject_pct)
+	{
+		iRejected++;
+		log_event(conn->id, "submit", job->job_id.c_str(), latency, "injected_reject");
+		return http_reply(id, "\"error\":{\"code\":-7,\"message\":\"Block not accepted\"}");
+	}
+
+	iAccepted++;
+	log_event(conn->id, "submit", job->job_id.c_str(), latency, job->next_time != 0 ? "stale" : "ok");
+	return http_reply(id, "\"result\":{\"status\":\"OK\"}");
+}
+
+// One JSON-RPC call per connection, the miner sends "Connection: close"
+static void http_thd(mock_conn* conn)
+{
+	std::string data;
+	char buf[4096];
+	size_t body_pos = std::string::npos;
+	size_t body_len = 0;
+	while(body_pos == std::string::npos || data.size() < body_pos + body_len)
+	{
+		int ret = recv(conn->sck, buf, sizeof(buf), 0);
+		if(ret <= 0)
+			break;
+		data.append(buf, ret);
+
+		if(body_pos == std::string::npos && (body_pos = data.find("\r\n\r\n")) != std::string::npos)
+		{
+			body_pos += 4;
+			size_t len_pos = data.find("Content-Length:");
+			if(len_pos != std::string::npos && len_pos < body_pos)
+				body_len = strtoul(data.c_str() + len_pos + 15, nullptr, 10);
+		}
+	}
+
+	std::string reply;
+	Document doc;
+	if(body_pos != std::string::npos && data.size() >= body_pos + body_len &&
+		!doc.Parse(data.c_str() + body_pos, body_len).HasParseError() && doc.IsObject())
+	{
+		Value::ConstMemberIterator method = doc.FindMember("method");
+		Value::ConstMemberIterator params = doc.FindMember("params");
+
+		if(oCfg.latency != 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(oCfg.latency));
+
+		if(method == doc.MemberEnd() || !method->value.IsString() || params == doc.MemberEnd())
+			reply = http_reply(0, "\"error\":{\"code\":-32600,\"message\":\"Invalid Request\"}");
+		else if(strcmp(method->value.GetString(), "get_block_template") == 0)
+			reply = handle_template(0);
+		else if(strcmp(method->value.GetString(), "submit_block") == 0)
+			reply = handle_block(conn, 0, params->value);
+		else
+			reply = http_reply(0, "\"error\":{\"code\":-32601,\"message\":\"Method not found\"}");
+	}
+	else
+		reply = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+	send_line(conn, reply);
+
+	std::unique_lock<std::mutex> lck(oMutex);
+	lConns.remove(conn);
+	lck.unlock();
+
+	sock_close(conn->sck);
+	delete conn;
+}
+
+static void accept_thd(SOCKET listen_sck)
+{
+	size_t next_id = 1;
+	while(true)
+	{
+		SOCKET sck = accept(listen_sck, nullptr, nullptr);
+		if(sck == INVALID_SOCKET)
+			continue;
+
+		mock_conn* conn = new mock_conn;
+		conn->sck = sck;
+		conn->connect_time = now_ms();
+
+		std::unique_lock<std::mutex> lck(oMutex);
+		conn->id = next_id++;
+		lConns.push_back(conn);
+		lck.unlock();
+
+		std::thread(oCfg.daemon ? http_thd : conn_thd, conn).detach();
+	}
+}
+
+static size_t percentile(std::vector<size_t> v, double p)
+{
+	if(v.empty())
+		return 0;
+	size_t idx = std::min(v.size() - 1, size_t(p * v.size()));
+	std::nth_element(v.begin(), v.begin() + idx, v.end());
+	return v[idx];
+}
+
+static void print_report()
+{
+	std::lock_guard<std::mutex> lck(oMutex);
+	double secs = now_ms() / 1000.0;
+
+	printf("--- %.1fs: %llu connections, %llu jobs\n", secs, (unsigned long long)lConns.size(),
+		(unsigned long long)(dJobs.empty() ? 0 : dJobs.back().seq));
+	printf("shares    : %llu (%.2f/s), %llu accepted, %llu rejected\n", (unsigned long long)iShares, secs > 0.0 ? iShares / secs : 0.0,
+		(unsigned long long)iAccepted, (unsigned long long)iRejected);
+	printf("late      : %llu stale (accepted), %llu duplicate, %llu unknown job\n", (unsigned long long)iStale,
+		(unsigned long long)iDuplicate, (unsigned long long)iUnknownJob);
+	printf("job->share: median %llu ms, 95%% %llu ms\n", (unsigned long long)percentile(vShareLatency, 0.5),
+		(unsigned long long)percentile(vShareLatency, 0.95));
+	printf("job switch: stale shares up to %llu ms after the new job\n", (unsigned long long)percentile(vStaleDelay, 1.0));
+	printf("failover  : %llu disconnects, reconnect median %llu ms, max %llu ms\n", (unsigned long long)iDisconnects,
+		(unsigned long long)percentile(vReconnectTime, 0.5), (unsigned long long)percentile(vReconnectTime, 1.0));
+	fflush(stdout);
+}
+
+static bool load_replay(const std::string& file)
+{
+	std::ifstream in(file);
+	if(!in)
+	{
+		printf("Can't open replay file %s\n", file.c_str());
+		return false;
+	}
+
+	std::string line;
+	while(std::getline(in, line))
+	{
+		if(line.empty() || line[0] == '#')
+			continue;
+
+		char blob[512];
+		char target[32];
+		unsigned long long delay;
+		if(sscanf(line.c_str(), "%llu %511s %31s", &delay, blob, target) != 3)
+		{
+			printf("Invalid replay line: %s\n", line.c_str());
+			return false;
+		}
+		vReplay.push_back({ size_t(delay), blob, target });
+	}
+
+	if(vReplay.empty())
+	{
+		printf("Replay file %s has no jobs\n", file.c_str());
+		return false;
+	}
+	return true;
+}
+
+static void help()
+{
+	using namespace std;
+	cout<<"Usage: xmr-stak-mockpool [OPTION]..."<<endl;
+	cout<<" "<<endl;
+	cout<<"  -h, --help            show this help"<<endl;
+	cout<<"  --port PORT           port to listen on (default 3333)"<<endl;
+	cout<<"  --daemon              act as a monero daemon for solo mining, every job is a block"<<endl;
+	cout<<"                        template of difficulty --diff, every share a block"<<endl;
+	cout<<"  --diff N              share difficulty of the synthetic jobs (default 5000)"<<endl;
+	cout<<"  --job-interval MS     time between synthetic jobs (default 30000)"<<endl;
+	cout<<"  --replay FILE         replay a job stream, one job per line:"<<endl;
+	cout<<"                        <delay before the next job in ms> <blob hex> <target hex>"<<endl;
+	cout<<"  --latency MS          delay every reply by this much"<<endl;
+	cout<<"  --reject PERCENT      reject this share of the submits"<<endl;
+	cout<<"  --disconnect SEC      drop every connection after this many seconds"<<endl;
+	cout<<"  --duration SEC        exit after this many seconds (default: run forever)"<<endl;
+	cout<<"  --report SEC          print the statistics this often (default 10)"<<endl;
+	cout<<"  --log FILE            write every job, login and share to a CSV file"<<endl;
+	cout<<"  --seed N              seed of the synthetic job stream and of the rejects"<<endl;
+	cout<<" "<<endl;
+}
+
+int main(int argc, char* argv[])
+{
+	for(int i = 1; i < argc; i++)
+	{
+		std::string opName(argv[i]);
+
+		if(opName == "-h" || opName == "--help")
+		{
+			help();
+			return 0;
+		}
+
+		if(opName == "--daemon")
+		{
+			oCfg.daemon = true;
+			continue;
+		}
+
+		if(i + 1 >= argc)
+		{
+			printf("No argument for parameter '%s' given\n", opName.c_str());
+			return 1;
+		}
+
+		const char* arg = argv[++i];
+		if(opName == "--port")
+			oCfg.port = uint16_t(strtoul(arg, nullptr, 10));
+		else if(opName == "--diff")
+			oCfg.diff = std::max(1ULL, strtoull(arg, nullptr, 10));
+		else if(opName == "--job-interval")
+			oCfg.job_interval = std::max(1UL, strtoul(arg, nullptr, 10));
+		else if(opName == "--replay")
+			oCfg.replay_file = arg;
+		else if(opName == "--latency")
+			oCfg.latency = strtoul(arg, nullptr, 10);
+		else if(opName == "--reject")
+			oCfg.reject_pct = strtoul(arg, nullptr, 10);
+		else if(opName == "--disconnect")
+			oCfg.disconnect_time = strtoul(arg, nullptr, 10);
+		else if(opName == "--duration")
+			oCfg.duration = strtoul(arg, nullptr, 10);
+		else if(opName == "--report")
+			oCfg.report_time = strtoul(arg, nullptr, 10);
+		else if(opName == "--log")
+			oCfg.log_file = arg;
+		else if(opName == "--seed")
+			oCfg.seed = uint32_t(strtoul(arg, nullptr, 10));
+		else
+		{
+			printf("Parameter unknown '%s'\n", opName.c_str());
+			help();
+			return 1;
+		}
+	}
+
+	oRand.seed(oCfg.seed);
+
+	if(!oCfg.replay_file.empty() && !load_replay(oCfg.replay_file))
+		return 1;
+
+	if(!oCfg.log_file.empty())
+	{
+		if((fLog = fopen(oCfg.log_file.c_str(), "w")) == nullptr)
+		{
+			printf("Can't open log file %s\n", oCfg.log_file.c_str());
+			return 1;
+		}
+		fprintf(fLog, "time_ms,conn,event,job_id,latency_ms,result\n");
+	}
+
+	sock_init();
+
+#ifndef _WIN32
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	SOCKET listen_sck = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	int on = 1;
+	setsockopt(listen_sck, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(oCfg.port);
+
+	if(listen_sck == INVALID_SOCKET || bind(listen_sck, (const sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_sck, SOMAXCONN) != 0)
+	{
+		char sSockErrText[512];
+		printf("Can't listen on port %u: %s\n", unsigned(oCfg.port), sock_strerror(sSockErrText, sizeof(sSockErrText)));
+		return 1;
+	}
+
+	size_t next_job;
+	{
+		std::lock_guard<std::mutex> lck(oMutex);
+		new_job();
+		next_job = now_ms() + next_job_delay();
+	}
+
+	std::thread(accept_thd, listen_sck).detach();
+	printf("Mock %s listening on port %u\n", oCfg.daemon ? "daemon" : "pool", unsigned(oCfg.port));
+	fflush(stdout);
+
+	size_t next_report = oCfg.report_time * 1000;
+	while(oCfg.duration == 0 || now_ms() < oCfg.duration * 1000)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		size_t now = now_ms();
+
+		if(now >= next_job)
+		{
+			std::lock_guard<std::mutex> lck(oMutex);
+			new_job();
+			next_job = now + next_job_delay();
+		}
+
+		if(oCfg.disconnect_time != 0)
+		{
+			std::lock_guard<std::mutex> lck(oMutex);
+			for(mock_conn* conn : lConns)
+			{
+				if(!conn->kicked && now - conn->connect_time >= oCfg.disconnect_time * 1000)
+				{
+					// The connection thread cleans up once recv fails
+					conn->kicked = true;
+					iDisconnects++;
+					iLastKickTime = now;
+					shutdown(conn->sck, 2);
+				}
+			}
+		}
+
+		if(oCfg.report_time != 0 && now >= next_report)
+		{
+			print_report();
+			next_report = now + oCfg.report_time * 1000;
+		}
+	}
+
+	print_report();
+	if(fLog != nullptr)
+		fclose(fLog);
+	return 0;
+}